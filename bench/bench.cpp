@@ -0,0 +1,569 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <maxzip.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using clock_type = std::chrono::steady_clock;
+
+    struct options
+    {
+        std::vector<std::string> codecs = {"brotli", "zlib", "zstd", "lz4"};
+        std::vector<std::string> corpora = {"text", "json", "random", "zeros", "binary"};
+        size_t min_size = 64;
+        size_t max_size = 16 << 20;
+        size_t iterations = 20;
+        double time_limit = 0.5;
+    };
+
+    /**
+     * @class peak_allocator
+     * @brief Allocator that tracks the peak number of bytes held by codec contexts
+     */
+    class peak_allocator : public maxzip::allocator
+    {
+    public:
+        void *allocate(size_t size) override
+        {
+            uint8_t *block = static_cast<uint8_t *>(std::malloc(size + header_size));
+            if (block == nullptr)
+            {
+                return nullptr;
+            }
+            std::memcpy(block, &size, sizeof(size));
+            const size_t current = _current.fetch_add(size) + size;
+            size_t peak = _peak.load();
+            while (current > peak && !_peak.compare_exchange_weak(peak, current))
+            {
+            }
+            return block + header_size;
+        }
+
+        void deallocate(void *pointer) override
+        {
+            if (pointer != nullptr)
+            {
+                uint8_t *block = static_cast<uint8_t *>(pointer) - header_size;
+                size_t size;
+                std::memcpy(&size, block, sizeof(size));
+                _current.fetch_sub(size);
+                std::free(block);
+            }
+        }
+
+        size_t peak() const
+        {
+            return _peak.load();
+        }
+
+    private:
+        static constexpr size_t header_size = alignof(std::max_align_t);
+        std::atomic<size_t> _current{0};
+        std::atomic<size_t> _peak{0};
+    };
+
+    /**
+     * @class generator
+     * @brief Deterministic xorshift generator, so every run measures the same data
+     */
+    class generator
+    {
+    public:
+        explicit generator(uint64_t seed) : _state(seed * 0x9E3779B97F4A7C15ULL)
+        {
+        }
+
+        uint64_t next()
+        {
+            _state ^= _state << 13;
+            _state ^= _state >> 7;
+            _state ^= _state << 17;
+            return _state;
+        }
+
+        size_t below(size_t bound)
+        {
+            return static_cast<size_t>(next() % bound);
+        }
+
+    private:
+        uint64_t _state;
+    };
+
+    void append(std::vector<uint8_t> &output, const std::string &text)
+    {
+        output.insert(output.end(), text.begin(), text.end());
+    }
+
+    std::vector<uint8_t> make_text(size_t size)
+    {
+        static const char *const words[] = {
+            "the", "of", "and", "to", "in", "a", "is", "that", "for", "it",
+            "as", "was", "with", "be", "by", "on", "not", "he", "this", "are",
+            "or", "his", "from", "at", "which", "but", "have", "an", "had", "they",
+            "compression", "stream", "buffer", "window", "dictionary", "entropy",
+            "performance", "throughput", "latency", "allocation", "context", "frame"};
+        const size_t word_count = sizeof(words) / sizeof(words[0]);
+        generator random(1);
+        std::vector<uint8_t> output;
+        output.reserve(size + 32);
+        while (output.size() < size)
+        {
+            // skew towards the common words at the front of the list
+            const size_t index = std::min(random.below(word_count), random.below(word_count));
+            append(output, words[index]);
+            output.push_back(random.below(12) == 0 ? '\n' : ' ');
+        }
+        output.resize(size);
+        return output;
+    }
+
+    std::vector<uint8_t> make_json(size_t size)
+    {
+        generator random(2);
+        std::vector<uint8_t> output;
+        output.reserve(size + 256);
+        for (size_t index = 0; output.size() < size; index++)
+        {
+            append(output,
+                   "{\"id\":" + std::to_string(index) +
+                       ",\"user\":\"user" + std::to_string(random.below(1000)) +
+                       "\",\"status\":\"" + (random.below(3) == 0 ? "active" : "inactive") +
+                       "\",\"score\":" + std::to_string(random.below(100000)) +
+                       ",\"region\":\"eu-west-" + std::to_string(random.below(4)) + "\"}\n");
+        }
+        output.resize(size);
+        return output;
+    }
+
+    std::vector<uint8_t> make_random(size_t size)
+    {
+        generator random(3);
+        std::vector<uint8_t> output(size);
+        for (uint8_t &value : output)
+        {
+            value = static_cast<uint8_t>(random.next());
+        }
+        return output;
+    }
+
+    std::vector<uint8_t> make_zeros(size_t size)
+    {
+        generator random(4);
+        std::vector<uint8_t> output(size, 0);
+        for (uint8_t &value : output)
+        {
+            if (random.below(20) == 0)
+            {
+                value = static_cast<uint8_t>(random.next());
+            }
+        }
+        return output;
+    }
+
+    std::vector<uint8_t> make_binary(size_t size)
+    {
+        generator random(5);
+        std::vector<uint8_t> record(256);
+        for (uint8_t &value : record)
+        {
+            value = static_cast<uint8_t>(random.next());
+        }
+        std::vector<uint8_t> output;
+        output.reserve(size + record.size());
+        while (output.size() < size)
+        {
+            // fixed-layout records with one changing field each
+            record[random.below(record.size())] = static_cast<uint8_t>(random.next());
+            output.insert(output.end(), record.begin(), record.end());
+        }
+        output.resize(size);
+        return output;
+    }
+
+    std::vector<uint8_t> make_corpus(const std::string &name, size_t size)
+    {
+        if (name == "text")
+        {
+            return make_text(size);
+        }
+        if (name == "json")
+        {
+            return make_json(size);
+        }
+        if (name == "random")
+        {
+            return make_random(size);
+        }
+        if (name == "zeros")
+        {
+            return make_zeros(size);
+        }
+        if (name == "binary")
+        {
+            return make_binary(size);
+        }
+        throw std::invalid_argument("Unknown corpus: " + name);
+    }
+
+    std::vector<int> codec_levels(const std::string &codec)
+    {
+        int min_level(0);
+        int max_level(0);
+        if (codec == "brotli")
+        {
+            max_level = 11;
+        }
+        else if (codec == "zlib")
+        {
+            max_level = 9;
+        }
+        else if (codec == "zstd")
+        {
+            min_level = 1;
+            max_level = 19;
+        }
+        else if (codec == "lz4")
+        {
+            // level 0 is the fast compressor, the rest are LZ4HC levels
+            max_level = 12;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown codec: " + codec);
+        }
+        std::vector<int> levels;
+        for (int level = min_level; level <= max_level; level++)
+        {
+            levels.push_back(level);
+        }
+        return levels;
+    }
+
+    maxzip::compressor *create_compressor(const std::string &codec, int level, const std::shared_ptr<maxzip::allocator> &allocator)
+    {
+        if (codec == "brotli")
+        {
+            maxzip::brotli_compressor_params params;
+            params.quality = level;
+            params.allocator = allocator;
+            return maxzip::create_brotli_compressor(params);
+        }
+        if (codec == "zlib")
+        {
+            maxzip::zlib_compressor_params params;
+            params.level = level;
+            params.allocator = allocator;
+            return maxzip::create_zlib_compressor(params);
+        }
+        if (codec == "lz4")
+        {
+            maxzip::lz4_compressor_params params;
+            if (level > 0)
+            {
+                params.level = level;
+            }
+            params.allocator = allocator;
+            return maxzip::create_lz4_compressor(params);
+        }
+        maxzip::zstd_compressor_params params;
+        params.level = level;
+        params.allocator = allocator;
+        return maxzip::create_zstd_compressor(params);
+    }
+
+    maxzip::decompressor *create_decompressor(const std::string &codec, const std::shared_ptr<maxzip::allocator> &allocator)
+    {
+        if (codec == "brotli")
+        {
+            maxzip::brotli_decompressor_params params;
+            params.allocator = allocator;
+            return maxzip::create_brotli_decompressor(params);
+        }
+        if (codec == "zlib")
+        {
+            maxzip::zlib_decompressor_params params;
+            params.allocator = allocator;
+            return maxzip::create_zlib_decompressor(params);
+        }
+        if (codec == "lz4")
+        {
+            return maxzip::create_lz4_decompressor();
+        }
+        maxzip::zstd_decompressor_params params;
+        params.allocator = allocator;
+        return maxzip::create_zstd_decompressor(params);
+    }
+
+    struct timing
+    {
+        std::vector<double> samples;
+
+        double percentile(double fraction) const
+        {
+            std::vector<double> sorted(samples);
+            std::sort(sorted.begin(), sorted.end());
+            return sorted[static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5)];
+        }
+
+        double throughput(size_t size) const
+        {
+            double total(0.0);
+            for (double sample : samples)
+            {
+                total += sample;
+            }
+            return static_cast<double>(size) * static_cast<double>(samples.size()) / total / 1e6;
+        }
+    };
+
+    template <typename Function>
+    timing measure(const options &options, Function function)
+    {
+        timing result;
+        const clock_type::time_point deadline = clock_type::now() +
+                                                std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(options.time_limit));
+        do
+        {
+            const clock_type::time_point start = clock_type::now();
+            function();
+            result.samples.push_back(std::chrono::duration<double>(clock_type::now() - start).count());
+        } while (result.samples.size() < options.iterations && clock_type::now() < deadline);
+        return result;
+    }
+
+    void print_latency(const char *name, const timing &timing)
+    {
+        std::printf(
+            "\"%s_latency_us\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f}",
+            name,
+            timing.percentile(0.50) * 1e6,
+            timing.percentile(0.90) * 1e6,
+            timing.percentile(0.99) * 1e6);
+    }
+
+    void run_case(const options &options, const std::string &codec, int level, const std::string &corpus, const std::vector<uint8_t> &input)
+    {
+        std::shared_ptr<peak_allocator> compress_memory = std::make_shared<peak_allocator>();
+        std::shared_ptr<peak_allocator> decompress_memory = std::make_shared<peak_allocator>();
+        std::unique_ptr<maxzip::compressor> compressor(create_compressor(codec, level, compress_memory));
+        std::unique_ptr<maxzip::decompressor> decompressor(create_decompressor(codec, decompress_memory));
+
+        size_t compressed_size(0);
+        compressor->compress(input.data(), input.size(), nullptr, compressed_size);
+        std::vector<uint8_t> compressed(compressed_size);
+        std::vector<uint8_t> decompressed(input.size());
+
+        const timing compress_timing = measure(options, [&]() {
+            size_t output_size = compressed.size();
+            compressed_size = compressor->compress(input.data(), input.size(), compressed.data(), output_size);
+        });
+        size_t decompressed_size(0);
+        const timing decompress_timing = measure(options, [&]() {
+            decompressed_size = decompressor->decompress(compressed.data(), compressed_size, decompressed.data(), decompressed.size());
+        });
+        if (decompressed_size != input.size() || decompressed != input)
+        {
+            throw std::runtime_error("Round trip failed for " + codec + " level " + std::to_string(level) + ".");
+        }
+
+        std::printf(
+            "{\"codec\":\"%s\",\"level\":%d,\"corpus\":\"%s\",\"size\":%zu,\"compressed_size\":%zu,\"ratio\":%.4f,"
+            "\"compress_mbps\":%.2f,\"decompress_mbps\":%.2f,\"peak_memory\":{\"compress\":%zu,\"decompress\":%zu},",
+            codec.c_str(),
+            level,
+            corpus.c_str(),
+            input.size(),
+            compressed_size,
+            static_cast<double>(input.size()) / static_cast<double>(std::max<size_t>(compressed_size, 1)),
+            compress_timing.throughput(input.size()),
+            decompress_timing.throughput(input.size()),
+            compress_memory->peak(),
+            decompress_memory->peak());
+        print_latency("compress", compress_timing);
+        std::printf(",");
+        print_latency("decompress", decompress_timing);
+        std::printf("}");
+        std::fflush(stdout);
+    }
+
+    std::vector<std::string> split(const std::string &list)
+    {
+        std::vector<std::string> values;
+        size_t start(0);
+        while (start <= list.size())
+        {
+            const size_t end = std::min(list.find(',', start), list.size());
+            if (end > start)
+            {
+                values.push_back(list.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+        return values;
+    }
+
+    size_t parse_size(const std::string &value)
+    {
+        size_t consumed(0);
+        const unsigned long long number = std::stoull(value, &consumed);
+        const std::string suffix = value.substr(consumed);
+        size_t shift(0);
+        if (suffix == "K" || suffix == "k")
+        {
+            shift = 10;
+        }
+        else if (suffix == "M" || suffix == "m")
+        {
+            shift = 20;
+        }
+        else if (suffix == "G" || suffix == "g")
+        {
+            shift = 30;
+        }
+        else if (!suffix.empty())
+        {
+            throw std::invalid_argument("Invalid size: " + value);
+        }
+        return static_cast<size_t>(number) << shift;
+    }
+
+    void usage()
+    {
+        std::cerr
+            << "usage: maxzip_bench [options]\n"
+            << "  --codecs LIST      comma-separated codecs (brotli,zlib,zstd,lz4)\n"
+            << "  --corpora LIST     comma-separated corpora (text,json,random,zeros,binary)\n"
+            << "  --min-size SIZE    smallest input size, default 64\n"
+            << "  --max-size SIZE    largest input size, up to 1G, default 16M\n"
+            << "  --iterations N     maximum runs per measurement, default 20\n"
+            << "  --time SECONDS     time budget per measurement, default 0.5\n";
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string name(argv[i]);
+            if (name == "--help" || name == "-h")
+            {
+                usage();
+                std::exit(EXIT_SUCCESS);
+            }
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument("Missing value for " + name);
+            }
+            const std::string value(argv[++i]);
+            if (name == "--codecs")
+            {
+                options.codecs = split(value);
+            }
+            else if (name == "--corpora")
+            {
+                options.corpora = split(value);
+            }
+            else if (name == "--min-size")
+            {
+                options.min_size = parse_size(value);
+            }
+            else if (name == "--max-size")
+            {
+                options.max_size = parse_size(value);
+            }
+            else if (name == "--iterations")
+            {
+                options.iterations = std::max<size_t>(1, std::stoul(value));
+            }
+            else if (name == "--time")
+            {
+                options.time_limit = std::stod(value);
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown option: " + name);
+            }
+        }
+        if (options.min_size == 0 || options.min_size > options.max_size || options.max_size > (size_t(1) << 30))
+        {
+            throw std::invalid_argument("Invalid size range.");
+        }
+        for (const std::string &codec : options.codecs)
+        {
+            codec_levels(codec);
+        }
+        return options;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        const options options = parse_options(argc, argv);
+        const char *separator = "";
+        std::printf("{\"results\":[");
+        for (const std::string &corpus : options.corpora)
+        {
+            // sizes grow by a factor of four, so the default range covers 64B, 256B, ... 16M
+            for (size_t size = options.min_size; size <= options.max_size; size *= 4)
+            {
+                const std::vector<uint8_t> input = make_corpus(corpus, size);
+                for (const std::string &codec : options.codecs)
+                {
+                    for (int level : codec_levels(codec))
+                    {
+                        std::printf("%s\n    ", separator);
+                        run_case(options, codec, level, corpus, input);
+                        separator = ",";
+                    }
+                }
+                if (size > options.max_size / 4)
+                {
+                    break;
+                }
+            }
+        }
+        std::printf("\n]}\n");
+    }
+    catch (const std::exception &exception)
+    {
+        std::cerr << "maxzip_bench: " << exception.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
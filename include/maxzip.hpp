@@ -33,5 +33,16 @@
 #include <maxzip/decompressor.hpp>
 #include <maxzip/encoder.hpp>
 #include <maxzip/decoder.hpp>
+#include <maxzip/dictionary.hpp>
+#include <maxzip/parallel.hpp>
+#include <maxzip/pipeline.hpp>
+#include <maxzip/pool.hpp>
+#include <maxzip/seekable.hpp>
+#include <maxzip/adaptive.hpp>
+#include <maxzip/universal.hpp>
+#include <maxzip/checksum.hpp>
+#include <maxzip/dedup.hpp>
+#include <maxzip/file.hpp>
+#include <maxzip/metrics.hpp>
 
 #endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MAXZIP_ADAPTIVE_HPP
+#define MAXZIP_ADAPTIVE_HPP
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+namespace maxzip
+{
+    /**
+     * The policy is given by at most one of the two targets. With a throughput
+     * target the compressor picks the best ratio among the settings that are
+     * fast enough. With a ratio target it picks the fastest setting that
+     * compresses well enough. Without either, a throughput target of 100 MB/s
+     * is used. By default probes spend at most a tenth of the compression time
+     * and no more than 100 ms each. A probe budget instead allows every probe
+     * that many seconds.
+     */
+    struct adaptive_compressor_params
+    {
+        std::optional<double> min_throughput;
+        std::optional<double> min_ratio;
+        std::optional<size_t> sample_size;
+        std::optional<size_t> probe_interval;
+        std::optional<double> probe_budget;
+    };
+
+    /**
+     * @brief Create a compressor that chooses a backend and level for each input
+     * from a throughput or ratio target. Candidate settings are ordered from
+     * fastest to strongest. Every probe interval it compresses a sample of the
+     * input with the setting in use and with its neighbours, moving toward the
+     * target within the probe budget, and between probes it tracks the measured
+     * speed and ratio of the setting in use. Only the setting in use and its
+     * neighbours keep their contexts. Output starts with one envelope byte naming
+     * the codec, and input that does not compress is stored as is.
+     * @param params Policy, sample size, number of inputs between probes and probe budget
+     * @return A compressor producing the maxzip envelope format
+     */
+    compressor *create_adaptive_compressor(const adaptive_compressor_params &params = {});
+
+    /**
+     * @brief Create a decompressor for the output of an adaptive compressor,
+     * which dispatches on the envelope byte. This is a universal decompressor
+     * with the default registry.
+     * @return A decompressor for the maxzip envelope format
+     */
+    decompressor *create_adaptive_decompressor();
+}
+
+#endif
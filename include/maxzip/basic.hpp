@@ -0,0 +1,473 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MAXZIP_BASIC_HPP
+#define MAXZIP_BASIC_HPP
+
+/**
+ * @file basic.hpp
+ * @brief Header-only codecs with the format and level fixed at compile time.
+ * This header includes the brotli, zlib and Zstandard headers, so it is not
+ * pulled in by maxzip.hpp and must be included explicitly. The zlib codecs
+ * use the stock zlib API and are left out when building against zlib-ng in
+ * native mode (MAXZIP_ZLIB_NG).
+ */
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#ifndef MAXZIP_ZLIB_NG
+#include <zlib.h>
+#endif
+#include <zstd.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace maxzip
+{
+    /**
+     * @brief Compile-time properties of a codec usable with basic_compressor
+     */
+    template <codec Codec>
+    struct basic_codec_traits;
+
+    template <>
+    struct basic_codec_traits<codec::brotli>
+    {
+        static constexpr int default_level = BROTLI_DEFAULT_QUALITY;
+        static constexpr int min_level = BROTLI_MIN_QUALITY;
+        static constexpr int max_level = BROTLI_MAX_QUALITY;
+    };
+
+#ifndef MAXZIP_ZLIB_NG
+    template <>
+    struct basic_codec_traits<codec::zlib>
+    {
+        static constexpr int default_level = Z_DEFAULT_COMPRESSION;
+        static constexpr int min_level = Z_DEFAULT_COMPRESSION;
+        static constexpr int max_level = Z_BEST_COMPRESSION;
+    };
+#endif
+
+    template <>
+    struct basic_codec_traits<codec::zstd>
+    {
+        static constexpr int default_level = ZSTD_CLEVEL_DEFAULT;
+        static constexpr int min_level = -(1 << 17);
+        static constexpr int max_level = 22;
+    };
+
+    /**
+     * @class basic_compressor
+     * @brief Non-virtual block compressor for one codec and level. All calls
+     * resolve at compile time and the context is released by a stateless
+     * deleter, so the wrapper can be inlined entirely into tight loops over
+     * small records.
+     */
+    template <codec Codec, int Level = basic_codec_traits<Codec>::default_level>
+    class basic_compressor;
+
+    /**
+     * @class basic_decompressor
+     * @brief Non-virtual block decompressor for one codec
+     */
+    template <codec Codec>
+    class basic_decompressor;
+
+    namespace basic_detail
+    {
+        struct zstd_cctx_deleter
+        {
+            void operator()(ZSTD_CCtx *ctx) const noexcept
+            {
+                static_cast<void>(ZSTD_freeCCtx(ctx));
+            }
+        };
+
+        struct zstd_dctx_deleter
+        {
+            void operator()(ZSTD_DCtx *ctx) const noexcept
+            {
+                static_cast<void>(ZSTD_freeDCtx(ctx));
+            }
+        };
+
+#ifndef MAXZIP_ZLIB_NG
+        struct deflate_deleter
+        {
+            void operator()(z_stream *stream) const noexcept
+            {
+                static_cast<void>(deflateEnd(stream));
+                delete stream;
+            }
+        };
+
+        struct inflate_deleter
+        {
+            void operator()(z_stream *stream) const noexcept
+            {
+                static_cast<void>(inflateEnd(stream));
+                delete stream;
+            }
+        };
+
+        // zlib counts in uInt, so larger buffers are fed in pieces until the
+        // stream ends or a call makes no progress
+        template <typename Step>
+        size_t zlib_drive(z_stream &stream, const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size, Step step)
+        {
+            constexpr size_t chunk = std::numeric_limits<uInt>::max();
+            // zlib rejects a null output even when it has no room, which an
+            // empty vector's data() may be
+            Bytef empty(0);
+            size_t input_left = input_size;
+            size_t output_left = output_size;
+            stream.next_in = const_cast<Bytef *>(input);
+            stream.avail_in = 0;
+            stream.next_out = (output != nullptr) ? output : &empty;
+            stream.avail_out = 0;
+            int ret = Z_OK;
+            while (ret == Z_OK || ret == Z_BUF_ERROR)
+            {
+                if (stream.avail_in == 0)
+                {
+                    stream.avail_in = static_cast<uInt>(std::min(input_left, chunk));
+                    input_left -= stream.avail_in;
+                }
+                if (stream.avail_out == 0)
+                {
+                    stream.avail_out = static_cast<uInt>(std::min(output_left, chunk));
+                    output_left -= stream.avail_out;
+                }
+                const uInt avail_in = stream.avail_in;
+                const uInt avail_out = stream.avail_out;
+                ret = step(stream, input_left == 0);
+                if (ret == Z_BUF_ERROR && stream.avail_in == avail_in && stream.avail_out == avail_out)
+                {
+                    break;
+                }
+            }
+            if (ret != Z_STREAM_END)
+            {
+                throw std::runtime_error("Zlib block failed: " + std::string(stream.msg != nullptr ? stream.msg : "output buffer too small or input truncated"));
+            }
+            return output_size - output_left - stream.avail_out;
+        }
+#endif
+    }
+
+    template <int Level>
+    class basic_compressor<codec::brotli, Level>
+    {
+        static_assert(Level >= basic_codec_traits<codec::brotli>::min_level && Level <= basic_codec_traits<codec::brotli>::max_level, "Brotli quality out of range");
+
+    public:
+        /**
+         * @brief Maximum compressed size of a block
+         * @param input_size Size of the input data in bytes
+         * @return The size in bytes, or 0 if the input is too large
+         */
+        static size_t bound(size_t input_size) noexcept
+        {
+            return BrotliEncoderMaxCompressedSize(input_size);
+        }
+
+        /**
+         * @brief Compress a block of data
+         * @param input Pointer to the input data
+         * @param input_size Size of the input data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Size of the output buffer in bytes
+         * @return The size of the compressed data in bytes
+         */
+        size_t compress(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size)
+        {
+            size_t compressed_size(output_size);
+            if (BrotliEncoderCompress(Level, BROTLI_DEFAULT_WINDOW, BROTLI_DEFAULT_MODE, input_size, input, &compressed_size, output) != BROTLI_TRUE)
+            {
+                throw std::runtime_error("Brotli compression failed");
+            }
+            return compressed_size;
+        }
+    };
+
+    template <>
+    class basic_decompressor<codec::brotli>
+    {
+    public:
+        /**
+         * @brief Decompress a block of data
+         * @param input Pointer to the compressed data
+         * @param input_size Size of the compressed data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Size of the output buffer in bytes
+         * @return The size of the decompressed data in bytes
+         */
+        size_t decompress(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size)
+        {
+            size_t decompressed_size(output_size);
+            if (BrotliDecoderDecompress(input_size, input, &decompressed_size, output) != BROTLI_DECODER_RESULT_SUCCESS)
+            {
+                throw std::runtime_error("Brotli decompression failed");
+            }
+            return decompressed_size;
+        }
+    };
+
+#ifndef MAXZIP_ZLIB_NG
+    template <int Level>
+    class basic_compressor<codec::zlib, Level>
+    {
+        static_assert(Level >= basic_codec_traits<codec::zlib>::min_level && Level <= basic_codec_traits<codec::zlib>::max_level, "Zlib level out of range");
+
+    public:
+        basic_compressor() : _stream(new z_stream())
+        {
+            if (deflateInit2(_stream.get(), Level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                delete _stream.release();
+                throw std::runtime_error("Failed to initialize zlib compressor");
+            }
+        }
+
+        /**
+         * @brief Maximum compressed size of a block, as computed by compressBound
+         * but without its uLong limit
+         * @param input_size Size of the input data in bytes
+         * @return The size in bytes
+         */
+        static constexpr size_t bound(size_t input_size) noexcept
+        {
+            return input_size + (input_size >> 12) + (input_size >> 14) + (input_size >> 25) + 13;
+        }
+
+        /**
+         * @brief Compress a block of data
+         * @param input Pointer to the input data
+         * @param input_size Size of the input data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Size of the output buffer in bytes
+         * @return The size of the compressed data in bytes
+         */
+        size_t compress(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size)
+        {
+            static_cast<void>(deflateReset(_stream.get()));
+            return basic_detail::zlib_drive(*_stream, input, input_size, output, output_size, [](z_stream &stream, bool last) {
+                return deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+            });
+        }
+
+    private:
+        std::unique_ptr<z_stream, basic_detail::deflate_deleter> _stream;
+    };
+
+    template <>
+    class basic_decompressor<codec::zlib>
+    {
+    public:
+        basic_decompressor() : _stream(new z_stream())
+        {
+            if (inflateInit2(_stream.get(), 15) != Z_OK)
+            {
+                delete _stream.release();
+                throw std::runtime_error("Failed to initialize zlib decompressor");
+            }
+        }
+
+        /**
+         * @brief Decompress a block of data
+         * @param input Pointer to the compressed data
+         * @param input_size Size of the compressed data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Size of the output buffer in bytes
+         * @return The size of the decompressed data in bytes
+         */
+        size_t decompress(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size)
+        {
+            static_cast<void>(inflateReset(_stream.get()));
+            return basic_detail::zlib_drive(*_stream, input, input_size, output, output_size, [](z_stream &stream, bool) {
+                return inflate(&stream, Z_NO_FLUSH);
+            });
+        }
+
+    private:
+        std::unique_ptr<z_stream, basic_detail::inflate_deleter> _stream;
+    };
+#endif
+
+    template <int Level>
+    class basic_compressor<codec::zstd, Level>
+    {
+        static_assert(Level >= basic_codec_traits<codec::zstd>::min_level && Level <= basic_codec_traits<codec::zstd>::max_level, "Zstandard level out of range");
+
+    public:
+        basic_compressor() : _ctx(ZSTD_createCCtx())
+        {
+            if (!_ctx)
+            {
+                throw std::runtime_error("Failed to create Zstandard context");
+            }
+        }
+
+        /**
+         * @brief Maximum compressed size of a block
+         * @param input_size Size of the input data in bytes
+         * @return The size in bytes
+         */
+        static constexpr size_t bound(size_t input_size) noexcept
+        {
+            return ZSTD_COMPRESSBOUND(input_size);
+        }
+
+        /**
+         * @brief Compress a block of data
+         * @param input Pointer to the input data
+         * @param input_size Size of the input data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Size of the output buffer in bytes
+         * @return The size of the compressed data in bytes
+         */
+        size_t compress(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size)
+        {
+            const size_t compressed_size = ZSTD_compressCCtx(_ctx.get(), output, output_size, input, input_size, Level);
+            if (ZSTD_isError(compressed_size))
+            {
+                throw std::runtime_error("Zstandard compression failed: " + std::string(ZSTD_getErrorName(compressed_size)));
+            }
+            return compressed_size;
+        }
+
+    private:
+        std::unique_ptr<ZSTD_CCtx, basic_detail::zstd_cctx_deleter> _ctx;
+    };
+
+    template <>
+    class basic_decompressor<codec::zstd>
+    {
+    public:
+        basic_decompressor() : _ctx(ZSTD_createDCtx())
+        {
+            if (!_ctx)
+            {
+                throw std::runtime_error("Failed to create Zstandard context");
+            }
+        }
+
+        /**
+         * @brief Decompress a block of data
+         * @param input Pointer to the compressed data
+         * @param input_size Size of the compressed data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Size of the output buffer in bytes
+         * @return The size of the decompressed data in bytes
+         */
+        size_t decompress(const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size)
+        {
+            const size_t decompressed_size = ZSTD_decompressDCtx(_ctx.get(), output, output_size, input, input_size);
+            if (ZSTD_isError(decompressed_size))
+            {
+                throw std::runtime_error("Zstandard decompression failed: " + std::string(ZSTD_getErrorName(decompressed_size)));
+            }
+            return decompressed_size;
+        }
+
+    private:
+        std::unique_ptr<ZSTD_DCtx, basic_detail::zstd_dctx_deleter> _ctx;
+    };
+
+    /**
+     * @class basic_compressor_adapter
+     * @brief Virtual compressor interface on top of a basic_compressor
+     */
+    template <codec Codec, int Level = basic_codec_traits<Codec>::default_level>
+    class basic_compressor_adapter final : public compressor
+    {
+    public:
+        size_t compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            if (output == nullptr)
+            {
+                output_size = _compressor.bound(input_size);
+                return 0;
+            }
+            return _compressor.compress(input, input_size, output, output_size);
+        }
+
+    private:
+        basic_compressor<Codec, Level> _compressor;
+    };
+
+    /**
+     * @class basic_decompressor_adapter
+     * @brief Virtual decompressor interface on top of a basic_decompressor
+     */
+    template <codec Codec>
+    class basic_decompressor_adapter final : public decompressor
+    {
+    public:
+        size_t decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) override
+        {
+            return _decompressor.decompress(input, input_size, output, output_size);
+        }
+
+    private:
+        basic_decompressor<Codec> _decompressor;
+    };
+
+    /**
+     * @brief Create a compressor backed by a basic_compressor
+     * @return Pointer to the compressor
+     */
+    template <codec Codec, int Level = basic_codec_traits<Codec>::default_level>
+    compressor *create_basic_compressor()
+    {
+        return new basic_compressor_adapter<Codec, Level>();
+    }
+
+    /**
+     * @brief Create a decompressor backed by a basic_decompressor
+     * @return Pointer to the decompressor
+     */
+    template <codec Codec>
+    decompressor *create_basic_decompressor()
+    {
+        return new basic_decompressor_adapter<Codec>();
+    }
+}
+
+#endif
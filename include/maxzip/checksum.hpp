@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MAXZIP_CHECKSUM_HPP
+#define MAXZIP_CHECKSUM_HPP
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+#include <array>
+
+namespace maxzip
+{
+    /**
+     * @brief Size in bytes of the checksum appended to each checksummed block
+     */
+    static constexpr size_t checksum_size = 4;
+
+    /**
+     * @brief Compute or extend a CRC32C (Castagnoli) checksum. The SSE4.2 crc32
+     * instruction is used when the processor has it, and a table otherwise.
+     * @param data Pointer to the data
+     * @param size Size of the data in bytes
+     * @param crc Checksum of the preceding data, or 0 to start a new one
+     * @return The checksum
+     */
+    uint32_t crc32c(const uint8_t *data, size_t size, uint32_t crc = 0) noexcept;
+
+    /**
+     * @brief A SHA-256 digest
+     */
+    using sha256_digest = std::array<uint8_t, 32>;
+
+    /**
+     * @brief Compute the SHA-256 digest of a buffer. The SHA extensions are used
+     * when the processor has them.
+     * @param data Pointer to the data
+     * @param size Size of the data in bytes
+     * @return The digest
+     */
+    sha256_digest sha256(const uint8_t *data, size_t size) noexcept;
+
+    /**
+     * @brief Wrap a compressor so that each block is followed by the CRC32C of
+     * its uncompressed data, stored little-endian. This works the same for every
+     * codec, including those with no integrity check of their own.
+     * @param compressor The compressor to wrap, which the new object takes ownership of
+     * @return The checksumming compressor
+     */
+    compressor *create_checksummed_compressor(compressor *compressor);
+
+    /**
+     * @brief Wrap a decompressor so that it reads blocks written by a checksummed
+     * compressor and fails if the decompressed data does not match the checksum
+     * @param decompressor The decompressor to wrap, which the new object takes ownership of
+     * @return The verifying decompressor
+     */
+    decompressor *create_checksummed_decompressor(decompressor *decompressor);
+}
+
+#endif
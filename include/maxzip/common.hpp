@@ -25,6 +25,103 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <functional>
+#include <memory>
 #include <optional>
+#include <vector>
+
+namespace maxzip
+{
+    /**
+     * @brief Compression formats that can be identified inside a maxzip envelope
+     */
+    enum class codec : uint8_t
+    {
+        stored = 0,
+        brotli = 1,
+        zlib = 2,
+        zstd = 3,
+        lz4 = 4,
+    };
+
+    /**
+     * @brief Outcome of a non-throwing codec call
+     */
+    enum class status : uint8_t
+    {
+        ok = 0,
+        insufficient_output = 1,
+        corrupt_input = 2,
+        failed = 3,
+    };
+
+    /**
+     * @brief Status and size returned by the non-throwing codec calls. On
+     * success, size is the number of bytes written. When the output buffer is
+     * too small, size is the number of bytes needed, or 0 if that cannot be
+     * known without decoding the data. Otherwise, size is 0.
+     */
+    struct codec_result
+    {
+        maxzip::status status;
+        size_t size;
+
+        explicit operator bool() const noexcept
+        {
+            return status == maxzip::status::ok;
+        }
+    };
+
+    /**
+     * @brief Read-only view of a contiguous block of memory
+     */
+    struct input_buffer
+    {
+        const uint8_t *data;
+        size_t size;
+    };
+
+    /**
+     * @brief Writable view of a contiguous block of memory
+     */
+    struct output_buffer
+    {
+        uint8_t *data;
+        size_t size;
+    };
+
+    /**
+     * @brief Location of one result within a batch output buffer
+     */
+    struct batch_entry
+    {
+        size_t offset;
+        size_t size;
+    };
+
+    /**
+     * @class allocator
+     * @brief Abstract base class for the memory used by codec contexts. Returned
+     * blocks must be suitably aligned for any fundamental type, as with malloc.
+     */
+    class allocator
+    {
+    public:
+        virtual ~allocator() = default;
+
+        /**
+         * @brief Allocate a block of memory
+         * @param size Size of the block in bytes
+         * @return Pointer to the block, or nullptr on failure
+         */
+        virtual void *allocate(size_t size) = 0;
+
+        /**
+         * @brief Release a block returned by allocate
+         * @param address Pointer to the block
+         */
+        virtual void deallocate(void *address) = 0;
+    };
+}
 
 #endif
\ No newline at end of file
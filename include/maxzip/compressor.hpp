@@ -24,6 +24,7 @@
 #define MAXZIP_COMPRESSOR_HPP
 
 #include "common.hpp"
+#include "dictionary.hpp"
 
 namespace maxzip
 {
@@ -34,6 +35,8 @@ namespace maxzip
     class compressor
     {
     public:
+        virtual ~compressor() = default;
+
         /**
          * @brief Compress a block of data
          * @param input Pointer to the input data
@@ -48,13 +51,88 @@ namespace maxzip
             size_t input_size,
             uint8_t *output,
             size_t &output_size) = 0;
+
+        /**
+         * @brief Compress a batch of independent blocks into one contiguous buffer
+         * @param inputs Pointer to the input blocks
+         * @param input_count Number of input blocks
+         * @param output Buffer that receives the compressed blocks back to back. It
+         * is grown as needed but never shrunk, so it can be reused across calls
+         * without reallocating.
+         * @param entries Pointer to one entry per input block, which receives the
+         * offset and size of the compressed block within output
+         * @return The total size of the compressed blocks in bytes
+         */
+        virtual size_t compress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            std::vector<uint8_t> &output,
+            batch_entry *entries);
+
+        /**
+         * @brief Compress a block of data into a buffer sized by the compressor
+         * @param input Pointer to the input data
+         * @param input_size Size of the input data in bytes
+         * @param output Buffer that receives the compressed data. It is resized to
+         * the compressed size, and its capacity is reused across calls.
+         * @return The size of the compressed data in bytes
+         */
+        virtual size_t compress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output);
+
+        /**
+         * @brief Compress a block of data without throwing. Routine failures, such
+         * as an undersized output buffer, are reported in the result and do not
+         * allocate.
+         * @param input Pointer to the input data
+         * @param input_size Size of the input data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Size of the output buffer in bytes
+         * @return The status and the compressed size. If the output buffer is too
+         * small, the size is the maximum compressed size.
+         */
+        virtual codec_result try_compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept;
+
+        /**
+         * @brief Compress data gathered from several buffers into one block that is
+         * scattered across several buffers. The block is the same as compressing the
+         * concatenated input, and the output buffers are filled in order.
+         *
+         * Brotli, zlib and zstd pass each buffer to their streaming API, although
+         * the libraries still copy data through their own window and block
+         * buffers. The other backends gather and scatter through one temporary
+         * buffer.
+         * @param inputs Pointer to the input buffers
+         * @param input_count Number of input buffers
+         * @param outputs Pointer to the output buffers
+         * @param output_count Number of output buffers
+         * @return The size of the compressed data in bytes
+         */
+        virtual size_t compressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count);
     };
 
+    /**
+     * @brief Function that creates a new compressor instance
+     */
+    using compressor_factory = std::function<compressor *()>;
+
     struct brotli_compressor_params
     {
         std::optional<int> quality;
         std::optional<int> window_size;
         std::optional<int> mode;
+        std::shared_ptr<maxzip::allocator> allocator;
+        std::shared_ptr<maxzip::dictionary> dictionary;
     };
 
     struct zlib_compressor_params
@@ -63,8 +141,36 @@ namespace maxzip
         std::optional<int> window_bits;
         std::optional<int> mem_level;
         std::optional<int> strategy;
+        std::shared_ptr<maxzip::allocator> allocator;
+        std::shared_ptr<maxzip::dictionary> dictionary;
     };
 
+    /**
+     * @class zstd_thread_pool
+     * @brief Worker threads shared by any number of zstd compressors and encoders
+     * that have nb_workers set, so that a process with many contexts keeps a
+     * bounded number of threads. Compression jobs from all of them are queued on
+     * the pool.
+     */
+    class zstd_thread_pool
+    {
+    public:
+        virtual ~zstd_thread_pool() = default;
+
+        /**
+         * @brief Get the number of worker threads
+         * @return The number of threads
+         */
+        virtual size_t size() const = 0;
+    };
+
+    /**
+     * @brief Create a thread pool for zstd compressors
+     * @param thread_count Number of worker threads
+     * @return A new thread pool
+     */
+    zstd_thread_pool *create_zstd_thread_pool(size_t thread_count);
+
     struct zstd_compressor_params
     {
         std::optional<int> level;
@@ -79,11 +185,31 @@ namespace maxzip
         std::optional<bool> enable_content_size;
         std::optional<bool> enable_checksum;
         std::optional<bool> enable_dict_id;
+        std::optional<int> nb_workers;
+        std::optional<int> job_size;
+        std::optional<int> overlap_log;
+        std::shared_ptr<maxzip::allocator> allocator;
+        std::shared_ptr<maxzip::dictionary> dictionary;
+        std::shared_ptr<maxzip::zstd_thread_pool> thread_pool;
+    };
+
+    /**
+     * @brief LZ4 block compressor settings. By default, the fast compressor is
+     * used with the given acceleration. Setting level selects the LZ4HC
+     * compressor instead, which is slower but produces the same block format.
+     */
+    struct lz4_compressor_params
+    {
+        std::optional<int> acceleration;
+        std::optional<int> level;
+        std::shared_ptr<maxzip::allocator> allocator;
+        std::shared_ptr<maxzip::dictionary> dictionary;
     };
 
     compressor *create_brotli_compressor(const brotli_compressor_params &params = {});
     compressor *create_zlib_compressor(const zlib_compressor_params &params = {});
     compressor *create_zstd_compressor(const zstd_compressor_params &params = {});
+    compressor *create_lz4_compressor(const lz4_compressor_params &params = {});
 }
 
 #endif
\ No newline at end of file
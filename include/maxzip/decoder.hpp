@@ -25,6 +25,7 @@
 #define MAXZIP_DECODER_HPP
 
 #include "common.hpp"
+#include "decompressor.hpp"
 
 namespace maxzip
 {
@@ -35,17 +36,45 @@ namespace maxzip
     class decoder
     {
     public:
-        void init();
-        void update(
-            const uint8_t* input,
+        virtual ~decoder() = default;
+
+        /**
+         * @brief Begin a new stream, discarding any state from the previous one
+         */
+        virtual void init() = 0;
+
+        /**
+         * @brief Decompress the next portion of a stream
+         * @param input Pointer to the compressed input data
+         * @param input_size Size of the compressed input data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Reference to the size of the output buffer on input. On
+         * return, this will be set to the number of bytes written.
+         * @return The number of input bytes consumed. If this is less than input_size,
+         * the output buffer is full and the remaining input must be passed again.
+         */
+        virtual size_t update(
+            const uint8_t *input,
             size_t input_size,
-            uint8_t* output,
-            size_t& output_size);
-        void finish(
-            uint8_t* output,
-            size_t& output_size);
+            uint8_t *output,
+            size_t &output_size) = 0;
+
+        /**
+         * @brief Flush any buffered data once all input has been passed to update
+         * @param output Pointer to the output buffer
+         * @param output_size Reference to the size of the output buffer on input. On
+         * return, this will be set to the number of bytes written.
+         * @return True if the stream is complete, or false if the output buffer is
+         * full and finish must be called again. Throws if the stream is truncated.
+         */
+        virtual bool finish(
+            uint8_t *output,
+            size_t &output_size) = 0;
     };
 
+    decoder *create_brotli_decoder(const brotli_decompressor_params &params = {});
+    decoder *create_zlib_decoder(const zlib_decompressor_params &params = {});
+    decoder *create_zstd_decoder(const zstd_decompressor_params &params = {});
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -2,6 +2,7 @@
 #define MAXZIP_DECOMPRESSOR_HPP
 
 #include "common.hpp"
+#include "dictionary.hpp"
 
 namespace maxzip
 {
@@ -12,6 +13,8 @@ namespace maxzip
     class decompressor
     {
     public:
+        virtual ~decompressor() = default;
+
         /**
          * @brief Decompress a block of data
          * @param input Pointer to the compressed input data
@@ -26,26 +29,123 @@ namespace maxzip
             size_t input_size,
             uint8_t *output,
             size_t output_size) = 0;
+
+        /**
+         * @brief Decompress a batch of independent blocks into one contiguous buffer
+         * @param inputs Pointer to the compressed input blocks
+         * @param input_count Number of input blocks
+         * @param output_sizes Pointer to the decompressed size of each block, or an
+         * upper bound on it
+         * @param output Buffer that receives the decompressed blocks back to back.
+         * It is grown as needed but never shrunk, so it can be reused across calls
+         * without reallocating.
+         * @param entries Pointer to one entry per input block, which receives the
+         * offset and size of the decompressed block within output
+         * @return The total size of the decompressed blocks in bytes
+         */
+        virtual size_t decompress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            const size_t *output_sizes,
+            std::vector<uint8_t> &output,
+            batch_entry *entries);
+
+        /**
+         * @brief Get the decompressed size recorded in the compressed data
+         * @param input Pointer to the compressed input data
+         * @param input_size Size of the compressed input data in bytes
+         * @return The decompressed size in bytes, or nullopt if the format does
+         * not record it or the recorded size is more than the input could expand to
+         */
+        virtual std::optional<size_t> decompressed_size(
+            const uint8_t *input,
+            size_t input_size);
+
+        /**
+         * @brief Decompress a block of data into a buffer sized by the decompressor.
+         * The buffer is sized exactly when decompressed_size() reports the size,
+         * and grown geometrically otherwise.
+         * @param input Pointer to the compressed input data
+         * @param input_size Size of the compressed input data in bytes
+         * @param output Buffer that receives the decompressed data. It is resized to
+         * the decompressed size, and its capacity is reused across calls.
+         * @return The size of the decompressed data in bytes
+         */
+        virtual size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output);
+
+        /**
+         * @brief Decompress a block of data without throwing. Routine failures,
+         * such as an undersized output buffer or corrupt input, are reported in the
+         * result and do not allocate.
+         * @param input Pointer to the compressed input data
+         * @param input_size Size of the compressed input data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Size of the output buffer in bytes
+         * @return The status and the decompressed size. If the output buffer is too
+         * small, the size is the decompressed size when it is recorded in the data,
+         * and 0 otherwise.
+         */
+        virtual codec_result try_decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept;
+
+        /**
+         * @brief Decompress a block gathered from several buffers into data that is
+         * scattered across several buffers, which are filled in order. Data is
+         * copied as described for compressor::compressv.
+         * @param inputs Pointer to the compressed input buffers
+         * @param input_count Number of input buffers
+         * @param outputs Pointer to the output buffers
+         * @param output_count Number of output buffers
+         * @return The size of the decompressed data in bytes
+         */
+        virtual size_t decompressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count);
     };
 
+    /**
+     * @brief Function that creates a new decompressor instance
+     */
+    using decompressor_factory = std::function<decompressor *()>;
+
     struct brotli_decompressor_params
     {
         std::optional<int> unused;
+        std::shared_ptr<maxzip::allocator> allocator;
+        std::shared_ptr<maxzip::dictionary> dictionary;
     };
 
     struct zlib_decompressor_params
     {
         std::optional<int> window_bits;
+        std::shared_ptr<maxzip::allocator> allocator;
+        std::shared_ptr<maxzip::dictionary> dictionary;
     };
 
     struct zstd_decompressor_params
     {
         std::optional<int> window_log_max;
+        std::shared_ptr<maxzip::allocator> allocator;
+        std::shared_ptr<maxzip::dictionary> dictionary;
+    };
+
+    struct lz4_decompressor_params
+    {
+        std::shared_ptr<maxzip::dictionary> dictionary;
     };
 
     decompressor *create_brotli_decompressor(const brotli_decompressor_params &params = {});
     decompressor *create_zlib_decompressor(const zlib_decompressor_params &params = {});
     decompressor *create_zstd_decompressor(const zstd_decompressor_params &params = {});
+    decompressor *create_lz4_decompressor(const lz4_decompressor_params &params = {});
 }
 
 #endif
\ No newline at end of file
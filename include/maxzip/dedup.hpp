@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MAXZIP_DEDUP_HPP
+#define MAXZIP_DEDUP_HPP
+
+#include "checksum.hpp"
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+#include <deque>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace maxzip
+{
+    struct chunker_params
+    {
+        std::optional<size_t> min_size;
+        std::optional<size_t> average_size;
+        std::optional<size_t> max_size;
+    };
+
+    /**
+     * @class chunker
+     * @brief Content-defined chunker in the style of FastCDC. Boundaries are
+     * placed where a gear rolling hash of the last bytes matches a mask, so
+     * repeated content is cut into the same chunks wherever it appears, and an
+     * insertion only moves the boundaries near it. A stricter mask below the
+     * average size and a looser one above it keep chunk sizes close to the
+     * average.
+     */
+    class chunker
+    {
+    public:
+        /**
+         * @brief Create a chunker
+         * @param params Chunk sizes. The defaults are 16 KiB, 64 KiB and 256 KiB.
+         */
+        explicit chunker(const chunker_params &params = {});
+
+        /**
+         * @brief Find the end of the first chunk of the data
+         * @param data Pointer to the data
+         * @param size Size of the data in bytes
+         * @return The size of the first chunk in bytes, which is all of the data
+         * if it is no longer than the minimum chunk size
+         */
+        size_t next(const uint8_t *data, size_t size) const;
+
+        /**
+         * @brief Get the minimum chunk size. Only the last chunk of the data can
+         * be smaller.
+         * @return The size in bytes
+         */
+        size_t min_size() const;
+
+        /**
+         * @brief Get the maximum chunk size
+         * @return The size in bytes
+         */
+        size_t max_size() const;
+
+    private:
+        size_t _min_size;
+        size_t _average_size;
+        size_t _max_size;
+        uint64_t _small_mask;
+        uint64_t _large_mask;
+    };
+
+    /**
+     * @brief Compressed chunk held by a dedup store
+     */
+    struct stored_chunk
+    {
+        /**
+         * @brief SHA-256 digest of the chunk before compression
+         */
+        sha256_digest key;
+
+        input_buffer compressed;
+
+        /**
+         * @brief Size of the chunk before compression
+         */
+        size_t size;
+    };
+
+    /**
+     * @class dedup_store
+     * @brief Thread-safe, append-only store of compressed chunks keyed by their
+     * content, so each distinct chunk is compressed and kept once. Chunks are
+     * keyed by the SHA-256 digest of their content. Chunk IDs are assigned in
+     * order from 0 and stay valid for the life of the store, and a store written
+     * with save() and read back with load() keeps them.
+     */
+    class dedup_store
+    {
+    public:
+        dedup_store();
+
+        /**
+         * @brief Find a stored chunk with the given content
+         * @param data Pointer to the chunk content
+         * @param size Size of the chunk in bytes
+         * @return The chunk ID, or nothing if the content is not stored
+         */
+        std::optional<uint64_t> find(const uint8_t *data, size_t size) const;
+
+        /**
+         * @brief Find a stored chunk by its key
+         * @param key SHA-256 digest of the chunk content
+         * @return The chunk ID, or nothing if the content is not stored
+         */
+        std::optional<uint64_t> find(const sha256_digest &key) const;
+
+        /**
+         * @brief Add a compressed chunk. If a chunk with the same content was
+         * added in the meantime, that chunk is kept and its ID is returned.
+         * @param data Pointer to the chunk content
+         * @param size Size of the chunk in bytes
+         * @param compressed The compressed chunk
+         * @return The chunk ID
+         */
+        uint64_t insert(const uint8_t *data, size_t size, std::vector<uint8_t> compressed);
+
+        /**
+         * @brief Add a chunk that was keyed and compressed elsewhere, such as by
+         * a dedup store on another host. The key is not checked against the
+         * content.
+         * @param key SHA-256 digest of the chunk content
+         * @param size Size of the chunk in bytes, which must fit in 32 bits and
+         * be no more than the compressed chunk can expand to
+         * @param compressed The compressed chunk
+         * @return The chunk ID
+         * @throws std::invalid_argument if the size is out of range, or a chunk
+         * with the same key has a different size
+         */
+        uint64_t insert(const sha256_digest &key, size_t size, std::vector<uint8_t> compressed);
+
+        /**
+         * @brief Get a stored chunk. The compressed data stays valid for the life
+         * of the store.
+         * @param id The chunk ID
+         * @return The chunk
+         */
+        stored_chunk get(uint64_t id) const;
+
+        /**
+         * @brief Get the number of stored chunks
+         * @return The number of chunks
+         */
+        size_t chunk_count() const;
+
+        /**
+         * @brief Get the total size of the stored chunks
+         * @return The compressed size in bytes
+         */
+        size_t stored_size() const;
+
+        /**
+         * @brief Write the keys, sizes and compressed data of every chunk, in ID
+         * order, so that the store can be restored with load()
+         * @param output The buffer that is replaced with the store image
+         */
+        void save(std::vector<uint8_t> &output) const;
+
+        /**
+         * @brief Restore the chunks written by save() into this store, which
+         * must be empty. Chunk IDs are the same as in the saved store.
+         * @param input Pointer to the store image
+         * @param input_size Size of the store image in bytes
+         * @throws std::runtime_error if the store is not empty or the image is
+         * invalid
+         */
+        void load(const uint8_t *input, size_t input_size);
+
+    private:
+        struct entry
+        {
+            sha256_digest key;
+            size_t size;
+            std::vector<uint8_t> compressed;
+        };
+
+        struct key_hash
+        {
+            size_t operator()(const sha256_digest &key) const noexcept;
+        };
+
+        uint64_t append(const sha256_digest &key, size_t size, std::vector<uint8_t> compressed);
+
+        mutable std::shared_mutex _mutex;
+        // a deque keeps entries in place as it grows
+        std::deque<entry> _chunks;
+        std::unordered_map<sha256_digest, uint64_t, key_hash> _index;
+        size_t _stored_size;
+    };
+
+    /**
+     * @brief Create a compressor that cuts each block into content-defined chunks
+     * and adds the chunks that are not yet in the store, compressed with the
+     * given compressor. Its output is a manifest that lists the chunks by ID, so
+     * repeated content is only compressed and stored once.
+     * @param store The store that receives the chunks
+     * @param compressor The compressor for chunk content, which the new object takes ownership of
+     * @param params Chunk sizes
+     * @return The deduplicating compressor
+     */
+    compressor *create_dedup_compressor(
+        std::shared_ptr<dedup_store> store,
+        compressor *compressor,
+        const chunker_params &params = {});
+
+    /**
+     * @brief Create a decompressor that reassembles blocks from the manifests of
+     * a dedup compressor. A chunk that appears more than once in a block is
+     * decompressed once and copied.
+     * @param store The store that holds the chunks
+     * @param decompressor The decompressor for chunk content, which the new object takes ownership of
+     * @return The reassembling decompressor
+     */
+    decompressor *create_dedup_decompressor(
+        std::shared_ptr<dedup_store> store,
+        decompressor *decompressor);
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MAXZIP_DICTIONARY_HPP
+#define MAXZIP_DICTIONARY_HPP
+
+#include "common.hpp"
+
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace maxzip
+{
+    /**
+     * @class dictionary
+     * @brief Immutable compression dictionary that can be shared by any number of
+     * contexts. The digested form each backend needs is built on first use and then
+     * reused by every context that refers to the dictionary.
+     */
+    class dictionary
+    {
+    public:
+        virtual ~dictionary() = default;
+
+        /**
+         * @brief Get the dictionary ID. This is the ID stored in a zstd dictionary
+         * header, or a hash of the content for raw dictionaries.
+         * @return The dictionary ID
+         */
+        virtual uint32_t id() const = 0;
+
+        /**
+         * @brief Get the dictionary content
+         * @return Pointer to the dictionary content
+         */
+        virtual const uint8_t *data() const = 0;
+
+        /**
+         * @brief Get the size of the dictionary content
+         * @return Size of the dictionary content in bytes
+         */
+        virtual size_t size() const = 0;
+    };
+
+    /**
+     * @brief Create a dictionary from trained or raw content. The content is copied.
+     * @param data Pointer to the dictionary content
+     * @param size Size of the dictionary content in bytes
+     * @return A new dictionary
+     */
+    dictionary *create_dictionary(const uint8_t *data, size_t size);
+
+    /**
+     * @brief Train a dictionary from a set of samples
+     * @param samples Pointer to the samples, stored back to back
+     * @param sample_sizes Pointer to the size of each sample in bytes
+     * @param sample_count Number of samples
+     * @param output Pointer to the output buffer for the dictionary
+     * @param output_size Size of the output buffer, which is the maximum
+     * dictionary size
+     * @return The size of the trained dictionary in bytes
+     */
+    size_t train_dictionary(
+        const uint8_t *samples,
+        const size_t *sample_sizes,
+        size_t sample_count,
+        uint8_t *output,
+        size_t output_size);
+
+    /**
+     * @class dictionary_cache
+     * @brief Thread-safe set of dictionaries keyed by dictionary ID, so that all
+     * contexts using the same dictionary share one digested copy
+     */
+    class dictionary_cache
+    {
+    public:
+        /**
+         * @brief Find a dictionary by ID
+         * @param id The dictionary ID
+         * @return The dictionary, or nullptr if it is not cached
+         */
+        std::shared_ptr<dictionary> find(uint32_t id) const;
+
+        /**
+         * @brief Get the cached dictionary with the ID of the given content, creating
+         * and caching it if needed
+         * @param data Pointer to the dictionary content
+         * @param size Size of the dictionary content in bytes
+         * @return The cached dictionary
+         */
+        std::shared_ptr<dictionary> load(const uint8_t *data, size_t size);
+
+        /**
+         * @brief Remove a dictionary from the cache. Contexts that hold it are not
+         * affected.
+         * @param id The dictionary ID
+         */
+        void erase(uint32_t id);
+
+        /**
+         * @brief Get the number of cached dictionaries
+         * @return The number of cached dictionaries
+         */
+        size_t size() const;
+
+    private:
+        mutable std::shared_mutex _mutex;
+        std::unordered_map<uint32_t, std::shared_ptr<dictionary>> _dictionaries;
+    };
+}
+
+#endif
@@ -25,6 +25,7 @@
 #define MAXZIP_ENCODER_HPP
 
 #include "common.hpp"
+#include "compressor.hpp"
 
 namespace maxzip
 {
@@ -35,16 +36,45 @@ namespace maxzip
     class encoder
     {
     public:
-        void init();
-        void update(
-            const uint8_t* input, 
-            size_t input_size, 
-            uint8_t* output, 
-            size_t& output_size);
-        void finish(
-            uint8_t* output, 
-            size_t& output_size);
+        virtual ~encoder() = default;
+
+        /**
+         * @brief Begin a new stream, discarding any state from the previous one
+         */
+        virtual void init() = 0;
+
+        /**
+         * @brief Compress the next portion of a stream
+         * @param input Pointer to the input data
+         * @param input_size Size of the input data in bytes
+         * @param output Pointer to the output buffer
+         * @param output_size Reference to the size of the output buffer on input. On
+         * return, this will be set to the number of bytes written.
+         * @return The number of input bytes consumed. If this is less than input_size,
+         * the output buffer is full and the remaining input must be passed again.
+         */
+        virtual size_t update(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) = 0;
+
+        /**
+         * @brief Flush any buffered data and end the stream
+         * @param output Pointer to the output buffer
+         * @param output_size Reference to the size of the output buffer on input. On
+         * return, this will be set to the number of bytes written.
+         * @return True if the stream is complete, or false if the output buffer is
+         * full and finish must be called again.
+         */
+        virtual bool finish(
+            uint8_t *output,
+            size_t &output_size) = 0;
     };
+
+    encoder *create_brotli_encoder(const brotli_compressor_params &params = {});
+    encoder *create_zlib_encoder(const zlib_compressor_params &params = {});
+    encoder *create_zstd_encoder(const zstd_compressor_params &params = {});
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MAXZIP_FILE_HPP
+#define MAXZIP_FILE_HPP
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decoder.hpp"
+#include "decompressor.hpp"
+
+#include <string>
+
+namespace maxzip
+{
+    /**
+     * @brief Compress a whole file. On POSIX systems the input is memory mapped
+     * and the output is written through a mapping of the compression bound,
+     * which is checked against the free space but not allocated, so the data
+     * is never copied into intermediate buffers.
+     * @param input_path Path of the file to compress
+     * @param output_path Path of the compressed file, which is created or replaced
+     * @param compressor Compressor used for the whole file
+     * @return The size of the compressed file in bytes
+     * @throws std::invalid_argument if both paths name the same file
+     */
+    size_t compress_file(
+        const std::string &input_path,
+        const std::string &output_path,
+        compressor &compressor);
+
+    /**
+     * @brief Decompress a whole file. When the decompressed size is recorded in
+     * the data and the input could expand to it, the output is written through
+     * a preallocated mapping. Otherwise, on POSIX systems, the output is written
+     * through a mapping that starts at 64 KiB and doubles until the data fits,
+     * so beyond that it never reserves more than twice the output, and a
+     * decompressor that cannot report a short output falls back to
+     * decompressing in memory.
+     * @param input_path Path of the compressed file
+     * @param output_path Path of the decompressed file, which is created or replaced
+     * @param decompressor Decompressor used for the whole file
+     * @return The size of the decompressed file in bytes
+     * @throws std::invalid_argument if both paths name the same file
+     */
+    size_t decompress_file(
+        const std::string &input_path,
+        const std::string &output_path,
+        decompressor &decompressor);
+
+    /**
+     * @brief Decompress a whole file as one stream, writing the output as it is
+     * produced through a fixed buffer, so memory use does not depend on the
+     * decompressed size
+     * @param input_path Path of the compressed file
+     * @param output_path Path of the decompressed file, which is created or replaced
+     * @param decoder Decoder used for the whole file
+     * @return The size of the decompressed file in bytes
+     * @throws std::invalid_argument if both paths name the same file
+     */
+    size_t decompress_file(
+        const std::string &input_path,
+        const std::string &output_path,
+        decoder &decoder);
+}
+
+#endif
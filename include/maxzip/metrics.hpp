@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MAXZIP_METRICS_HPP
+#define MAXZIP_METRICS_HPP
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+#include <array>
+#include <map>
+#include <string>
+
+namespace maxzip
+{
+    static constexpr size_t metrics_histogram_size = 40;
+
+    /**
+     * @brief Counters for the calls made through an instrumented compressor or
+     * decompressor. Bound queries are not counted.
+     */
+    struct codec_metrics
+    {
+        uint64_t calls = 0;
+        uint64_t failures = 0;
+        uint64_t uncompressed_bytes = 0;
+        uint64_t compressed_bytes = 0;
+        uint64_t total_nanoseconds = 0;
+
+        /**
+         * @brief Entry i counts the calls that took less than 2^(i+1) and at
+         * least 2^i nanoseconds. The last entry also holds all slower calls.
+         */
+        std::array<uint64_t, metrics_histogram_size> latency_histogram = {};
+
+        /**
+         * @brief Get the achieved compression ratio
+         * @return Uncompressed bytes divided by compressed bytes, or 0 if nothing
+         * was processed
+         */
+        double ratio() const;
+
+        /**
+         * @brief Estimate a latency percentile from the histogram
+         * @param fraction Percentile as a fraction between 0 and 1
+         * @return Upper edge in nanoseconds of the bucket holding the percentile
+         */
+        uint64_t latency_percentile(double fraction) const;
+    };
+
+    /**
+     * @class instrumented_compressor
+     * @brief Compressor that counts the calls it forwards to another compressor
+     */
+    class instrumented_compressor : public compressor
+    {
+    public:
+        /**
+         * @brief Get the counters of this instance
+         * @return A snapshot of the counters
+         */
+        virtual codec_metrics metrics() const = 0;
+    };
+
+    /**
+     * @class instrumented_decompressor
+     * @brief Decompressor that counts the calls it forwards to another decompressor
+     */
+    class instrumented_decompressor : public decompressor
+    {
+    public:
+        /**
+         * @brief Get the counters of this instance
+         * @return A snapshot of the counters
+         */
+        virtual codec_metrics metrics() const = 0;
+    };
+
+    /**
+     * @brief Check whether the library was built with MAXZIP_METRICS. Without it,
+     * instrumented objects forward calls without timing or counting them.
+     * @return True if counters are recorded
+     */
+    bool metrics_enabled();
+
+    /**
+     * @brief Wrap a compressor so that its calls are counted. Counters are kept
+     * per instance and written only by the thread using it, so recording them
+     * takes no locks. They are also added to the process-wide registry under
+     * name + ".compress".
+     * @param compressor The compressor to wrap, which the new object takes ownership of
+     * @param name Registry key, usually naming the codec and its parameters
+     * @return The instrumented compressor
+     */
+    instrumented_compressor *create_instrumented_compressor(compressor *compressor, const std::string &name);
+
+    /**
+     * @brief Wrap a decompressor so that its calls are counted. Counters are added
+     * to the process-wide registry under name + ".decompress".
+     * @param decompressor The decompressor to wrap, which the new object takes
+     * ownership of
+     * @param name Registry key, usually naming the codec and its parameters
+     * @return The instrumented decompressor
+     */
+    instrumented_decompressor *create_instrumented_decompressor(decompressor *decompressor, const std::string &name);
+
+    /**
+     * @brief Sum the counters of all instrumented objects, live and destroyed,
+     * by registry key
+     * @return The counters for each key
+     */
+    std::map<std::string, codec_metrics> metrics_snapshot();
+
+    /**
+     * @brief Format a registry snapshot as a JSON object keyed by registry key
+     * @return The JSON text
+     */
+    std::string metrics_json();
+}
+
+#endif
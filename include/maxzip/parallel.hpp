@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MAXZIP_PARALLEL_HPP
+#define MAXZIP_PARALLEL_HPP
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+namespace maxzip
+{
+    struct parallel_compressor_params
+    {
+        std::optional<size_t> chunk_size;
+        std::optional<size_t> thread_count;
+    };
+
+    struct parallel_decompressor_params
+    {
+        std::optional<size_t> thread_count;
+    };
+
+    /**
+     * @brief Create a compressor that splits its input into independent chunks and
+     * compresses them on a pool of worker threads.
+     * @param factory Function used to create one backend compressor per worker
+     * @param params Chunk size and number of worker threads
+     * @return A compressor producing the maxzip parallel frame format
+     */
+    compressor *create_parallel_compressor(
+        const compressor_factory &factory,
+        const parallel_compressor_params &params = {});
+
+    /**
+     * @brief Create a decompressor for the output of a parallel compressor
+     * @param factory Function used to create one backend decompressor per worker
+     * @param params Number of worker threads
+     * @return A decompressor that restores all chunks concurrently
+     */
+    decompressor *create_parallel_decompressor(
+        const decompressor_factory &factory,
+        const parallel_decompressor_params &params = {});
+
+    /**
+     * @brief Create a decompressor for concatenated zstd frames, such as those
+     * written by zstd's multi-threaded mode or appended to one file over time.
+     * Frame boundaries and content sizes are read from the frame headers, and
+     * the frames are decompressed concurrently straight into their final place
+     * in the output. Skippable frames are ignored. If any frame does not record
+     * its content size, the whole input is decompressed serially instead.
+     * @param factory Function used to create one backend zstd decompressor per worker
+     * @param params Number of worker threads
+     * @return A decompressor that restores all frames concurrently
+     */
+    decompressor *create_multiframe_decompressor(
+        const decompressor_factory &factory,
+        const parallel_decompressor_params &params = {});
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MAXZIP_PIPELINE_HPP
+#define MAXZIP_PIPELINE_HPP
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+namespace maxzip
+{
+    /**
+     * @brief Function that reads up to size bytes into buffer and returns the
+     * number of bytes read, or 0 at the end of the input
+     */
+    using read_function = std::function<size_t(uint8_t *buffer, size_t size)>;
+
+    /**
+     * @brief Function that writes all size bytes of data
+     */
+    using write_function = std::function<void(const uint8_t *data, size_t size)>;
+
+    /**
+     * @class pipeline
+     * @brief Streaming engine that overlaps reading, compression and writing.
+     * A reader thread fills fixed-size blocks, worker threads process them with
+     * their own backend instances, and a writer thread emits the results in
+     * order. Blocks are recycled through a bounded free list, so memory use is
+     * capped by the queue depth regardless of the stream length.
+     */
+    class pipeline
+    {
+    public:
+        virtual ~pipeline() = default;
+
+        /**
+         * @brief Process a whole stream
+         * @param read Function used to read the input
+         * @param write Function used to write the output
+         * @return The number of bytes written
+         */
+        virtual uint64_t run(const read_function &read, const write_function &write) = 0;
+
+        /**
+         * @brief Process a whole stream between two file descriptors, such as
+         * files, pipes or sockets
+         * @param input_fd Descriptor the input is read from until end of file
+         * @param output_fd Descriptor the output is written to
+         * @return The number of bytes written
+         */
+        uint64_t run(int input_fd, int output_fd);
+    };
+
+    struct pipeline_params
+    {
+        std::optional<size_t> block_size;
+        std::optional<size_t> thread_count;
+        std::optional<size_t> queue_depth;
+    };
+
+    /**
+     * @brief Create a pipeline that compresses a stream into independent
+     * size-prefixed blocks
+     * @param factory Function used to create one backend compressor per worker
+     * @param params Block size, number of worker threads and number of blocks in
+     * flight
+     * @return A pipeline producing the maxzip stream format
+     */
+    pipeline *create_compression_pipeline(
+        const compressor_factory &factory,
+        const pipeline_params &params = {});
+
+    /**
+     * @brief Create a pipeline that decompresses the output of a compression
+     * pipeline
+     * @param factory Function used to create one backend decompressor per worker
+     * @param params Number of worker threads and number of blocks in flight. The
+     * block size is read from the stream.
+     * @return A pipeline for the maxzip stream format
+     */
+    pipeline *create_decompression_pipeline(
+        const decompressor_factory &factory,
+        const pipeline_params &params = {});
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MAXZIP_POOL_HPP
+#define MAXZIP_POOL_HPP
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+#include "encoder.hpp"
+#include "decoder.hpp"
+
+#include <atomic>
+
+namespace maxzip
+{
+    struct context_pool_params
+    {
+        std::optional<size_t> max_size;
+        std::optional<size_t> initial_size;
+    };
+
+    /**
+     * @class context_pool
+     * @brief Thread-safe pool of reusable codec objects created by a factory.
+     * Idle objects are kept in a fixed array of lock-free slots, and each thread
+     * starts its search at a slot picked from its thread ID, so threads mostly
+     * return to and take from their own slot without contending. The pool must
+     * outlive every lease taken from it.
+     */
+    template <typename T>
+    class context_pool
+    {
+    public:
+        using factory = std::function<T *()>;
+
+        /**
+         * @class lease
+         * @brief Exclusive use of one pooled object, which is returned to the
+         * pool when the lease is destroyed
+         */
+        class lease
+        {
+        public:
+            lease() = default;
+            lease(context_pool *pool, T *object);
+            lease(lease &&other) noexcept;
+            lease &operator=(lease &&other) noexcept;
+            lease(const lease &) = delete;
+            lease &operator=(const lease &) = delete;
+            ~lease();
+
+            T *get() const { return _object; }
+            T *operator->() const { return _object; }
+            T &operator*() const { return *_object; }
+            explicit operator bool() const { return _object != nullptr; }
+
+            /**
+             * @brief Return the object to the pool before the lease is destroyed
+             */
+            void reset();
+
+        private:
+            context_pool *_pool = nullptr;
+            T *_object = nullptr;
+        };
+
+        /**
+         * @brief Create a context pool
+         * @param factory Function used to create objects when the pool is empty
+         * @param params Maximum number of idle objects kept by the pool, and
+         * number of objects created up front
+         */
+        context_pool(factory factory, const context_pool_params &params = {});
+        context_pool(const context_pool &) = delete;
+        context_pool &operator=(const context_pool &) = delete;
+        ~context_pool();
+
+        /**
+         * @brief Take an idle object from the pool, or create one if none is idle
+         * @return A lease on the object
+         */
+        lease acquire();
+
+        /**
+         * @brief Get the number of idle objects in the pool
+         * @return The number of idle objects
+         */
+        size_t size() const;
+
+        /**
+         * @brief Get the maximum number of idle objects kept by the pool
+         * @return The maximum number of idle objects
+         */
+        size_t capacity() const;
+
+    private:
+        void release(T *object);
+
+        factory _factory;
+        size_t _capacity;
+        std::unique_ptr<std::atomic<T *>[]> _slots;
+    };
+
+    using compressor_pool = context_pool<compressor>;
+    using decompressor_pool = context_pool<decompressor>;
+    using encoder_pool = context_pool<encoder>;
+    using decoder_pool = context_pool<decoder>;
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MAXZIP_SEEKABLE_HPP
+#define MAXZIP_SEEKABLE_HPP
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+namespace maxzip
+{
+    /**
+     * @class seekable_decompressor
+     * @brief Decompressor for seekable inputs that can decode arbitrary ranges
+     * without inflating the whole input
+     */
+    class seekable_decompressor : public decompressor
+    {
+    public:
+        /**
+         * @brief Attach a seekable input and parse its seek table
+         * @param input Pointer to the compressed input data. It must remain valid
+         * until another input is loaded or the decompressor is destroyed.
+         * @param input_size Size of the compressed input data in bytes
+         */
+        virtual void load(const uint8_t *input, size_t input_size) = 0;
+
+        /**
+         * @brief Get the decompressed size of the loaded input
+         * @return The decompressed size in bytes
+         */
+        virtual size_t size() const = 0;
+
+        /**
+         * @brief Decompress a range of the loaded input. Only the frames that
+         * overlap the range are decoded.
+         * @param offset Offset of the range in the decompressed data
+         * @param length Length of the range in bytes
+         * @param output Pointer to an output buffer of at least length bytes
+         * @return The number of bytes written, which is less than length if the
+         * range extends past the end of the data.
+         */
+        virtual size_t read(size_t offset, size_t length, uint8_t *output) = 0;
+    };
+
+    struct seekable_compressor_params
+    {
+        std::optional<size_t> frame_size;
+    };
+
+    /**
+     * @brief Create a compressor that writes independent frames followed by a seek
+     * table in the zstd seekable format. With a zstd backend, the output remains a
+     * valid zstd stream.
+     * @param factory Function used to create the backend compressor
+     * @param params Decompressed size of each frame
+     * @return A compressor producing the seekable format
+     */
+    compressor *create_seekable_compressor(
+        const compressor_factory &factory,
+        const seekable_compressor_params &params = {});
+
+    /**
+     * @brief Create a decompressor for the output of a seekable compressor
+     * @param factory Function used to create the backend decompressor
+     * @return A seekable decompressor
+     */
+    seekable_decompressor *create_seekable_decompressor(
+        const decompressor_factory &factory);
+}
+
+#endif
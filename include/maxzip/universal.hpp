@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MAXZIP_UNIVERSAL_HPP
+#define MAXZIP_UNIVERSAL_HPP
+
+#include "common.hpp"
+#include "compressor.hpp"
+#include "decompressor.hpp"
+
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace maxzip
+{
+    /**
+     * @class codec_registry
+     * @brief Thread-safe map from each codec to the factories that create its
+     * contexts. Codec values without a named enumerator, up to 15, can be used
+     * to register custom formats.
+     */
+    class codec_registry
+    {
+    public:
+        /**
+         * @brief Register a codec, replacing any previous registration
+         * @param type The codec
+         * @param compressor_factory Function that creates a compressor for the codec
+         * @param decompressor_factory Function that creates a decompressor for the codec
+         */
+        void add(codec type, compressor_factory compressor_factory, decompressor_factory decompressor_factory);
+
+        /**
+         * @brief Remove a codec. Contexts that were created for it are not affected.
+         * @param type The codec
+         */
+        void erase(codec type);
+
+        /**
+         * @brief Check whether a codec is registered
+         * @param type The codec
+         * @return True if the codec is registered
+         */
+        bool contains(codec type) const;
+
+        /**
+         * @brief Create a compressor for a registered codec
+         * @param type The codec
+         * @return Pointer to the compressor
+         */
+        compressor *create_compressor(codec type) const;
+
+        /**
+         * @brief Create a decompressor for a registered codec
+         * @param type The codec
+         * @return Pointer to the decompressor
+         */
+        decompressor *create_decompressor(codec type) const;
+
+    private:
+        struct factories
+        {
+            compressor_factory compressor;
+            decompressor_factory decompressor;
+        };
+
+        factories find(codec type) const;
+
+        mutable std::shared_mutex _mutex;
+        std::unordered_map<codec, factories> _factories;
+    };
+
+    /**
+     * @brief Get the process-wide registry, which starts out with brotli, zlib,
+     * zstd and LZ4 at their default settings. Its zlib decompressor accepts both
+     * zlib and gzip streams.
+     * @return The registry
+     */
+    std::shared_ptr<codec_registry> default_codec_registry();
+
+    /**
+     * @brief Format of a block as recognized from its first bytes
+     */
+    struct format_detection
+    {
+        maxzip::codec codec;
+
+        /**
+         * @brief Number of bytes before the codec's own data, which is 1 for an
+         * envelope byte and 0 for a format with its own magic
+         */
+        size_t header_size;
+    };
+
+    /**
+     * @brief Recognize a block from the zstd frame magic, a zlib or gzip header,
+     * or a maxzip envelope byte. Formats without a magic number, such as brotli
+     * and LZ4 blocks, are only recognized inside an envelope.
+     * @param input Pointer to the block
+     * @param input_size Size of the block in bytes
+     * @return The format, or nothing if it is not recognized
+     */
+    std::optional<format_detection> detect_format(const uint8_t *input, size_t input_size) noexcept;
+
+    /**
+     * @brief Wrap a compressor so that each block starts with the envelope byte
+     * of the given codec, which lets a universal decompressor recognize formats
+     * that have no magic of their own
+     * @param type The codec written by the compressor, which must not be stored
+     * @param compressor The compressor to wrap, which the new object takes ownership of
+     * @return The enveloping compressor
+     */
+    compressor *create_enveloped_compressor(codec type, compressor *compressor);
+
+    struct universal_decompressor_params
+    {
+        std::shared_ptr<codec_registry> registry;
+    };
+
+    /**
+     * @brief Create a decompressor that recognizes the format of each block with
+     * detect_format and hands it to a context for that codec. Contexts are created
+     * from the registry on first use and then kept, so a block costs one branch
+     * on its first bytes rather than failed decode attempts.
+     * @param params Settings. The default registry is used if none is given.
+     * @return Pointer to the decompressor
+     */
+    decompressor *create_universal_decompressor(const universal_decompressor_params &params = {});
+}
+
+#endif
@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <internal.hpp>
+
+#include <chrono>
+
+namespace maxzip
+{
+    static constexpr double adaptive_default_throughput = 100.0;
+    static constexpr size_t adaptive_default_sample_size = 1 << 16;
+    static constexpr size_t adaptive_default_probe_interval = 64;
+    static constexpr double adaptive_smoothing = 0.25;
+    /*
+     * Without an explicit budget, probes spend time credited at a share of the
+     * compression time. Unused credit carries over, up to the longest a single
+     * probe may take, so expensive settings are measured once enough has built up.
+     */
+    static constexpr double adaptive_probe_share = 0.1;
+    static constexpr double adaptive_initial_probe_credit = 0.002;
+    static constexpr double adaptive_max_probe_budget = 0.1;
+    // assumed slowdown of a stronger setting that has not been measured yet
+    static constexpr double adaptive_step_slowdown = 4.0;
+    // probes for which a measurement is used without measuring the setting again
+    static constexpr size_t adaptive_refresh_probes = 8;
+
+    /*
+     * Settings ordered from fastest to strongest. A probe measures the setting in
+     * use and walks from it along this ladder, so adjacent entries should be
+     * close in cost.
+     */
+    static constexpr std::pair<codec, int> adaptive_settings[] = {
+        {codec::zstd, 1},
+        {codec::zstd, 3},
+        {codec::brotli, 1},
+        {codec::zstd, 6},
+        {codec::zlib, 1},
+        {codec::brotli, 5},
+        {codec::zstd, 9},
+        {codec::zlib, 6},
+        {codec::brotli, 9},
+        {codec::zlib, 9},
+        {codec::zstd, 15},
+        {codec::zstd, 19},
+        {codec::brotli, 11},
+    };
+
+    struct adaptive_candidate
+    {
+        codec type;
+        int level;
+        std::unique_ptr<compressor> backend;
+        double ratio = 0.0;
+        double throughput = 0.0;
+        bool measured = false;
+        // probe that last measured the setting
+        size_t probe = 0;
+    };
+
+    static std::unique_ptr<compressor> create_candidate(codec type, int level)
+    {
+        switch (type)
+        {
+        case codec::brotli:
+        {
+            brotli_compressor_params params;
+            params.quality = level;
+            return std::unique_ptr<compressor>(create_brotli_compressor(params));
+        }
+        case codec::zlib:
+        {
+            zlib_compressor_params params;
+            params.level = level;
+            return std::unique_ptr<compressor>(create_zlib_compressor(params));
+        }
+        default:
+        {
+            zstd_compressor_params params;
+            params.level = level;
+            return std::unique_ptr<compressor>(create_zstd_compressor(params));
+        }
+        }
+    }
+
+    class adaptive_compressor : public compressor
+    {
+    public:
+        adaptive_compressor(const adaptive_compressor_params &params) : _min_ratio(params.min_ratio), _probe_budget(params.probe_budget), _calls(0), _probes(0), _selected(0), _credit(adaptive_initial_probe_credit)
+        {
+            _min_throughput = params.min_throughput;
+            if (!_min_throughput && !_min_ratio)
+            {
+                _min_throughput = adaptive_default_throughput;
+            }
+            if (_min_throughput && _min_ratio)
+            {
+                throw std::invalid_argument("Adaptive policy takes a throughput or a ratio target, not both.");
+            }
+            if ((_min_throughput && !(*_min_throughput > 0.0)) || (_min_ratio && !(*_min_ratio > 0.0)))
+            {
+                throw std::invalid_argument("Adaptive policy target must be positive.");
+            }
+            _sample_size = params.sample_size.value_or(adaptive_default_sample_size);
+            _probe_interval = params.probe_interval.value_or(adaptive_default_probe_interval);
+            if (_sample_size == 0 || _probe_interval == 0 || (_probe_budget && !(*_probe_budget >= 0.0)))
+            {
+                throw std::invalid_argument("Invalid adaptive sample size, probe interval or probe budget.");
+            }
+
+            for (const std::pair<codec, int> &setting : adaptive_settings)
+            {
+                adaptive_candidate candidate;
+                candidate.type = setting.first;
+                candidate.level = setting.second;
+                _candidates.push_back(std::move(candidate));
+            }
+        }
+
+        size_t compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            size_t compressed_size(0);
+            if (output != nullptr)
+            {
+                if (output_size < 1)
+                {
+                    throw std::runtime_error("Insufficient output buffer size.");
+                }
+                if (_calls++ % _probe_interval == 0)
+                {
+                    probe(input, input_size);
+                }
+                adaptive_candidate &candidate = _candidates[_selected];
+                size_t available = output_size - 1;
+                double seconds(0.0);
+                compressed_size = run(candidate, input, input_size, output + 1, available, seconds);
+                update(candidate, input_size, compressed_size, seconds);
+                _credit = std::min(_credit + seconds * adaptive_probe_share, adaptive_max_probe_budget);
+                if (compressed_size < input_size)
+                {
+                    output[0] = envelope_byte(candidate.type);
+                }
+                else
+                {
+                    if (output_size - 1 < input_size)
+                    {
+                        throw std::runtime_error("Insufficient output buffer size.");
+                    }
+                    output[0] = envelope_byte(codec::stored);
+                    std::copy(input, input + input_size, output + 1);
+                    compressed_size = input_size;
+                }
+                compressed_size++;
+            }
+            else
+            {
+                // bounds depend only on the codec, so one backend per codec is asked
+                output_size = input_size;
+                for (codec type : {codec::zstd, codec::zlib, codec::brotli})
+                {
+                    size_t bound(0);
+                    codec_backend(type).compress(input, input_size, nullptr, bound);
+                    output_size = std::max(output_size, bound);
+                }
+                output_size++;
+            }
+            return compressed_size;
+        }
+
+    private:
+        static compressor &backend(adaptive_candidate &candidate)
+        {
+            if (!candidate.backend)
+            {
+                candidate.backend = create_candidate(candidate.type, candidate.level);
+            }
+            return *candidate.backend;
+        }
+
+        compressor &codec_backend(codec type)
+        {
+            adaptive_candidate *first(nullptr);
+            for (adaptive_candidate &candidate : _candidates)
+            {
+                if (candidate.type == type)
+                {
+                    if (candidate.backend)
+                    {
+                        return *candidate.backend;
+                    }
+                    first = (first != nullptr) ? first : &candidate;
+                }
+            }
+            return backend(*first);
+        }
+
+        static size_t run(adaptive_candidate &candidate, const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size, double &seconds)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            const size_t compressed_size = backend(candidate).compress(input, input_size, output, output_size);
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return compressed_size;
+        }
+
+        static void update(adaptive_candidate &candidate, size_t input_size, size_t compressed_size, double seconds)
+        {
+            const double ratio = static_cast<double>(input_size) / static_cast<double>(std::max<size_t>(compressed_size, 1));
+            const double throughput = static_cast<double>(input_size) / std::max(seconds, 1e-9) / 1e6;
+            if (candidate.measured)
+            {
+                candidate.ratio += adaptive_smoothing * (ratio - candidate.ratio);
+                candidate.throughput += adaptive_smoothing * (throughput - candidate.throughput);
+            }
+            else
+            {
+                candidate.ratio = ratio;
+                candidate.throughput = throughput;
+                candidate.measured = true;
+            }
+        }
+
+        bool fresh(const adaptive_candidate &candidate) const
+        {
+            return candidate.measured && candidate.probe + adaptive_refresh_probes > _probes;
+        }
+
+        bool meets_target(const adaptive_candidate &candidate) const
+        {
+            return _min_throughput ? candidate.throughput >= *_min_throughput : candidate.ratio >= *_min_ratio;
+        }
+
+        void measure(adaptive_candidate &candidate, const uint8_t *input, size_t sample_size)
+        {
+            const bool cold = !candidate.backend;
+            size_t bound(0);
+            backend(candidate).compress(input, sample_size, nullptr, bound);
+            if (_sample.size() < bound)
+            {
+                _sample.resize(bound);
+            }
+            double seconds(0.0);
+            if (cold)
+            {
+                // the first call on a new context allocates its tables, so it is not timed
+                size_t available(bound);
+                backend(candidate).compress(input, sample_size, _sample.data(), available);
+            }
+            const size_t compressed_size = run(candidate, input, sample_size, _sample.data(), bound, seconds);
+            update(candidate, sample_size, compressed_size, seconds);
+            candidate.probe = _probes;
+        }
+
+        /*
+         * Measure the setting in use, then walk along the ladder from it. When the
+         * setting meets the target the walk looks for a better one in the
+         * direction of the policy objective and stops at the first setting that
+         * misses the target. Otherwise it walks toward the target and stops at the
+         * first setting that meets it. Settings measured by a recent probe are
+         * passed using that measurement, so a walk cut short by the budget
+         * continues from where it stopped at the next probe.
+         */
+        void probe(const uint8_t *input, size_t input_size)
+        {
+            using clock = std::chrono::steady_clock;
+            const size_t sample_size = std::min(input_size, _sample_size);
+            const double budget = _probe_budget.value_or(_credit);
+            const clock::time_point start = clock::now();
+            _probes++;
+
+            measure(_candidates[_selected], input, sample_size);
+            const bool met = meets_target(_candidates[_selected]);
+            // stronger settings improve the ratio and weaker ones the throughput
+            const bool stronger = (met == _min_throughput.has_value());
+            double previous_throughput = _candidates[_selected].throughput;
+            for (size_t i = _selected; stronger ? i + 1 < _candidates.size() : i > 0;)
+            {
+                i = stronger ? i + 1 : i - 1;
+                adaptive_candidate &candidate = _candidates[i];
+                if (!fresh(candidate))
+                {
+                    const double throughput = candidate.measured ? candidate.throughput : previous_throughput / (stronger ? adaptive_step_slowdown : 1.0);
+                    const double runs = candidate.backend ? 1.0 : 2.0;
+                    const double remaining = budget - std::chrono::duration<double>(clock::now() - start).count();
+                    if (runs * static_cast<double>(sample_size) / (throughput * 1e6) > remaining)
+                    {
+                        break;
+                    }
+                    measure(candidate, input, sample_size);
+                }
+                previous_throughput = candidate.throughput;
+                if (meets_target(candidate) != met)
+                {
+                    break;
+                }
+            }
+            select();
+            _credit -= std::chrono::duration<double>(clock::now() - start).count();
+
+            // contexts are kept only for the setting in use and its neighbours
+            for (size_t i = 0; i < _candidates.size(); i++)
+            {
+                if (i + 1 < _selected || i > _selected + 1)
+                {
+                    _candidates[i].backend.reset();
+                }
+            }
+        }
+
+        void select()
+        {
+            // recently measured settings that meet the target, or the closest one
+            // if none does
+            std::optional<size_t> best;
+            size_t fallback(_selected);
+            for (size_t i = 0; i < _candidates.size(); i++)
+            {
+                const adaptive_candidate &candidate = _candidates[i];
+                if (!fresh(candidate))
+                {
+                    continue;
+                }
+                if (_min_throughput)
+                {
+                    if (candidate.throughput >= *_min_throughput && (!best || candidate.ratio > _candidates[*best].ratio))
+                    {
+                        best = i;
+                    }
+                    if (candidate.throughput > _candidates[fallback].throughput)
+                    {
+                        fallback = i;
+                    }
+                }
+                else
+                {
+                    if (candidate.ratio >= *_min_ratio && (!best || candidate.throughput > _candidates[*best].throughput))
+                    {
+                        best = i;
+                    }
+                    if (candidate.ratio > _candidates[fallback].ratio)
+                    {
+                        fallback = i;
+                    }
+                }
+            }
+            _selected = best.value_or(fallback);
+        }
+
+        std::optional<double> _min_throughput;
+        std::optional<double> _min_ratio;
+        std::optional<double> _probe_budget;
+        size_t _sample_size;
+        size_t _probe_interval;
+        size_t _calls;
+        size_t _probes;
+        size_t _selected;
+        double _credit;
+        std::vector<adaptive_candidate> _candidates;
+        std::vector<uint8_t> _sample;
+    };
+
+    compressor *create_adaptive_compressor(const adaptive_compressor_params &params)
+    {
+        return new adaptive_compressor(params);
+    }
+
+    decompressor *create_adaptive_decompressor()
+    {
+        return create_universal_decompressor();
+    }
+}
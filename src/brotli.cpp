@@ -24,33 +24,214 @@
 
 namespace maxzip
 {
-    class brotli_compressor : public compressor
+    static void validate_brotli_params(int quality, int window_size, int mode)
+    {
+        if (!maxzip::in_range(quality, BROTLI_MIN_QUALITY, BROTLI_MAX_QUALITY))
+        {
+            throw std::invalid_argument("Quality must be between " +
+                                        std::to_string(BROTLI_MIN_QUALITY) + " and " +
+                                        std::to_string(BROTLI_MAX_QUALITY));
+        }
+
+        if (!maxzip::in_range(window_size, BROTLI_MIN_WINDOW_BITS, BROTLI_MAX_WINDOW_BITS))
+        {
+            throw std::invalid_argument("Window size must be between " +
+                                        std::to_string(BROTLI_MIN_WINDOW_BITS) + " and " +
+                                        std::to_string(BROTLI_MAX_WINDOW_BITS));
+        }
+
+        if (!maxzip::in_range(mode, static_cast<int>(BROTLI_MODE_GENERIC), static_cast<int>(BROTLI_MODE_TEXT)))
+        {
+            throw std::invalid_argument("Mode must be between " +
+                                        std::to_string(BROTLI_MODE_GENERIC) + " and " +
+                                        std::to_string(BROTLI_MODE_TEXT));
+        }
+    }
+
+    /**
+     * @class brotli_memory_cache
+     * @brief Allocator for brotli instances that keeps released blocks for the next
+     * instance. Brotli cannot reset an encoder or decoder, so recycling the memory
+     * behind the hash tables and ring buffers is what keeps repeated calls from
+     * allocating and faulting in fresh pages.
+     */
+    class brotli_memory_cache
     {
     public:
-        brotli_compressor(int quality, int window_size, int mode) : _quality(quality), _window_size(window_size), _mode(static_cast<BrotliEncoderMode>(mode))
+        brotli_memory_cache(allocator *allocator) : _allocator(allocator), _generation(0)
+        {
+        }
+
+        brotli_memory_cache(const brotli_memory_cache &) = delete;
+        brotli_memory_cache &operator=(const brotli_memory_cache &) = delete;
+
+        ~brotli_memory_cache()
+        {
+            for (block_header *block : _free)
+            {
+                deallocate(block);
+            }
+        }
+
+        static void *allocate(void *opaque, size_t size)
+        {
+            return static_cast<brotli_memory_cache *>(opaque)->allocate(size);
+        }
+
+        static void release(void *opaque, void *address)
+        {
+            static_cast<brotli_memory_cache *>(opaque)->release(address);
+        }
+
+        /**
+         * @brief Free the cached blocks that were not reused since the last trim.
+         * Called between instances so the cache only holds the working set of the
+         * most recent one.
+         */
+        void trim()
+        {
+            auto unused = std::partition(_free.begin(), _free.end(), [this](const block_header *block) {
+                return block->generation == _generation;
+            });
+            for (auto it = unused; it != _free.end(); ++it)
+            {
+                deallocate(*it);
+            }
+            _free.erase(unused, _free.end());
+            _generation++;
+        }
+
+    private:
+        struct block_header
+        {
+            size_t capacity;
+            uint64_t generation;
+        };
+
+        static constexpr size_t header_size = (sizeof(block_header) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+        void *allocate(size_t size)
         {
-            if (!maxzip::in_range(_quality, BROTLI_MIN_QUALITY, BROTLI_MAX_QUALITY))
+            // best fit, accepting blocks up to twice the requested size
+            auto best = _free.end();
+            for (auto it = _free.begin(); it != _free.end(); ++it)
+            {
+                const size_t capacity = (*it)->capacity;
+                if (capacity >= size && capacity <= size * 2 && (best == _free.end() || capacity < (*best)->capacity))
+                {
+                    best = it;
+                }
+            }
+
+            block_header *block(nullptr);
+            if (best != _free.end())
+            {
+                block = *best;
+                *best = _free.back();
+                _free.pop_back();
+            }
+            else
             {
-                throw std::invalid_argument("Quality must be between " +
-                                            std::to_string(BROTLI_MIN_QUALITY) + " and " +
-                                            std::to_string(BROTLI_MAX_QUALITY));
+                const size_t block_size = header_size + size;
+                block = static_cast<block_header *>((_allocator != nullptr) ? _allocator->allocate(block_size) : std::malloc(block_size));
+                if (block == nullptr)
+                {
+                    return nullptr;
+                }
+                block->capacity = size;
             }
+            block->generation = _generation;
+            return reinterpret_cast<uint8_t *>(block) + header_size;
+        }
 
-            if (!maxzip::in_range(_window_size, BROTLI_MIN_WINDOW_BITS, BROTLI_MAX_WINDOW_BITS))
+        void release(void *address)
+        {
+            if (address != nullptr)
             {
-                throw std::invalid_argument("Window size must be between " +
-                                            std::to_string(BROTLI_MIN_WINDOW_BITS) + " and " +
-                                            std::to_string(BROTLI_MAX_WINDOW_BITS));
+                _free.push_back(reinterpret_cast<block_header *>(static_cast<uint8_t *>(address) - header_size));
             }
+        }
 
-            if (!maxzip::in_range(_mode, BROTLI_MODE_GENERIC, BROTLI_MODE_TEXT))
+        void deallocate(block_header *block)
+        {
+            if (_allocator != nullptr)
             {
-                throw std::invalid_argument("Mode must be between " +
-                                            std::to_string(BROTLI_MODE_GENERIC) + " and " +
-                                            std::to_string(BROTLI_MODE_TEXT));
+                _allocator->deallocate(block);
+            }
+            else
+            {
+                std::free(block);
             }
         }
 
+        allocator *_allocator;
+        std::vector<block_header *> _free;
+        uint64_t _generation;
+    };
+
+    using brotli_encoder_state = std::unique_ptr<BrotliEncoderState, decltype(&BrotliEncoderDestroyInstance)>;
+    using brotli_decoder_state = std::unique_ptr<BrotliDecoderState, decltype(&BrotliDecoderDestroyInstance)>;
+
+    static dictionary_impl *brotli_dictionary(const std::shared_ptr<dictionary> &dictionary)
+    {
+        dictionary_impl *impl = dictionary_impl::from(dictionary);
+#if !MAXZIP_BROTLI_DICTIONARY
+        if (impl != nullptr)
+        {
+            throw std::invalid_argument("Brotli dictionaries require brotli 1.1.0 or newer");
+        }
+#endif
+        return impl;
+    }
+
+    static brotli_encoder_state create_encoder_state(brotli_memory_cache &cache, int quality, int window_size, int mode, [[maybe_unused]] dictionary_impl *dictionary)
+    {
+        brotli_encoder_state state(
+            BrotliEncoderCreateInstance(brotli_memory_cache::allocate, brotli_memory_cache::release, &cache),
+            BrotliEncoderDestroyInstance);
+        if (!state)
+        {
+            throw std::runtime_error("Failed to initialize brotli encoder");
+        }
+        BrotliEncoderSetParameter(state.get(), BROTLI_PARAM_QUALITY, static_cast<uint32_t>(quality));
+        BrotliEncoderSetParameter(state.get(), BROTLI_PARAM_LGWIN, static_cast<uint32_t>(window_size));
+        BrotliEncoderSetParameter(state.get(), BROTLI_PARAM_MODE, static_cast<uint32_t>(mode));
+#if MAXZIP_BROTLI_DICTIONARY
+        if (dictionary != nullptr && BrotliEncoderAttachPreparedDictionary(state.get(), dictionary->brotli_prepared()) != BROTLI_TRUE)
+        {
+            throw std::runtime_error("Failed to attach brotli dictionary");
+        }
+#endif
+        return state;
+    }
+
+    static brotli_decoder_state create_decoder_state(brotli_memory_cache &cache, [[maybe_unused]] dictionary_impl *dictionary)
+    {
+        brotli_decoder_state state(
+            BrotliDecoderCreateInstance(brotli_memory_cache::allocate, brotli_memory_cache::release, &cache),
+            BrotliDecoderDestroyInstance);
+        if (!state)
+        {
+            throw std::runtime_error("Failed to initialize brotli decoder");
+        }
+#if MAXZIP_BROTLI_DICTIONARY
+        if (dictionary != nullptr &&
+            BrotliDecoderAttachDictionary(state.get(), BROTLI_SHARED_DICTIONARY_RAW, dictionary->size(), dictionary->data()) != BROTLI_TRUE)
+        {
+            throw std::runtime_error("Failed to attach brotli dictionary");
+        }
+#endif
+        return state;
+    }
+
+    class brotli_compressor final : public compressor
+    {
+    public:
+        brotli_compressor(int quality, int window_size, int mode, std::shared_ptr<allocator> allocator, const std::shared_ptr<maxzip::dictionary> &dictionary) : _quality(quality), _window_size(window_size), _mode(mode), _allocator(std::move(allocator)), _cache(_allocator.get()), _owner(dictionary), _dictionary(brotli_dictionary(dictionary))
+        {
+            validate_brotli_params(_quality, _window_size, _mode);
+        }
+
         size_t compress(
             const uint8_t *input,
             size_t input_size,
@@ -60,18 +241,12 @@ namespace maxzip
             size_t compressed_size(0);
             if (output != nullptr)
             {
-                compressed_size = output_size;
-                if (BrotliEncoderCompress(
-                        _quality,
-                        _window_size,
-                        _mode,
-                        input_size,
-                        input,
-                        &compressed_size,
-                        output) != BROTLI_TRUE)
+                const codec_result result = try_compress(input, input_size, output, output_size);
+                if (!result)
                 {
-                    throw std::runtime_error("Insufficient output buffer size.");
+                    throw_result(result, "Brotli compression");
                 }
+                compressed_size = result.size;
             }
             else
             {
@@ -80,33 +255,448 @@ namespace maxzip
             return compressed_size;
         }
 
+        codec_result try_compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            codec_result result = {status::failed, 0};
+            try
+            {
+                brotli_encoder_state state = create_encoder_state(_cache, _quality, _window_size, _mode, _dictionary);
+                BrotliEncoderSetParameter(state.get(), BROTLI_PARAM_SIZE_HINT, static_cast<uint32_t>(std::min<size_t>(input_size, 1 << 30)));
+                size_t available_in(input_size);
+                const uint8_t *next_in(input);
+                size_t available_out(output_size);
+                uint8_t *next_out(output);
+                bool ok(true);
+                bool finished(false);
+                while (ok && !finished && available_out > 0)
+                {
+                    ok = (BrotliEncoderCompressStream(
+                              state.get(),
+                              BROTLI_OPERATION_FINISH,
+                              &available_in,
+                              &next_in,
+                              &available_out,
+                              &next_out,
+                              nullptr) == BROTLI_TRUE);
+                    finished = (BrotliEncoderIsFinished(state.get()) == BROTLI_TRUE);
+                }
+                if (finished)
+                {
+                    result = {status::ok, output_size - available_out};
+                }
+                else if (ok)
+                {
+                    result = {status::insufficient_output, BrotliEncoderMaxCompressedSize(input_size)};
+                }
+            }
+            catch (...)
+            {
+            }
+            _cache.trim();
+            return result;
+        }
+
+        size_t compress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            return maxzip::compress_batch(
+                inputs,
+                input_count,
+                output,
+                entries,
+                [](const input_buffer &input) { return BrotliEncoderMaxCompressedSize(input.size); },
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                    return compress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t compress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            return maxzip::compress_to(
+                input,
+                input_size,
+                output,
+                [](const input_buffer &input) { return BrotliEncoderMaxCompressedSize(input.size); },
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                    return compress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t compressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count) override
+        {
+            buffer_cursor<input_buffer> input(inputs, input_count);
+            buffer_cursor<output_buffer> output(outputs, output_count);
+            {
+                brotli_encoder_state state = create_encoder_state(_cache, _quality, _window_size, _mode, _dictionary);
+                BrotliEncoderSetParameter(state.get(), BROTLI_PARAM_SIZE_HINT, static_cast<uint32_t>(std::min<size_t>(input.remaining(), 1 << 30)));
+                bool finished(false);
+                while (!finished)
+                {
+                    const size_t input_size = input.available();
+                    const size_t output_size = output.available();
+                    size_t available_in(input_size);
+                    const uint8_t *next_in(input.data());
+                    size_t available_out(output_size);
+                    uint8_t *next_out(output.data());
+                    // once started, finishing continues until the encoder is done
+                    const BrotliEncoderOperation operation = (input_size == input.remaining()) ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+                    if (BrotliEncoderCompressStream(state.get(), operation, &available_in, &next_in, &available_out, &next_out, nullptr) != BROTLI_TRUE)
+                    {
+                        throw std::runtime_error("Brotli compression failed");
+                    }
+                    input.advance(input_size - available_in);
+                    output.advance(output_size - available_out);
+                    finished = (BrotliEncoderIsFinished(state.get()) == BROTLI_TRUE);
+                    if (!finished && output.remaining() == 0)
+                    {
+                        throw std::runtime_error("Insufficient output buffer size.");
+                    }
+                }
+            }
+            _cache.trim();
+            return output.position();
+        }
+
     private:
         int _quality;
         int _window_size;
-        BrotliEncoderMode _mode;
+        int _mode;
+        std::shared_ptr<allocator> _allocator;
+        brotli_memory_cache _cache;
+        std::shared_ptr<dictionary> _owner;
+        dictionary_impl *_dictionary;
     };
 
-    class brotli_decompressor : public decompressor
+    class brotli_decompressor final : public decompressor
     {
     public:
-        brotli_decompressor() {}
+        brotli_decompressor(std::shared_ptr<allocator> allocator, const std::shared_ptr<maxzip::dictionary> &dictionary) : _allocator(std::move(allocator)), _cache(_allocator.get()), _owner(dictionary), _dictionary(brotli_dictionary(dictionary))
+        {
+        }
+
         size_t decompress(
             const uint8_t *input,
             size_t input_size,
             uint8_t *output,
             size_t output_size) override
         {
+            const codec_result result = try_decompress(input, input_size, output, output_size);
+            if (!result)
+            {
+                throw_result(result, "Brotli decompression");
+            }
+            return result.size;
+        }
 
-            size_t decompressed_size = output_size;
-            const BrotliDecoderResult result = BrotliDecoderDecompress(
-                input_size, input, &decompressed_size, output);
-            if (result != BROTLI_DECODER_RESULT_SUCCESS)
+        codec_result try_decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            codec_result result = {status::failed, 0};
+            try
             {
-                throw std::runtime_error("Decompression failed.");
+                brotli_decoder_state state = create_decoder_state(_cache, _dictionary);
+                size_t available_in(input_size);
+                const uint8_t *next_in(input);
+                size_t available_out(output_size);
+                uint8_t *next_out(output);
+                switch (BrotliDecoderDecompressStream(
+                    state.get(),
+                    &available_in,
+                    &next_in,
+                    &available_out,
+                    &next_out,
+                    nullptr))
+                {
+                case BROTLI_DECODER_RESULT_SUCCESS:
+                    result = {status::ok, output_size - available_out};
+                    break;
+                case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+                    // brotli does not record the decompressed size
+                    result = {status::insufficient_output, 0};
+                    break;
+                case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+                    result = {status::corrupt_input, 0};
+                    break;
+                default:
+                    // format errors come first, then argument and allocation errors
+                    result = {(BrotliDecoderGetErrorCode(state.get()) >= BROTLI_DECODER_ERROR_DICTIONARY_NOT_SET) ? status::corrupt_input : status::failed, 0};
+                    break;
+                }
             }
+            catch (...)
+            {
+            }
+            _cache.trim();
+            return result;
+        }
 
+        size_t decompress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            const size_t *output_sizes,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            return maxzip::decompress_batch(
+                inputs,
+                input_count,
+                output_sizes,
+                output,
+                entries,
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size) {
+                    return decompress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            size_t decompressed_size(0);
+            {
+                brotli_decoder_state state = create_decoder_state(_cache, _dictionary);
+                size_t available_in(input_size);
+                const uint8_t *next_in(input);
+                decompressed_size = decompress_growing(input_size, output, [&](uint8_t *next_out, size_t available_out, bool &finished) {
+                    const size_t output_size(available_out);
+                    const BrotliDecoderResult result = BrotliDecoderDecompressStream(
+                        state.get(),
+                        &available_in,
+                        &next_in,
+                        &available_out,
+                        &next_out,
+                        nullptr);
+                    if (result != BROTLI_DECODER_RESULT_SUCCESS && result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT)
+                    {
+                        throw std::runtime_error("Decompression failed.");
+                    }
+                    finished = (result == BROTLI_DECODER_RESULT_SUCCESS);
+                    return output_size - available_out;
+                });
+            }
+            _cache.trim();
             return decompressed_size;
         }
+
+        size_t decompressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count) override
+        {
+            buffer_cursor<input_buffer> input(inputs, input_count);
+            buffer_cursor<output_buffer> output(outputs, output_count);
+            {
+                brotli_decoder_state state = create_decoder_state(_cache, _dictionary);
+                BrotliDecoderResult result(BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT);
+                while (result != BROTLI_DECODER_RESULT_SUCCESS)
+                {
+                    const size_t input_size = input.available();
+                    const size_t output_size = output.available();
+                    size_t available_in(input_size);
+                    const uint8_t *next_in(input.data());
+                    size_t available_out(output_size);
+                    uint8_t *next_out(output.data());
+                    result = BrotliDecoderDecompressStream(state.get(), &available_in, &next_in, &available_out, &next_out, nullptr);
+                    input.advance(input_size - available_in);
+                    output.advance(output_size - available_out);
+                    if (result == BROTLI_DECODER_RESULT_ERROR ||
+                        (result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT && input.remaining() == 0))
+                    {
+                        throw_result({status::corrupt_input, 0}, "Brotli decompression");
+                    }
+                    if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT && output.remaining() == 0)
+                    {
+                        throw_result({status::insufficient_output, 0}, "Brotli decompression");
+                    }
+                }
+            }
+            _cache.trim();
+            return output.position();
+        }
+
+    private:
+        std::shared_ptr<allocator> _allocator;
+        brotli_memory_cache _cache;
+        std::shared_ptr<dictionary> _owner;
+        dictionary_impl *_dictionary;
+    };
+
+    class brotli_encoder : public encoder
+    {
+    public:
+        brotli_encoder(int quality, int window_size, int mode, std::shared_ptr<allocator> allocator, const std::shared_ptr<maxzip::dictionary> &dictionary) : _quality(quality), _window_size(window_size), _mode(mode), _allocator(std::move(allocator)), _cache(_allocator.get()), _owner(dictionary), _dictionary(brotli_dictionary(dictionary)), _state(nullptr, BrotliEncoderDestroyInstance)
+        {
+            validate_brotli_params(_quality, _window_size, _mode);
+            init();
+        }
+
+        void init() override
+        {
+            _state.reset();
+            _cache.trim();
+            _state = create_encoder_state(_cache, _quality, _window_size, _mode, _dictionary);
+        }
+
+        size_t update(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            return process(BROTLI_OPERATION_PROCESS, input, input_size, output, output_size);
+        }
+
+        bool finish(
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            process(BROTLI_OPERATION_FINISH, nullptr, 0, output, output_size);
+            return BrotliEncoderIsFinished(_state.get()) == BROTLI_TRUE;
+        }
+
+    private:
+        size_t process(
+            BrotliEncoderOperation operation,
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size)
+        {
+            size_t available_in(input_size);
+            const uint8_t *next_in(input);
+            size_t available_out(output_size);
+            uint8_t *next_out(output);
+            bool pending(true);
+            while (pending)
+            {
+                if (BrotliEncoderCompressStream(
+                        _state.get(),
+                        operation,
+                        &available_in,
+                        &next_in,
+                        &available_out,
+                        &next_out,
+                        nullptr) != BROTLI_TRUE)
+                {
+                    throw std::runtime_error("Brotli compression failed");
+                }
+                pending = (available_out > 0) &&
+                          ((available_in > 0) ||
+                           (BrotliEncoderHasMoreOutput(_state.get()) == BROTLI_TRUE) ||
+                           (operation == BROTLI_OPERATION_FINISH && BrotliEncoderIsFinished(_state.get()) != BROTLI_TRUE));
+            }
+            output_size -= available_out;
+            return input_size - available_in;
+        }
+
+        int _quality;
+        int _window_size;
+        int _mode;
+        std::shared_ptr<allocator> _allocator;
+        brotli_memory_cache _cache;
+        std::shared_ptr<dictionary> _owner;
+        dictionary_impl *_dictionary;
+        brotli_encoder_state _state;
+    };
+
+    class brotli_decoder : public decoder
+    {
+    public:
+        brotli_decoder(std::shared_ptr<allocator> allocator, const std::shared_ptr<maxzip::dictionary> &dictionary) : _allocator(std::move(allocator)), _cache(_allocator.get()), _owner(dictionary), _dictionary(brotli_dictionary(dictionary)), _state(nullptr, BrotliDecoderDestroyInstance), _finished(false)
+        {
+            init();
+        }
+
+        void init() override
+        {
+            _state.reset();
+            _cache.trim();
+            _state = create_decoder_state(_cache, _dictionary);
+            _finished = false;
+        }
+
+        size_t update(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            if (_finished && input_size > 0)
+            {
+                throw std::runtime_error("Unexpected data after end of brotli stream");
+            }
+            size_t available_in(input_size);
+            size_t available_out(output_size);
+            process(input, available_in, output, available_out);
+            output_size -= available_out;
+            return input_size - available_in;
+        }
+
+        bool finish(
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            size_t available_in(0);
+            size_t available_out(output_size);
+            const BrotliDecoderResult result = process(nullptr, available_in, output, available_out);
+            output_size -= available_out;
+            if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT)
+            {
+                throw std::runtime_error("Brotli stream is truncated");
+            }
+            return result == BROTLI_DECODER_RESULT_SUCCESS;
+        }
+
+    private:
+        BrotliDecoderResult process(
+            const uint8_t *input,
+            size_t &available_in,
+            uint8_t *output,
+            size_t &available_out)
+        {
+            const uint8_t *next_in(input);
+            uint8_t *next_out(output);
+            const BrotliDecoderResult result = BrotliDecoderDecompressStream(
+                _state.get(),
+                &available_in,
+                &next_in,
+                &available_out,
+                &next_out,
+                nullptr);
+            if (result == BROTLI_DECODER_RESULT_ERROR)
+            {
+                throw std::runtime_error("Brotli decompression failed: " +
+                                         std::string(BrotliDecoderErrorString(BrotliDecoderGetErrorCode(_state.get()))));
+            }
+            _finished = (result == BROTLI_DECODER_RESULT_SUCCESS);
+            return result;
+        }
+
+        std::shared_ptr<allocator> _allocator;
+        brotli_memory_cache _cache;
+        std::shared_ptr<dictionary> _owner;
+        dictionary_impl *_dictionary;
+        brotli_decoder_state _state;
+        bool _finished;
     };
 
     compressor *create_brotli_compressor(
@@ -115,13 +705,33 @@ namespace maxzip
         std::unique_ptr<compressor> compressor = std::make_unique<brotli_compressor>(
             params.quality.value_or(BROTLI_DEFAULT_QUALITY),
             params.window_size.value_or(BROTLI_DEFAULT_WINDOW),
-            params.mode.value_or(BROTLI_DEFAULT_MODE));
+            params.mode.value_or(BROTLI_DEFAULT_MODE),
+            params.allocator,
+            params.dictionary);
         return compressor.release();
     }
 
     decompressor *create_brotli_decompressor(
         const brotli_decompressor_params &params)
     {
-        return new brotli_decompressor();
+        return new brotli_decompressor(params.allocator, params.dictionary);
+    }
+
+    encoder *create_brotli_encoder(
+        const brotli_compressor_params &params)
+    {
+        std::unique_ptr<encoder> encoder = std::make_unique<brotli_encoder>(
+            params.quality.value_or(BROTLI_DEFAULT_QUALITY),
+            params.window_size.value_or(BROTLI_DEFAULT_WINDOW),
+            params.mode.value_or(BROTLI_DEFAULT_MODE),
+            params.allocator,
+            params.dictionary);
+        return encoder.release();
+    }
+
+    decoder *create_brotli_decoder(
+        const brotli_decompressor_params &params)
+    {
+        return new brotli_decoder(params.allocator, params.dictionary);
     }
 }
\ No newline at end of file
@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <internal.hpp>
+
+#include <array>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define MAXZIP_CRC32C_SSE42 1
+#define MAXZIP_SHA256_SHANI 1
+#else
+#define MAXZIP_CRC32C_SSE42 0
+#define MAXZIP_SHA256_SHANI 0
+#endif
+
+namespace maxzip
+{
+    // reflected Castagnoli polynomial
+    static constexpr uint32_t crc32c_polynomial = 0x82F63B78;
+
+    /*
+     * The kernels work on the raw CRC state, before the final inversion, so
+     * that they can be chained and merged.
+     */
+    using crc32c_function = uint32_t (*)(uint32_t, const uint8_t *, size_t) noexcept;
+
+    using crc32c_tables = std::array<std::array<uint32_t, 256>, 8>;
+
+    static const crc32c_tables &crc32c_software_tables()
+    {
+        static const crc32c_tables tables = []() {
+            crc32c_tables tables{};
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc >> 1) ^ ((crc & 1) ? crc32c_polynomial : 0);
+                }
+                tables[0][i] = crc;
+            }
+            for (size_t k = 1; k < tables.size(); k++)
+            {
+                for (size_t i = 0; i < 256; i++)
+                {
+                    tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+                }
+            }
+            return tables;
+        }();
+        return tables;
+    }
+
+    // slicing-by-8
+    uint32_t crc32c_software(uint32_t state, const uint8_t *data, size_t size) noexcept
+    {
+        const crc32c_tables &tables = crc32c_software_tables();
+        for (; size >= 8; data += 8, size -= 8)
+        {
+            const uint64_t word = load_le<uint64_t>(data) ^ state;
+            state = tables[7][word & 0xFF] ^
+                    tables[6][(word >> 8) & 0xFF] ^
+                    tables[5][(word >> 16) & 0xFF] ^
+                    tables[4][(word >> 24) & 0xFF] ^
+                    tables[3][(word >> 32) & 0xFF] ^
+                    tables[2][(word >> 40) & 0xFF] ^
+                    tables[1][(word >> 48) & 0xFF] ^
+                    tables[0][word >> 56];
+        }
+        for (; size > 0; data++, size--)
+        {
+            state = (state >> 8) ^ tables[0][(state ^ *data) & 0xFF];
+        }
+        return state;
+    }
+
+#if MAXZIP_CRC32C_SSE42
+    /*
+     * The crc32 instruction has a latency of three cycles and a throughput of
+     * one, so long inputs are cut into three interleaved streams of this many
+     * bytes whose states are merged afterwards.
+     */
+    static constexpr size_t crc32c_stride = 4096;
+
+    using crc32c_shift_tables = std::array<std::array<uint32_t, 256>, 4>;
+
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32c_sse42_serial(uint32_t state, const uint8_t *data, size_t size) noexcept
+    {
+        uint64_t crc(state);
+        for (; size >= 8; data += 8, size -= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            crc = _mm_crc32_u64(crc, word);
+        }
+        state = static_cast<uint32_t>(crc);
+        for (; size > 0; data++, size--)
+        {
+            state = _mm_crc32_u8(state, *data);
+        }
+        return state;
+    }
+
+    // Running a state over a stride of zero bytes is linear in the state, so it
+    // is tabulated per byte from the images of the 32 single-bit states.
+    static const crc32c_shift_tables &crc32c_sse42_shift_tables()
+    {
+        static const crc32c_shift_tables tables = []() {
+            static const std::array<uint8_t, crc32c_stride> zeros{};
+            std::array<uint32_t, 32> basis;
+            for (size_t bit = 0; bit < basis.size(); bit++)
+            {
+                basis[bit] = crc32c_sse42_serial(uint32_t(1) << bit, zeros.data(), zeros.size());
+            }
+            crc32c_shift_tables tables{};
+            for (size_t k = 0; k < tables.size(); k++)
+            {
+                for (size_t value = 0; value < 256; value++)
+                {
+                    uint32_t shifted(0);
+                    for (size_t bit = 0; bit < 8; bit++)
+                    {
+                        if ((value >> bit) & 1)
+                        {
+                            shifted ^= basis[8 * k + bit];
+                        }
+                    }
+                    tables[k][value] = shifted;
+                }
+            }
+            return tables;
+        }();
+        return tables;
+    }
+
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32c_sse42(uint32_t state, const uint8_t *data, size_t size) noexcept
+    {
+        if (size >= 3 * crc32c_stride)
+        {
+            const crc32c_shift_tables &tables = crc32c_sse42_shift_tables();
+            const auto shift = [&tables](uint32_t crc) {
+                return tables[0][crc & 0xFF] ^ tables[1][(crc >> 8) & 0xFF] ^ tables[2][(crc >> 16) & 0xFF] ^ tables[3][crc >> 24];
+            };
+            for (; size >= 3 * crc32c_stride; data += 3 * crc32c_stride, size -= 3 * crc32c_stride)
+            {
+                uint64_t crc0(state);
+                uint64_t crc1(0);
+                uint64_t crc2(0);
+                for (size_t i = 0; i < crc32c_stride; i += 8)
+                {
+                    uint64_t word0;
+                    uint64_t word1;
+                    uint64_t word2;
+                    std::memcpy(&word0, data + i, sizeof(word0));
+                    std::memcpy(&word1, data + crc32c_stride + i, sizeof(word1));
+                    std::memcpy(&word2, data + 2 * crc32c_stride + i, sizeof(word2));
+                    crc0 = _mm_crc32_u64(crc0, word0);
+                    crc1 = _mm_crc32_u64(crc1, word1);
+                    crc2 = _mm_crc32_u64(crc2, word2);
+                }
+                state = shift(shift(static_cast<uint32_t>(crc0)) ^ static_cast<uint32_t>(crc1)) ^ static_cast<uint32_t>(crc2);
+            }
+        }
+        return crc32c_sse42_serial(state, data, size);
+    }
+#endif
+
+    static crc32c_function select_crc32c() noexcept
+    {
+#if MAXZIP_CRC32C_SSE42
+        if (__builtin_cpu_supports("sse4.2"))
+        {
+            return crc32c_sse42;
+        }
+#endif
+        return crc32c_software;
+    }
+
+    uint32_t crc32c(const uint8_t *data, size_t size, uint32_t crc) noexcept
+    {
+        static const crc32c_function function = select_crc32c();
+        return ~function(~crc, data, size);
+    }
+
+    static constexpr size_t sha256_block_size = 64;
+
+    alignas(16) static constexpr uint32_t sha256_round_constants[64] = {
+        0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+        0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+        0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+        0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+        0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+        0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+        0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+        0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+    };
+
+    using sha256_function = void (*)(uint32_t *, const uint8_t *, size_t) noexcept;
+
+    static uint32_t rotate_right(uint32_t value, unsigned bits)
+    {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    static uint32_t load_be32(const uint8_t *data)
+    {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+               (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+    }
+
+    void sha256_software(uint32_t *state, const uint8_t *blocks, size_t count) noexcept
+    {
+        for (; count > 0; blocks += sha256_block_size, count--)
+        {
+            uint32_t w[64];
+            for (size_t i = 0; i < 16; i++)
+            {
+                w[i] = load_be32(blocks + 4 * i);
+            }
+            for (size_t i = 16; i < 64; i++)
+            {
+                const uint32_t s0 = rotate_right(w[i - 15], 7) ^ rotate_right(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                const uint32_t s1 = rotate_right(w[i - 2], 17) ^ rotate_right(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for (size_t i = 0; i < 64; i++)
+            {
+                const uint32_t t1 = h + (rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25)) +
+                                    ((e & f) ^ (~e & g)) + sha256_round_constants[i] + w[i];
+                const uint32_t t2 = (rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22)) +
+                                    ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+        }
+    }
+
+#if MAXZIP_SHA256_SHANI
+    /*
+     * SHA extensions kernel. The state is kept as ABEF and CDGH halves, each
+     * sha256rnds2 runs two rounds, and sha256msg1/sha256msg2 extend the message
+     * schedule four words at a time.
+     */
+    __attribute__((target("sha,sse4.1,ssse3")))
+    static void sha256_shani(uint32_t *state, const uint8_t *blocks, size_t count) noexcept
+    {
+        const __m128i byte_swap = _mm_set_epi64x(0x0C0D0E0F08090A0B, 0x0405060700010203);
+        __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xB1);
+        __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1B);
+        __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+        __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+        for (; count > 0; blocks += sha256_block_size, count--)
+        {
+            const __m128i abef_saved = abef;
+            const __m128i cdgh_saved = cdgh;
+            __m128i message[4];
+            for (size_t j = 0; j < 16; j++)
+            {
+                if (j < 4)
+                {
+                    message[j] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + 16 * j)), byte_swap);
+                }
+                const __m128i words = _mm_add_epi32(message[j % 4], _mm_load_si128(reinterpret_cast<const __m128i *>(sha256_round_constants + 4 * j)));
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+                if (j >= 3 && j < 15)
+                {
+                    // words 4j + 4 to 4j + 7 from the two groups before
+                    __m128i &next = message[(j + 1) % 4];
+                    next = _mm_add_epi32(next, _mm_alignr_epi8(message[j % 4], message[(j + 3) % 4], 4));
+                    next = _mm_sha256msg2_epu32(next, message[j % 4]);
+                }
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0E));
+                if (j >= 1 && j <= 12)
+                {
+                    message[(j + 3) % 4] = _mm_sha256msg1_epu32(message[(j + 3) % 4], message[j % 4]);
+                }
+            }
+            abef = _mm_add_epi32(abef, abef_saved);
+            cdgh = _mm_add_epi32(cdgh, cdgh_saved);
+        }
+
+        const __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+        const __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+#endif
+
+    static sha256_function select_sha256() noexcept
+    {
+#if MAXZIP_SHA256_SHANI
+        unsigned int eax(0), ebx(0), ecx(0), edx(0);
+        if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA) != 0 &&
+            __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3"))
+        {
+            return sha256_shani;
+        }
+#endif
+        return sha256_software;
+    }
+
+    void sha256_blocks(uint32_t *state, const uint8_t *blocks, size_t count) noexcept
+    {
+        static const sha256_function function = select_sha256();
+        function(state, blocks, count);
+    }
+
+    sha256_digest sha256(const uint8_t *data, size_t size) noexcept
+    {
+        uint32_t state[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+        const size_t blocks = size / sha256_block_size;
+        sha256_blocks(state, data, blocks);
+
+        // the tail, a 0x80 byte, zero padding and the bit length fill one or two blocks
+        uint8_t tail[2 * sha256_block_size] = {};
+        const size_t remaining = size - blocks * sha256_block_size;
+        if (remaining > 0)
+        {
+            std::memcpy(tail, data + blocks * sha256_block_size, remaining);
+        }
+        tail[remaining] = 0x80;
+        const size_t tail_blocks = (remaining + 9 > sha256_block_size) ? 2 : 1;
+        const uint64_t bits = static_cast<uint64_t>(size) * 8;
+        for (size_t i = 0; i < 8; i++)
+        {
+            tail[tail_blocks * sha256_block_size - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+        }
+        sha256_blocks(state, tail, tail_blocks);
+
+        sha256_digest digest;
+        for (size_t i = 0; i < 8; i++)
+        {
+            for (size_t j = 0; j < 4; j++)
+            {
+                digest[4 * i + j] = static_cast<uint8_t>(state[i] >> (24 - 8 * j));
+            }
+        }
+        return digest;
+    }
+
+    class checksummed_compressor final : public compressor
+    {
+    public:
+        checksummed_compressor(std::unique_ptr<compressor> backend) : _backend(std::move(backend))
+        {
+            if (!_backend)
+            {
+                throw std::invalid_argument("Compressor must not be null");
+            }
+        }
+
+        size_t compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            if (output == nullptr)
+            {
+                _backend->compress(input, input_size, nullptr, output_size);
+                output_size += checksum_size;
+                return 0;
+            }
+            if (output_size < checksum_size)
+            {
+                throw std::runtime_error("Insufficient output buffer size.");
+            }
+            // hashing first leaves the input in cache for the codec
+            const uint32_t checksum = crc32c(input, input_size);
+            size_t backend_size(output_size - checksum_size);
+            const size_t compressed_size = _backend->compress(input, input_size, output, backend_size);
+            store_le(output + compressed_size, checksum);
+            return compressed_size + checksum_size;
+        }
+
+        codec_result try_compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            const uint32_t checksum = crc32c(input, input_size);
+            codec_result result = _backend->try_compress(input, input_size, output, (output_size > checksum_size) ? output_size - checksum_size : 0);
+            if (result.status == status::ok || result.status == status::insufficient_output)
+            {
+                result.size += checksum_size;
+            }
+            if (result && result.size > output_size)
+            {
+                result.status = status::insufficient_output;
+            }
+            if (result)
+            {
+                store_le(output + result.size - checksum_size, checksum);
+            }
+            return result;
+        }
+
+    private:
+        std::unique_ptr<compressor> _backend;
+    };
+
+    class checksummed_decompressor final : public decompressor
+    {
+    public:
+        checksummed_decompressor(std::unique_ptr<decompressor> backend) : _backend(std::move(backend))
+        {
+            if (!_backend)
+            {
+                throw std::invalid_argument("Decompressor must not be null");
+            }
+        }
+
+        size_t decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) override
+        {
+            const size_t size = payload_size(input_size);
+            const size_t decompressed_size = _backend->decompress(input, size, output, output_size);
+            verify(input + size, output, decompressed_size);
+            return decompressed_size;
+        }
+
+        codec_result try_decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            if (input_size < checksum_size)
+            {
+                return {status::corrupt_input, 0};
+            }
+            const size_t size = input_size - checksum_size;
+            const codec_result result = _backend->try_decompress(input, size, output, output_size);
+            if (result && crc32c(output, result.size) != load_le<uint32_t>(input + size))
+            {
+                return {status::corrupt_input, 0};
+            }
+            return result;
+        }
+
+        std::optional<size_t> decompressed_size(
+            const uint8_t *input,
+            size_t input_size) override
+        {
+            if (input_size < checksum_size)
+            {
+                return std::nullopt;
+            }
+            return _backend->decompressed_size(input, input_size - checksum_size);
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            const size_t size = payload_size(input_size);
+            const size_t decompressed_size = _backend->decompress_to(input, size, output);
+            verify(input + size, output.data(), decompressed_size);
+            return decompressed_size;
+        }
+
+    private:
+        static size_t payload_size(size_t input_size)
+        {
+            if (input_size < checksum_size)
+            {
+                throw std::runtime_error("Input is too short to hold a checksum.");
+            }
+            return input_size - checksum_size;
+        }
+
+        static void verify(const uint8_t *checksum, const uint8_t *output, size_t output_size)
+        {
+            if (crc32c(output, output_size) != load_le<uint32_t>(checksum))
+            {
+                throw std::runtime_error("Checksum mismatch.");
+            }
+        }
+
+        std::unique_ptr<decompressor> _backend;
+    };
+
+    compressor *create_checksummed_compressor(compressor *compressor)
+    {
+        std::unique_ptr<maxzip::compressor> backend(compressor);
+        return new checksummed_compressor(std::move(backend));
+    }
+
+    decompressor *create_checksummed_decompressor(decompressor *decompressor)
+    {
+        std::unique_ptr<maxzip::decompressor> backend(decompressor);
+        return new checksummed_decompressor(std::move(backend));
+    }
+}
@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <internal.hpp>
+
+#include <array>
+
+namespace maxzip
+{
+    /*
+     * Dedup manifest layout (all integers little-endian):
+     *   magic        4 bytes  "MXZD"
+     *   version      1 byte
+     *   reserved     3 bytes
+     *   content_size 8 bytes
+     *   chunks       8-byte chunk ID and 4-byte size of each chunk, in order
+     */
+    static constexpr uint8_t dedup_magic[4] = {'M', 'X', 'Z', 'D'};
+    static constexpr uint8_t dedup_version = 1;
+    static constexpr size_t dedup_header_size = 16;
+    static constexpr size_t dedup_entry_size = 12;
+    static constexpr size_t dedup_default_min_size = 16 << 10;
+    static constexpr size_t dedup_default_average_size = 64 << 10;
+    static constexpr size_t dedup_default_max_size = 256 << 10;
+    static constexpr size_t dedup_min_chunk_size = 64;
+    static constexpr size_t dedup_max_chunk_size = 1 << 30;
+
+    /*
+     * Dedup store image layout (all integers little-endian):
+     *   magic        4 bytes  "MXZT"
+     *   version      1 byte
+     *   reserved     3 bytes
+     *   chunk_count  8 bytes
+     *   chunks       32-byte key, 4-byte size, 8-byte compressed size and the
+     *                compressed data of each chunk, in ID order
+     */
+    static constexpr uint8_t dedup_store_magic[4] = {'M', 'X', 'Z', 'T'};
+    static constexpr uint8_t dedup_store_version = 1;
+    static constexpr size_t dedup_store_header_size = 16;
+    static constexpr size_t dedup_store_entry_size = sha256_digest().size() + 12;
+
+    static constexpr uint64_t splitmix64(uint64_t &state)
+    {
+        uint64_t value = (state += 0x9E3779B97F4A7C15);
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+        return value ^ (value >> 31);
+    }
+
+    // fixed so that the same content is cut the same way by every build
+    static constexpr std::array<uint64_t, 256> make_gear_table(unsigned shift)
+    {
+        std::array<uint64_t, 256> table{};
+        uint64_t state(0x4D585A4443444321);
+        for (size_t i = 0; i < table.size(); i++)
+        {
+            table[i] = splitmix64(state) << shift;
+        }
+        return table;
+    }
+
+    static constexpr std::array<uint64_t, 256> gear_table = make_gear_table(0);
+    static constexpr std::array<uint64_t, 256> gear_table_shifted = make_gear_table(1);
+
+    // mask of the given number of bits just below the top bit, which depend on
+    // the last 64 bytes and survive one extra shift
+    static uint64_t gear_mask(unsigned bits)
+    {
+        return ((uint64_t(1) << bits) - 1) << (63 - bits);
+    }
+
+    chunker::chunker(const chunker_params &params) : _min_size(params.min_size.value_or(dedup_default_min_size)),
+                                                     _average_size(params.average_size.value_or(dedup_default_average_size)),
+                                                     _max_size(params.max_size.value_or(dedup_default_max_size))
+    {
+        if (!in_range(_min_size, dedup_min_chunk_size, _average_size) ||
+            !in_range(_max_size, _average_size, dedup_max_chunk_size))
+        {
+            throw std::invalid_argument("Chunk sizes must satisfy " + std::to_string(dedup_min_chunk_size) +
+                                        " <= min_size <= average_size <= max_size <= " + std::to_string(dedup_max_chunk_size));
+        }
+        unsigned bits(0);
+        while ((size_t(2) << bits) <= _average_size)
+        {
+            bits++;
+        }
+        // normalized chunking: two bits stricter before the average, two looser after
+        _small_mask = gear_mask(bits + 2);
+        _large_mask = gear_mask(bits - 2);
+    }
+
+    size_t chunker::next(const uint8_t *data, size_t size) const
+    {
+        if (size <= _min_size)
+        {
+            return size;
+        }
+        const size_t end = std::min(size, _max_size);
+        const size_t normal = std::min(_average_size, end);
+        // the hash takes two bytes per step, testing the first against the
+        // shifted mask
+        uint64_t hash(0);
+        size_t i(_min_size);
+        for (; i + 2 <= normal; i += 2)
+        {
+            hash = (hash << 2) + gear_table_shifted[data[i]];
+            if ((hash & (_small_mask << 1)) == 0)
+            {
+                return i + 1;
+            }
+            hash += gear_table[data[i + 1]];
+            if ((hash & _small_mask) == 0)
+            {
+                return i + 2;
+            }
+        }
+        for (; i + 2 <= end; i += 2)
+        {
+            hash = (hash << 2) + gear_table_shifted[data[i]];
+            if ((hash & (_large_mask << 1)) == 0)
+            {
+                return i + 1;
+            }
+            hash += gear_table[data[i + 1]];
+            if ((hash & _large_mask) == 0)
+            {
+                return i + 2;
+            }
+        }
+        return end;
+    }
+
+    size_t chunker::min_size() const
+    {
+        return _min_size;
+    }
+
+    size_t chunker::max_size() const
+    {
+        return _max_size;
+    }
+
+    size_t dedup_store::key_hash::operator()(const sha256_digest &key) const noexcept
+    {
+        // the digest is already uniform, so any 8 bytes of it make a good hash
+        return static_cast<size_t>(load_le<uint64_t>(key.data()));
+    }
+
+    dedup_store::dedup_store() : _stored_size(0)
+    {
+    }
+
+    std::optional<uint64_t> dedup_store::find(const uint8_t *data, size_t size) const
+    {
+        return find(sha256(data, size));
+    }
+
+    std::optional<uint64_t> dedup_store::find(const sha256_digest &key) const
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        const auto it = _index.find(key);
+        if (it == _index.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    uint64_t dedup_store::insert(const uint8_t *data, size_t size, std::vector<uint8_t> compressed)
+    {
+        return insert(sha256(data, size), size, std::move(compressed));
+    }
+
+    uint64_t dedup_store::insert(const sha256_digest &key, size_t size, std::vector<uint8_t> compressed)
+    {
+        if (size > std::numeric_limits<uint32_t>::max() || !trusted_size(size, compressed.size()))
+        {
+            throw std::invalid_argument("Chunk size " + std::to_string(size) + " is out of range for " +
+                                        std::to_string(compressed.size()) + " compressed bytes");
+        }
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        return append(key, size, std::move(compressed));
+    }
+
+    stored_chunk dedup_store::get(uint64_t id) const
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        if (id >= _chunks.size())
+        {
+            throw std::invalid_argument("Unknown chunk ID " + std::to_string(id));
+        }
+        const entry &chunk = _chunks[static_cast<size_t>(id)];
+        return {chunk.key, {chunk.compressed.data(), chunk.compressed.size()}, chunk.size};
+    }
+
+    size_t dedup_store::chunk_count() const
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _chunks.size();
+    }
+
+    size_t dedup_store::stored_size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _stored_size;
+    }
+
+    void dedup_store::save(std::vector<uint8_t> &output) const
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        output.resize(dedup_store_header_size + _chunks.size() * dedup_store_entry_size + _stored_size);
+        uint8_t *position = output.data();
+        std::memcpy(position, dedup_store_magic, sizeof(dedup_store_magic));
+        position[4] = dedup_store_version;
+        std::memset(position + 5, 0, 3);
+        store_le<uint64_t>(position + 8, _chunks.size());
+        position += dedup_store_header_size;
+        for (const entry &chunk : _chunks)
+        {
+            std::memcpy(position, chunk.key.data(), chunk.key.size());
+            store_le<uint32_t>(position + chunk.key.size(), static_cast<uint32_t>(chunk.size));
+            store_le<uint64_t>(position + chunk.key.size() + 4, chunk.compressed.size());
+            position += dedup_store_entry_size;
+            std::memcpy(position, chunk.compressed.data(), chunk.compressed.size());
+            position += chunk.compressed.size();
+        }
+    }
+
+    void dedup_store::load(const uint8_t *input, size_t input_size)
+    {
+        if (input_size < dedup_store_header_size ||
+            std::memcmp(input, dedup_store_magic, sizeof(dedup_store_magic)) != 0 ||
+            input[4] != dedup_store_version)
+        {
+            throw std::runtime_error("Invalid dedup store image");
+        }
+        const uint64_t count = load_le<uint64_t>(input + 8);
+        if (count > (input_size - dedup_store_header_size) / dedup_store_entry_size)
+        {
+            throw std::runtime_error("Invalid dedup store image");
+        }
+
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        if (!_chunks.empty())
+        {
+            throw std::runtime_error("Dedup store must be empty to load an image");
+        }
+        try
+        {
+            size_t offset = dedup_store_header_size;
+            for (uint64_t i = 0; i < count; i++)
+            {
+                if (input_size - offset < dedup_store_entry_size)
+                {
+                    throw std::runtime_error("Invalid dedup store image");
+                }
+                sha256_digest key;
+                std::memcpy(key.data(), input + offset, key.size());
+                const size_t size = load_le<uint32_t>(input + offset + key.size());
+                const uint64_t compressed_size = load_le<uint64_t>(input + offset + key.size() + 4);
+                offset += dedup_store_entry_size;
+                if (compressed_size > input_size - offset || !trusted_size(size, static_cast<size_t>(compressed_size)))
+                {
+                    throw std::runtime_error("Invalid dedup store image");
+                }
+                const uint8_t *compressed = input + offset;
+                offset += static_cast<size_t>(compressed_size);
+                if (append(key, size, std::vector<uint8_t>(compressed, compressed + compressed_size)) != i)
+                {
+                    throw std::runtime_error("Duplicate chunk in dedup store image");
+                }
+            }
+            if (offset != input_size)
+            {
+                throw std::runtime_error("Invalid dedup store image");
+            }
+        }
+        catch (...)
+        {
+            _chunks.clear();
+            _index.clear();
+            _stored_size = 0;
+            throw;
+        }
+    }
+
+    uint64_t dedup_store::append(const sha256_digest &key, size_t size, std::vector<uint8_t> compressed)
+    {
+        const auto it = _index.find(key);
+        if (it != _index.end())
+        {
+            if (_chunks[static_cast<size_t>(it->second)].size != size)
+            {
+                throw std::invalid_argument("Chunk size does not match the stored chunk with the same key");
+            }
+            return it->second;
+        }
+        const uint64_t id = _chunks.size();
+        _stored_size += compressed.size();
+        _chunks.push_back({key, size, std::move(compressed)});
+        _index.emplace(key, id);
+        return id;
+    }
+
+    class dedup_compressor final : public compressor
+    {
+    public:
+        dedup_compressor(std::shared_ptr<dedup_store> store, std::unique_ptr<compressor> backend, const chunker_params &params) : _store(std::move(store)), _backend(std::move(backend)), _chunker(params)
+        {
+            if (!_store || !_backend)
+            {
+                throw std::invalid_argument("Store and compressor must not be null");
+            }
+        }
+
+        size_t compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            if (output == nullptr)
+            {
+                // every chunk but the last is at least the minimum size
+                output_size = dedup_header_size + (input_size / _chunker.min_size() + 1) * dedup_entry_size;
+                return 0;
+            }
+
+            _sizes.clear();
+            for (size_t offset = 0; offset < input_size; offset += _sizes.back())
+            {
+                _sizes.push_back(_chunker.next(input + offset, input_size - offset));
+            }
+            const size_t manifest_size = dedup_header_size + _sizes.size() * dedup_entry_size;
+            if (manifest_size > output_size)
+            {
+                throw std::runtime_error("Insufficient output buffer size.");
+            }
+
+            std::memcpy(output, dedup_magic, sizeof(dedup_magic));
+            output[4] = dedup_version;
+            std::memset(output + 5, 0, 3);
+            store_le<uint64_t>(output + 8, input_size);
+            uint8_t *entry = output + dedup_header_size;
+            const uint8_t *chunk = input;
+            for (const size_t size : _sizes)
+            {
+                const sha256_digest key = sha256(chunk, size);
+                std::optional<uint64_t> id = _store->find(key);
+                if (!id)
+                {
+                    std::vector<uint8_t> compressed;
+                    _backend->compress_to(chunk, size, compressed);
+                    id = _store->insert(key, size, std::move(compressed));
+                }
+                store_le<uint64_t>(entry, *id);
+                store_le<uint32_t>(entry + 8, static_cast<uint32_t>(size));
+                entry += dedup_entry_size;
+                chunk += size;
+            }
+            return manifest_size;
+        }
+
+    private:
+        std::shared_ptr<dedup_store> _store;
+        std::unique_ptr<compressor> _backend;
+        chunker _chunker;
+        std::vector<size_t> _sizes;
+    };
+
+    class dedup_decompressor final : public decompressor
+    {
+    public:
+        dedup_decompressor(std::shared_ptr<dedup_store> store, std::unique_ptr<decompressor> backend) : _store(std::move(store)), _backend(std::move(backend))
+        {
+            if (!_store || !_backend)
+            {
+                throw std::invalid_argument("Store and decompressor must not be null");
+            }
+        }
+
+        std::optional<size_t> decompressed_size(
+            const uint8_t *input,
+            size_t input_size) override
+        {
+            if (!valid_manifest(input, input_size))
+            {
+                return std::nullopt;
+            }
+            // the recorded size is only reported if the stored chunks add up to
+            // it, so callers never allocate for chunks that do not exist
+            const uint64_t content_size = load_le<uint64_t>(input + 8);
+            uint64_t total(0);
+            for (const uint8_t *entry = input + dedup_header_size; entry < input + input_size; entry += dedup_entry_size)
+            {
+                const uint64_t id = load_le<uint64_t>(entry);
+                const size_t size = load_le<uint32_t>(entry + 8);
+                if (id >= _store->chunk_count() || _store->get(id).size != size || size > content_size - total)
+                {
+                    return std::nullopt;
+                }
+                total += size;
+            }
+            if (total != content_size || content_size > std::numeric_limits<size_t>::max())
+            {
+                return std::nullopt;
+            }
+            return static_cast<size_t>(content_size);
+        }
+
+        size_t decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) override
+        {
+            if (!valid_manifest(input, input_size))
+            {
+                throw std::runtime_error("Invalid dedup manifest");
+            }
+            const uint64_t content_size = load_le<uint64_t>(input + 8);
+            if (output_size < content_size)
+            {
+                throw std::runtime_error("Insufficient output buffer size.");
+            }
+
+            // repeats within the block are copied from their first occurrence
+            _first.clear();
+            size_t offset(0);
+            for (const uint8_t *entry = input + dedup_header_size; entry < input + input_size; entry += dedup_entry_size)
+            {
+                const uint64_t id = load_le<uint64_t>(entry);
+                const size_t size = load_le<uint32_t>(entry + 8);
+                if (size > content_size - offset)
+                {
+                    throw std::runtime_error("Invalid dedup manifest");
+                }
+                const auto [first, inserted] = _first.emplace(id, batch_entry{offset, size});
+                if (inserted)
+                {
+                    const stored_chunk chunk = _store->get(id);
+                    if (chunk.size != size ||
+                        _backend->decompress(chunk.compressed.data, chunk.compressed.size, output + offset, size) != size)
+                    {
+                        throw std::runtime_error("Dedup chunk size mismatch");
+                    }
+                }
+                else
+                {
+                    if (first->second.size != size)
+                    {
+                        throw std::runtime_error("Dedup chunk size mismatch");
+                    }
+                    std::memcpy(output + offset, output + first->second.offset, size);
+                }
+                offset += size;
+            }
+            if (offset != content_size)
+            {
+                throw std::runtime_error("Invalid dedup manifest");
+            }
+            return offset;
+        }
+
+    private:
+        static bool valid_manifest(const uint8_t *input, size_t input_size)
+        {
+            return input_size >= dedup_header_size &&
+                   std::memcmp(input, dedup_magic, sizeof(dedup_magic)) == 0 &&
+                   input[4] == dedup_version &&
+                   (input_size - dedup_header_size) % dedup_entry_size == 0;
+        }
+
+        std::shared_ptr<dedup_store> _store;
+        std::unique_ptr<decompressor> _backend;
+        std::unordered_map<uint64_t, batch_entry> _first;
+    };
+
+    compressor *create_dedup_compressor(
+        std::shared_ptr<dedup_store> store,
+        compressor *compressor,
+        const chunker_params &params)
+    {
+        std::unique_ptr<maxzip::compressor> backend(compressor);
+        return new dedup_compressor(std::move(store), std::move(backend), params);
+    }
+
+    decompressor *create_dedup_decompressor(
+        std::shared_ptr<dedup_store> store,
+        decompressor *decompressor)
+    {
+        std::unique_ptr<maxzip::decompressor> backend(decompressor);
+        return new dedup_decompressor(std::move(store), std::move(backend));
+    }
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <internal.hpp>
+
+namespace maxzip
+{
+    static uint32_t content_id(const uint8_t *data, size_t size)
+    {
+        // FNV-1a, used to key raw content dictionaries that carry no ID
+        uint32_t hash(2166136261u);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    static uint32_t dictionary_id(const uint8_t *data, size_t size)
+    {
+        uint32_t id = ZDICT_getDictID(data, size);
+        if (id == 0)
+        {
+            id = content_id(data, size);
+        }
+        return id;
+    }
+
+    static const std::shared_ptr<dictionary> &check_content(const std::shared_ptr<dictionary> &cached, const uint8_t *data, size_t size)
+    {
+        if (cached->size() != size || std::memcmp(cached->data(), data, size) != 0)
+        {
+            throw std::runtime_error("Dictionary ID " + std::to_string(cached->id()) + " is already cached with different content");
+        }
+        return cached;
+    }
+
+    dictionary_impl::dictionary_impl(const uint8_t *data, size_t size) : _data(data, data + size), _ddict(nullptr)
+#if MAXZIP_BROTLI_DICTIONARY
+        , _brotli_prepared(nullptr)
+#endif
+    {
+        if (size == 0)
+        {
+            throw std::invalid_argument("Dictionary must not be empty");
+        }
+        _id = dictionary_id(data, size);
+    }
+
+    dictionary_impl::~dictionary_impl()
+    {
+        for (const auto &[level, cdict] : _cdicts)
+        {
+            ZSTD_freeCDict(cdict);
+        }
+        ZSTD_freeDDict(_ddict);
+#if MAXZIP_BROTLI_DICTIONARY
+        if (_brotli_prepared != nullptr)
+        {
+            BrotliEncoderDestroyPreparedDictionary(_brotli_prepared);
+        }
+#endif
+    }
+
+    uint32_t dictionary_impl::id() const
+    {
+        return _id;
+    }
+
+    const uint8_t *dictionary_impl::data() const
+    {
+        return _data.data();
+    }
+
+    size_t dictionary_impl::size() const
+    {
+        return _data.size();
+    }
+
+    const ZSTD_CDict *dictionary_impl::zstd_cdict(int level)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ZSTD_CDict *&cdict = _cdicts[level];
+        if (cdict == nullptr)
+        {
+            cdict = ZSTD_createCDict(_data.data(), _data.size(), level);
+            if (cdict == nullptr)
+            {
+                _cdicts.erase(level);
+                throw std::runtime_error("Failed to digest Zstandard dictionary");
+            }
+        }
+        return cdict;
+    }
+
+    const ZSTD_DDict *dictionary_impl::zstd_ddict()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_ddict == nullptr)
+        {
+            _ddict = ZSTD_createDDict(_data.data(), _data.size());
+            if (_ddict == nullptr)
+            {
+                throw std::runtime_error("Failed to digest Zstandard dictionary");
+            }
+        }
+        return _ddict;
+    }
+
+#if MAXZIP_BROTLI_DICTIONARY
+    const BrotliEncoderPreparedDictionary *dictionary_impl::brotli_prepared()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_brotli_prepared == nullptr)
+        {
+            _brotli_prepared = BrotliEncoderPrepareDictionary(
+                BROTLI_SHARED_DICTIONARY_RAW,
+                _data.size(),
+                _data.data(),
+                BROTLI_MAX_QUALITY,
+                nullptr,
+                nullptr,
+                nullptr);
+            if (_brotli_prepared == nullptr)
+            {
+                throw std::runtime_error("Failed to prepare brotli dictionary");
+            }
+        }
+        return _brotli_prepared;
+    }
+#endif
+
+    dictionary_impl *dictionary_impl::from(const std::shared_ptr<dictionary> &dictionary)
+    {
+        dictionary_impl *impl(nullptr);
+        if (dictionary)
+        {
+            impl = dynamic_cast<dictionary_impl *>(dictionary.get());
+            if (impl == nullptr)
+            {
+                throw std::invalid_argument("Dictionary must be created by create_dictionary");
+            }
+        }
+        return impl;
+    }
+
+    dictionary *create_dictionary(const uint8_t *data, size_t size)
+    {
+        return new dictionary_impl(data, size);
+    }
+
+    size_t train_dictionary(
+        const uint8_t *samples,
+        const size_t *sample_sizes,
+        size_t sample_count,
+        uint8_t *output,
+        size_t output_size)
+    {
+        if (sample_count > std::numeric_limits<unsigned>::max())
+        {
+            throw std::invalid_argument("Too many dictionary samples");
+        }
+        const size_t dictionary_size = ZDICT_trainFromBuffer(
+            output,
+            output_size,
+            samples,
+            sample_sizes,
+            static_cast<unsigned>(sample_count));
+        if (ZDICT_isError(dictionary_size))
+        {
+            throw std::runtime_error("Dictionary training failed: " + std::string(ZDICT_getErrorName(dictionary_size)));
+        }
+        return dictionary_size;
+    }
+
+    std::shared_ptr<dictionary> dictionary_cache::find(uint32_t id) const
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto it = _dictionaries.find(id);
+        return (it != _dictionaries.end()) ? it->second : nullptr;
+    }
+
+    std::shared_ptr<dictionary> dictionary_cache::load(const uint8_t *data, size_t size)
+    {
+        const uint32_t id = dictionary_id(data, size);
+        {
+            std::shared_lock<std::shared_mutex> lock(_mutex);
+            auto it = _dictionaries.find(id);
+            if (it != _dictionaries.end())
+            {
+                return check_content(it->second, data, size);
+            }
+        }
+
+        std::shared_ptr<dictionary> created = std::make_shared<dictionary_impl>(data, size);
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        auto [it, inserted] = _dictionaries.emplace(id, created);
+        return inserted ? created : check_content(it->second, data, size);
+    }
+
+    void dictionary_cache::erase(uint32_t id)
+    {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _dictionaries.erase(id);
+    }
+
+    size_t dictionary_cache::size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _dictionaries.size();
+    }
+}
@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <internal.hpp>
+
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAXZIP_FILE_MAPPING 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#include <fstream>
+#endif
+
+namespace maxzip
+{
+    static constexpr size_t file_decode_buffer_size = 256 << 10;
+    static constexpr size_t file_min_capacity = 64 << 10;
+
+    // replacing the input while it is read would corrupt or crash the call
+    static void check_distinct(const std::string &input_path, const std::string &output_path)
+    {
+        std::error_code error;
+        if (input_path == output_path || std::filesystem::equivalent(input_path, output_path, error))
+        {
+            throw std::invalid_argument("Input and output must be different files: " + output_path);
+        }
+    }
+
+    /**
+     * Run all of the input through a decoder, passing each filled part of a
+     * fixed buffer to the write function.
+     */
+    template <typename WriteFunction>
+    static size_t decode_all(decoder &decoder, const uint8_t *input, size_t input_size, WriteFunction write)
+    {
+        std::vector<uint8_t> buffer(file_decode_buffer_size);
+        size_t total(0);
+        size_t offset(0);
+        decoder.init();
+        do
+        {
+            size_t output_size = buffer.size();
+            const size_t consumed = decoder.update(input + offset, input_size - offset, buffer.data(), output_size);
+            if (consumed == 0 && output_size == 0)
+            {
+                throw std::runtime_error("Decompression made no progress.");
+            }
+            write(buffer.data(), output_size);
+            offset += consumed;
+            total += output_size;
+        } while (offset < input_size);
+        bool finished(false);
+        while (!finished)
+        {
+            size_t output_size = buffer.size();
+            finished = decoder.finish(buffer.data(), output_size);
+            write(buffer.data(), output_size);
+            total += output_size;
+        }
+        return total;
+    }
+
+#ifdef MAXZIP_FILE_MAPPING
+    static std::runtime_error file_error(const std::string &message, const std::string &path)
+    {
+        return std::runtime_error(message + " " + path + ": " + std::strerror(errno));
+    }
+
+    class file_handle
+    {
+    public:
+        file_handle(const std::string &path, int flags) : _path(path), _fd(::open(path.c_str(), flags | O_CLOEXEC, 0666))
+        {
+            if (_fd < 0)
+            {
+                throw file_error("Failed to open", _path);
+            }
+        }
+
+        file_handle(const file_handle &) = delete;
+        file_handle &operator=(const file_handle &) = delete;
+
+        ~file_handle()
+        {
+            ::close(_fd);
+        }
+
+        int get() const
+        {
+            return _fd;
+        }
+
+        size_t size() const
+        {
+            struct stat status;
+            if (::fstat(_fd, &status) != 0)
+            {
+                throw file_error("Failed to stat", _path);
+            }
+            return static_cast<size_t>(status.st_size);
+        }
+
+        void reserve(size_t size)
+        {
+#ifdef __linux__
+            // allocate the blocks up front, so running out of space fails here
+            // instead of raising SIGBUS while the mapping is written
+            if (size > 0)
+            {
+                // posix_fallocate returns the error instead of setting errno
+                const int error = ::posix_fallocate(_fd, 0, static_cast<off_t>(size));
+                if (error == 0)
+                {
+                    return;
+                }
+                // only a file system without support falls back to a sparse file
+                if (error != EOPNOTSUPP && error != EINVAL)
+                {
+                    errno = error;
+                    throw file_error((error == ENOSPC) ? "Not enough space to write" : "Failed to allocate", _path);
+                }
+            }
+#endif
+            resize(size);
+        }
+
+        // fail up front if the file system could not hold size bytes, without
+        // allocating blocks that the output may never use
+        void check_space(size_t size) const
+        {
+            struct statvfs status;
+            if (::fstatvfs(_fd, &status) == 0 && static_cast<uint64_t>(status.f_bavail) * status.f_frsize < size)
+            {
+                errno = ENOSPC;
+                throw file_error("Not enough space to write", _path);
+            }
+        }
+
+        void resize(size_t size)
+        {
+            if (::ftruncate(_fd, static_cast<off_t>(size)) != 0)
+            {
+                throw file_error("Failed to resize", _path);
+            }
+        }
+
+        void write(const uint8_t *data, size_t size)
+        {
+            while (size > 0)
+            {
+                const ssize_t written = ::write(_fd, data, size);
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    throw file_error("Failed to write", _path);
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+        }
+
+    private:
+        std::string _path;
+        int _fd;
+    };
+
+    class file_mapping
+    {
+    public:
+        file_mapping(const file_handle &file, const std::string &path, size_t size, bool writable) : _data(nullptr), _size(size)
+        {
+            if (_size > 0)
+            {
+                void *data = ::mmap(nullptr, _size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, file.get(), 0);
+                if (data == MAP_FAILED)
+                {
+                    throw file_error("Failed to map", path);
+                }
+                _data = static_cast<uint8_t *>(data);
+                if (!writable)
+                {
+                    static_cast<void>(::madvise(data, _size, MADV_SEQUENTIAL));
+                }
+            }
+        }
+
+        file_mapping(const file_mapping &) = delete;
+        file_mapping &operator=(const file_mapping &) = delete;
+
+        ~file_mapping()
+        {
+            if (_data != nullptr)
+            {
+                ::munmap(_data, _size);
+            }
+        }
+
+        uint8_t *data() const
+        {
+            return _data;
+        }
+
+    private:
+        uint8_t *_data;
+        size_t _size;
+    };
+
+    /**
+     * Create the output file, let the write function fill a mapping of
+     * capacity bytes, then trim the file to the size it reports. The blocks are
+     * allocated up front when the capacity is the expected size, and otherwise
+     * only checked for. The output file is removed if anything fails.
+     */
+    template <typename WriteFunction>
+    static size_t write_mapped(const std::string &path, size_t capacity, bool exact, WriteFunction write)
+    {
+        try
+        {
+            file_handle output(path, O_RDWR | O_CREAT | O_TRUNC);
+            // a mapping is never empty, so write always receives a buffer
+            const size_t mapped_size = std::max<size_t>(capacity, 1);
+            if (exact)
+            {
+                output.reserve(mapped_size);
+            }
+            else
+            {
+                output.check_space(mapped_size);
+                output.resize(mapped_size);
+            }
+            size_t size(0);
+            {
+                file_mapping mapping(output, path, mapped_size, true);
+                size = write(mapping.data(), capacity);
+            }
+            output.resize(size);
+            return size;
+        }
+        catch (...)
+        {
+            ::unlink(path.c_str());
+            throw;
+        }
+    }
+
+    /**
+     * Create the output file and let the attempt function fill a mapping that
+     * starts at 64 KiB and doubles until the output fits, then trim the file to
+     * the size it reports. A size the attempt reports is used directly when the
+     * input could expand to it. Apart from the starting capacity, no more than
+     * twice the space the output turned out to need is reserved.
+     * The output file is removed unless the result is ok.
+     */
+    template <typename AttemptFunction>
+    static codec_result write_growing(const std::string &path, size_t input_size, AttemptFunction attempt)
+    {
+        try
+        {
+            file_handle output(path, O_RDWR | O_CREAT | O_TRUNC);
+            size_t capacity(file_min_capacity);
+            while (true)
+            {
+                output.reserve(capacity);
+                codec_result result{status::failed, 0};
+                {
+                    file_mapping mapping(output, path, capacity, true);
+                    result = attempt(mapping.data(), capacity);
+                }
+                if (result)
+                {
+                    output.resize(result.size);
+                    return result;
+                }
+                if (result.status != status::insufficient_output)
+                {
+                    ::unlink(path.c_str());
+                    return result;
+                }
+                if (capacity > std::numeric_limits<size_t>::max() / 2)
+                {
+                    throw std::runtime_error("Decompressed file is too large.");
+                }
+                // a reported size is used when the input could expand to it
+                capacity = (result.size > capacity && trusted_size(result.size, input_size)) ? result.size : capacity * 2;
+            }
+        }
+        catch (...)
+        {
+            ::unlink(path.c_str());
+            throw;
+        }
+    }
+
+    /**
+     * Create the output file and let the write function write to it. The
+     * output file is removed if anything fails.
+     */
+    template <typename WriteFunction>
+    static size_t write_stream(const std::string &path, WriteFunction write)
+    {
+        try
+        {
+            file_handle output(path, O_WRONLY | O_CREAT | O_TRUNC);
+            return write(output);
+        }
+        catch (...)
+        {
+            ::unlink(path.c_str());
+            throw;
+        }
+    }
+
+    size_t compress_file(
+        const std::string &input_path,
+        const std::string &output_path,
+        compressor &compressor)
+    {
+        check_distinct(input_path, output_path);
+        file_handle input(input_path, O_RDONLY);
+        const size_t input_size = input.size();
+        file_mapping source(input, input_path, input_size, false);
+        size_t bound(0);
+        compressor.compress(source.data(), input_size, nullptr, bound);
+        return write_mapped(output_path, bound, false, [&](uint8_t *output, size_t output_size) {
+            return compressor.compress(source.data(), input_size, output, output_size);
+        });
+    }
+
+    size_t decompress_file(
+        const std::string &input_path,
+        const std::string &output_path,
+        decompressor &decompressor)
+    {
+        check_distinct(input_path, output_path);
+        file_handle input(input_path, O_RDONLY);
+        const size_t input_size = input.size();
+        file_mapping source(input, input_path, input_size, false);
+        const std::optional<size_t> size = decompressor.decompressed_size(source.data(), input_size);
+        if (size && trusted_size(*size, input_size))
+        {
+            return write_mapped(output_path, *size, true, [&](uint8_t *output, size_t output_size) {
+                return decompressor.decompress(source.data(), input_size, output, output_size);
+            });
+        }
+        const codec_result result = write_growing(output_path, input_size, [&](uint8_t *output, size_t output_size) {
+            return decompressor.try_decompress(source.data(), input_size, output, output_size);
+        });
+        if (result)
+        {
+            return result.size;
+        }
+        if (result.status != status::failed)
+        {
+            throw_result(result, "File decompression");
+        }
+        // decompressors that cannot tell a short output from bad data are
+        // decompressed in memory, which also reports the actual error
+        std::vector<uint8_t> output;
+        decompressor.decompress_to(source.data(), input_size, output);
+        return write_stream(output_path, [&](file_handle &file) {
+            file.write(output.data(), output.size());
+            return output.size();
+        });
+    }
+
+    size_t decompress_file(
+        const std::string &input_path,
+        const std::string &output_path,
+        decoder &decoder)
+    {
+        check_distinct(input_path, output_path);
+        file_handle input(input_path, O_RDONLY);
+        const size_t input_size = input.size();
+        file_mapping source(input, input_path, input_size, false);
+        return write_stream(output_path, [&](file_handle &file) {
+            return decode_all(decoder, source.data(), input_size, [&](const uint8_t *data, size_t size) {
+                file.write(data, size);
+            });
+        });
+    }
+#else
+    static std::vector<uint8_t> read_file(const std::string &path)
+    {
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        if (!stream)
+        {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        std::vector<uint8_t> data(static_cast<size_t>(stream.tellg()));
+        stream.seekg(0);
+        if (!stream.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size())))
+        {
+            throw std::runtime_error("Failed to read " + path);
+        }
+        return data;
+    }
+
+    static size_t write_file(const std::string &path, const std::vector<uint8_t> &data)
+    {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        if (!stream || !stream.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size())))
+        {
+            stream.close();
+            std::remove(path.c_str());
+            throw std::runtime_error("Failed to write " + path);
+        }
+        return data.size();
+    }
+
+    static void write_stream(std::ofstream &stream, const std::string &path, const uint8_t *data, size_t size)
+    {
+        if (!stream.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size)))
+        {
+            throw std::runtime_error("Failed to write " + path);
+        }
+    }
+
+    size_t compress_file(
+        const std::string &input_path,
+        const std::string &output_path,
+        compressor &compressor)
+    {
+        check_distinct(input_path, output_path);
+        const std::vector<uint8_t> input = read_file(input_path);
+        std::vector<uint8_t> output;
+        compressor.compress_to(input.data(), input.size(), output);
+        return write_file(output_path, output);
+    }
+
+    size_t decompress_file(
+        const std::string &input_path,
+        const std::string &output_path,
+        decompressor &decompressor)
+    {
+        check_distinct(input_path, output_path);
+        const std::vector<uint8_t> input = read_file(input_path);
+        std::vector<uint8_t> output;
+        decompressor.decompress_to(input.data(), input.size(), output);
+        return write_file(output_path, output);
+    }
+
+    size_t decompress_file(
+        const std::string &input_path,
+        const std::string &output_path,
+        decoder &decoder)
+    {
+        check_distinct(input_path, output_path);
+        const std::vector<uint8_t> input = read_file(input_path);
+        try
+        {
+            std::ofstream stream(output_path, std::ios::binary | std::ios::trunc);
+            if (!stream)
+            {
+                throw std::runtime_error("Failed to open " + output_path);
+            }
+            return decode_all(decoder, input.data(), input.size(), [&](const uint8_t *data, size_t size) {
+                write_stream(stream, output_path, data, size);
+            });
+        }
+        catch (...)
+        {
+            std::remove(output_path.c_str());
+            throw;
+        }
+    }
+#endif
+}
@@ -28,13 +28,46 @@
 #include <brotli/decode.h>
 #include <brotli/encode.h>
 
+#ifdef MAXZIP_ZLIB_NG
+#include <zlib-ng.h>
+#else
 #include <zlib.h>
+#endif
 
+// the dictionary attach calls are only exported by static LZ4 libraries
+#ifdef MAXZIP_LZ4_ATTACH
+#define LZ4_STATIC_LINKING_ONLY
+#define LZ4_HC_STATIC_LINKING_ONLY
+#endif
+#include <lz4.h>
+#include <lz4hc.h>
+
+#define ZSTD_STATIC_LINKING_ONLY
 #include <zstd.h>
+#include <zstd_errors.h>
+#include <zdict.h>
+
+// prepared and attached shared dictionaries first appeared in brotli 1.1.0
+#if defined(BROTLI_COMMON_SHARED_DICTIONARY_H_)
+#define MAXZIP_BROTLI_DICTIONARY 1
+#else
+#define MAXZIP_BROTLI_DICTIONARY 0
+#endif
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace maxzip
 {
@@ -45,6 +78,326 @@ namespace maxzip
         return (value >= min && value <= max);
     }
 
+    template <typename T>
+    void store_le(uint8_t *destination, T value)
+    {
+        for (size_t i = 0; i < sizeof(T); i++)
+        {
+            destination[i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+        }
+    }
+
+    template <typename T>
+    T load_le(const uint8_t *source)
+    {
+        uint64_t value(0);
+        for (size_t i = 0; i < sizeof(T); i++)
+        {
+            value |= static_cast<uint64_t>(source[i]) << (8 * i);
+        }
+        return static_cast<T>(value);
+    }
+
+    /*
+     * A decompressed size recorded in a header is only trusted to size an
+     * allocation up to this multiple of the compressed size. It is the most that
+     * Zstandard data can expand, since every block takes at least 4 bytes and
+     * produces at most ZSTD_BLOCKSIZE_MAX bytes. Larger claims are decoded into a
+     * growing buffer so that memory follows the data actually produced.
+     */
+    static constexpr size_t max_trusted_expansion = ZSTD_BLOCKSIZE_MAX / 4;
+
+    inline bool trusted_size(uint64_t size, size_t input_size)
+    {
+        return size <= std::numeric_limits<size_t>::max() && size / max_trusted_expansion <= input_size;
+    }
+
+    /*
+     * Envelope byte written before every block whose codec is chosen at run
+     * time. The high nibble tags the envelope and the low nibble holds the codec.
+     */
+    static constexpr uint8_t envelope_tag = 0xB0;
+    static constexpr uint8_t envelope_mask = 0xF0;
+
+    inline uint8_t envelope_byte(codec type)
+    {
+        return static_cast<uint8_t>(envelope_tag | static_cast<uint8_t>(type));
+    }
+
+    /**
+     * Compress a batch of blocks into a contiguous buffer. Backends pass
+     * non-virtual bound and compress functions so the loop avoids per-block
+     * dispatch and size queries.
+     */
+    template <typename BoundFunction, typename CompressFunction>
+    size_t compress_batch(
+        const input_buffer *inputs,
+        size_t input_count,
+        std::vector<uint8_t> &output,
+        batch_entry *entries,
+        BoundFunction bound,
+        CompressFunction compress)
+    {
+        size_t total(0);
+        for (size_t i = 0; i < input_count; i++)
+        {
+            total += bound(inputs[i]);
+        }
+        if (output.size() < total)
+        {
+            output.resize(total);
+        }
+
+        size_t offset(0);
+        for (size_t i = 0; i < input_count; i++)
+        {
+            size_t available = output.size() - offset;
+            const size_t size = compress(inputs[i].data, inputs[i].size, output.data() + offset, available);
+            entries[i] = {offset, size};
+            offset += size;
+        }
+        return offset;
+    }
+
+    template <typename DecompressFunction>
+    size_t decompress_batch(
+        const input_buffer *inputs,
+        size_t input_count,
+        const size_t *output_sizes,
+        std::vector<uint8_t> &output,
+        batch_entry *entries,
+        DecompressFunction decompress)
+    {
+        size_t total(0);
+        for (size_t i = 0; i < input_count; i++)
+        {
+            total += output_sizes[i];
+        }
+        if (output.size() < total)
+        {
+            output.resize(total);
+        }
+
+        size_t offset(0);
+        for (size_t i = 0; i < input_count; i++)
+        {
+            const size_t size = decompress(inputs[i].data, inputs[i].size, output.data() + offset, output_sizes[i]);
+            entries[i] = {offset, size};
+            offset += size;
+        }
+        return offset;
+    }
+
+    /**
+     * Compress a block into a buffer that is resized to the compressed size.
+     */
+    template <typename BoundFunction, typename CompressFunction>
+    size_t compress_to(
+        const uint8_t *input,
+        size_t input_size,
+        std::vector<uint8_t> &output,
+        BoundFunction bound,
+        CompressFunction compress)
+    {
+        output.resize(bound(input_buffer{input, input_size}));
+        size_t output_size = output.size();
+        output.resize(compress(input, input_size, output.data(), output_size));
+        return output.size();
+    }
+
+    /**
+     * Decompress into a buffer of unknown final size. The step function writes
+     * into the free space it is given, returns the number of bytes written and
+     * sets finished at the end of the data. It returns without finishing only
+     * when it needs more space, and throws if the data is invalid or truncated.
+     */
+    template <typename StepFunction>
+    size_t decompress_growing(
+        size_t input_size,
+        std::vector<uint8_t> &output,
+        StepFunction step)
+    {
+        constexpr size_t min_size = 4096;
+        output.resize(std::max({output.capacity(), min_size, input_size * 2}));
+        size_t produced(0);
+        bool finished(false);
+        while (true)
+        {
+            const size_t written = step(output.data() + produced, output.size() - produced, finished);
+            produced += written;
+            if (finished)
+            {
+                break;
+            }
+            if (written == 0)
+            {
+                throw std::runtime_error("Decompression made no progress.");
+            }
+            output.resize(output.size() * 2);
+        }
+        output.resize(produced);
+        return produced;
+    }
+
+    /**
+     * Walks a list of input or output buffers as one sequence, skipping empty
+     * buffers. Streaming backends take the current buffer with data() and
+     * available() and report how much of it they used with advance().
+     */
+    template <typename Buffer>
+    class buffer_cursor
+    {
+    public:
+        buffer_cursor(const Buffer *buffers, size_t count) : _buffers(buffers), _count(count), _index(0), _offset(0), _position(0), _size(0)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                _size += buffers[i].size;
+            }
+            skip_empty();
+        }
+
+        decltype(Buffer::data) data() const
+        {
+            return (_index < _count) ? _buffers[_index].data + _offset : nullptr;
+        }
+
+        size_t available() const
+        {
+            return (_index < _count) ? _buffers[_index].size - _offset : 0;
+        }
+
+        // bytes used so far
+        size_t position() const
+        {
+            return _position;
+        }
+
+        // bytes left across all buffers
+        size_t remaining() const
+        {
+            return _size - _position;
+        }
+
+        void advance(size_t size)
+        {
+            _offset += size;
+            _position += size;
+            skip_empty();
+        }
+
+    private:
+        void skip_empty()
+        {
+            while (_index < _count && _offset == _buffers[_index].size)
+            {
+                _index++;
+                _offset = 0;
+            }
+        }
+
+        const Buffer *_buffers;
+        size_t _count;
+        size_t _index;
+        size_t _offset;
+        size_t _position;
+        size_t _size;
+    };
+
+    /**
+     * Portable CRC32C kernel behind the crc32c dispatcher, exposed so that tests
+     * can compare it with the hardware path. It works on the raw register,
+     * without the inversions that crc32c applies.
+     */
+    uint32_t crc32c_software(uint32_t state, const uint8_t *data, size_t size) noexcept;
+
+    /**
+     * SHA-256 block functions, which add count 64-byte blocks to the state.
+     * sha256_blocks uses the SHA extensions when the processor has them, and
+     * the portable sha256_software is exposed so that tests can compare the two.
+     */
+    void sha256_blocks(uint32_t *state, const uint8_t *blocks, size_t count) noexcept;
+    void sha256_software(uint32_t *state, const uint8_t *blocks, size_t count) noexcept;
+
+    /**
+     * Throw the exception that the throwing calls report for a failed result
+     * of the corresponding non-throwing call.
+     */
+    [[noreturn]] void throw_result(const codec_result &result, const char *operation);
+
+    /**
+     * @class dictionary_impl
+     * @brief Dictionary that builds and owns the digested form used by each
+     * backend. Digested forms are created on first use and are safe to share
+     * across threads.
+     */
+    class dictionary_impl : public dictionary
+    {
+    public:
+        dictionary_impl(const uint8_t *data, size_t size);
+        ~dictionary_impl();
+
+        uint32_t id() const override;
+        const uint8_t *data() const override;
+        size_t size() const override;
+
+        const ZSTD_CDict *zstd_cdict(int level);
+        const ZSTD_DDict *zstd_ddict();
+#if MAXZIP_BROTLI_DICTIONARY
+        const BrotliEncoderPreparedDictionary *brotli_prepared();
+#endif
+
+        /**
+         * @brief Get the backend form of a dictionary passed in through params
+         * @return The dictionary, or nullptr if none was given
+         */
+        static dictionary_impl *from(const std::shared_ptr<dictionary> &dictionary);
+
+    private:
+        std::vector<uint8_t> _data;
+        uint32_t _id;
+        std::mutex _mutex;
+        std::unordered_map<int, ZSTD_CDict *> _cdicts;
+        ZSTD_DDict *_ddict;
+#if MAXZIP_BROTLI_DICTIONARY
+        BrotliEncoderPreparedDictionary *_brotli_prepared;
+#endif
+    };
+
+    /**
+     * @class worker_pool
+     * @brief Fixed set of threads that run a task in parallel. The calling thread
+     * participates as worker 0, so a pool of size 1 spawns no threads.
+     */
+    class worker_pool
+    {
+    public:
+        explicit worker_pool(size_t size);
+        ~worker_pool();
+
+        size_t size() const;
+
+        /**
+         * @brief Run task(worker_index) once on every worker and wait for all of
+         * them to return. The first exception thrown by any worker is rethrown.
+         */
+        void run(const std::function<void(size_t)> &task);
+
+    private:
+        void worker_loop(size_t index);
+
+        std::vector<std::thread> _threads;
+        std::mutex _run_mutex;
+        std::mutex _mutex;
+        std::condition_variable _start;
+        std::condition_variable _done;
+        const std::function<void(size_t)> *_task;
+        std::exception_ptr _error;
+        uint64_t _generation;
+        size_t _active;
+        bool _stopping;
+    };
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <internal.hpp>
+
+namespace maxzip
+{
+    static constexpr size_t lz4_max_size = static_cast<size_t>(std::numeric_limits<int>::max());
+
+    // larger values are clamped by the library, see LZ4_ACCELERATION_MAX in lz4.c
+    static constexpr int lz4_max_acceleration = 65537;
+
+    static int lz4_size(size_t size)
+    {
+        return static_cast<int>(std::min(size, lz4_max_size));
+    }
+
+    /**
+     * @class lz4_state
+     * @brief Compression state memory, taken from the allocator when one is given
+     */
+    class lz4_state
+    {
+    public:
+        lz4_state(size_t size, std::shared_ptr<allocator> allocator) : _allocator(std::move(allocator)), _data(nullptr)
+        {
+            _data = (_allocator != nullptr) ? _allocator->allocate(size) : std::malloc(size);
+            if (_data == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+        }
+
+        lz4_state(const lz4_state &) = delete;
+        lz4_state &operator=(const lz4_state &) = delete;
+
+        ~lz4_state()
+        {
+            if (_allocator != nullptr)
+            {
+                _allocator->deallocate(_data);
+            }
+            else
+            {
+                std::free(_data);
+            }
+        }
+
+        void *data() const
+        {
+            return _data;
+        }
+
+    private:
+        std::shared_ptr<allocator> _allocator;
+        void *_data;
+    };
+
+    class lz4_compressor final : public compressor
+    {
+    public:
+        lz4_compressor(int acceleration, std::optional<int> level, std::shared_ptr<allocator> allocator, std::shared_ptr<dictionary> dictionary)
+            : _acceleration(acceleration),
+              _level(level.value_or(0)),
+              _dictionary(std::move(dictionary)),
+              _state(level ? LZ4_sizeofStateHC() : LZ4_sizeofState(), allocator),
+              _stream(nullptr),
+              _stream_hc(nullptr),
+              _dictionary_stream(nullptr),
+              _dictionary_stream_hc(nullptr)
+        {
+            if (level)
+            {
+                _stream_hc = LZ4_initStreamHC(_state.data(), LZ4_sizeofStateHC());
+                LZ4_resetStreamHC_fast(_stream_hc, _level);
+            }
+            else
+            {
+                _stream = LZ4_initStream(_state.data(), LZ4_sizeofState());
+            }
+            if (_stream == nullptr && _stream_hc == nullptr)
+            {
+                throw std::runtime_error("Failed to initialize LZ4 compressor");
+            }
+
+            // the dictionary is hashed once into its own stream, which each
+            // block then starts from
+            if (_dictionary)
+            {
+                const char *data = reinterpret_cast<const char *>(_dictionary->data());
+                _dictionary_state = std::make_unique<lz4_state>(level ? LZ4_sizeofStateHC() : LZ4_sizeofState(), std::move(allocator));
+                if (level)
+                {
+                    _dictionary_stream_hc = LZ4_initStreamHC(_dictionary_state->data(), LZ4_sizeofStateHC());
+                    LZ4_resetStreamHC_fast(_dictionary_stream_hc, _level);
+                    LZ4_loadDictHC(_dictionary_stream_hc, data, lz4_size(_dictionary->size()));
+                }
+                else
+                {
+                    _dictionary_stream = LZ4_initStream(_dictionary_state->data(), LZ4_sizeofState());
+                    LZ4_loadDict(_dictionary_stream, data, lz4_size(_dictionary->size()));
+                }
+            }
+        }
+
+        size_t compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            // checked up front so that oversized blocks are reported as such
+            const size_t max_size = bound(input_size);
+            size_t compressed_size(0);
+            if (output != nullptr)
+            {
+                const codec_result result = try_compress(input, input_size, output, output_size);
+                if (!result)
+                {
+                    throw_result(result, "LZ4 compression");
+                }
+                compressed_size = result.size;
+            }
+            else
+            {
+                output_size = max_size;
+            }
+            return compressed_size;
+        }
+
+        codec_result try_compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            if (input_size > LZ4_MAX_INPUT_SIZE)
+            {
+                return {status::failed, 0};
+            }
+            const char *source = reinterpret_cast<const char *>(input);
+            char *destination = reinterpret_cast<char *>(output);
+            const int source_size = static_cast<int>(input_size);
+            const int capacity = lz4_size(output_size);
+            int compressed_size(0);
+            // a fast reset keeps the hash tables allocated and only forgets the
+            // previous block, which matters for small records. The loaded
+            // dictionary is referenced in place where the library exports the
+            // attach calls, and otherwise copied, which is still far cheaper than
+            // hashing the dictionary again.
+            if (_stream_hc != nullptr)
+            {
+#ifdef MAXZIP_LZ4_ATTACH
+                LZ4_resetStreamHC_fast(_stream_hc, _level);
+                LZ4_attach_HC_dictionary(_stream_hc, _dictionary_stream_hc);
+#else
+                if (_dictionary_stream_hc != nullptr)
+                {
+                    std::memcpy(_stream_hc, _dictionary_stream_hc, static_cast<size_t>(LZ4_sizeofStateHC()));
+                }
+                else
+                {
+                    LZ4_resetStreamHC_fast(_stream_hc, _level);
+                }
+#endif
+                compressed_size = LZ4_compress_HC_continue(_stream_hc, source, destination, source_size, capacity);
+            }
+            else
+            {
+                LZ4_resetStream_fast(_stream);
+#ifdef MAXZIP_LZ4_ATTACH
+                LZ4_attach_dictionary(_stream, _dictionary_stream);
+#else
+                if (_dictionary_stream != nullptr)
+                {
+                    std::memcpy(_stream, _dictionary_stream, static_cast<size_t>(LZ4_sizeofState()));
+                }
+#endif
+                compressed_size = LZ4_compress_fast_continue(_stream, source, destination, source_size, capacity, _acceleration);
+            }
+            if (compressed_size <= 0)
+            {
+                return {status::insufficient_output, bound(input_size)};
+            }
+            return {status::ok, static_cast<size_t>(compressed_size)};
+        }
+
+        size_t compress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            return maxzip::compress_batch(
+                inputs,
+                input_count,
+                output,
+                entries,
+                [](const input_buffer &input) { return bound(input.size); },
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                    return compress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t compress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            return maxzip::compress_to(
+                input,
+                input_size,
+                output,
+                [](const input_buffer &input) { return bound(input.size); },
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                    return compress(input, input_size, output, output_size);
+                });
+        }
+
+    private:
+        static size_t bound(size_t input_size)
+        {
+            if (input_size > LZ4_MAX_INPUT_SIZE)
+            {
+                throw std::invalid_argument("LZ4 blocks are limited to " + std::to_string(LZ4_MAX_INPUT_SIZE) + " bytes");
+            }
+            return static_cast<size_t>(LZ4_compressBound(static_cast<int>(input_size)));
+        }
+
+        int _acceleration;
+        int _level;
+        std::shared_ptr<dictionary> _dictionary;
+        lz4_state _state;
+        LZ4_stream_t *_stream;
+        LZ4_streamHC_t *_stream_hc;
+        std::unique_ptr<lz4_state> _dictionary_state;
+        LZ4_stream_t *_dictionary_stream;
+        LZ4_streamHC_t *_dictionary_stream_hc;
+    };
+
+    class lz4_decompressor final : public decompressor
+    {
+    public:
+        lz4_decompressor(std::shared_ptr<dictionary> dictionary) : _dictionary(std::move(dictionary))
+        {
+        }
+
+        size_t decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) override
+        {
+            const codec_result result = try_decompress(input, input_size, output, output_size);
+            if (!result)
+            {
+                throw_result(result, "LZ4 decompression");
+            }
+            return result.size;
+        }
+
+        codec_result try_decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            if (input_size > lz4_max_size)
+            {
+                return {status::corrupt_input, 0};
+            }
+            const char *source = reinterpret_cast<const char *>(input);
+            char *destination = reinterpret_cast<char *>(output);
+            const int source_size = static_cast<int>(input_size);
+            const int capacity = lz4_size(output_size);
+            const char *dictionary = _dictionary ? reinterpret_cast<const char *>(_dictionary->data()) : nullptr;
+            const int dictionary_size = _dictionary ? lz4_size(_dictionary->size()) : 0;
+            const int decompressed_size = LZ4_decompress_safe_usingDict(source, destination, source_size, capacity, dictionary, dictionary_size);
+            if (decompressed_size >= 0)
+            {
+                return {status::ok, static_cast<size_t>(decompressed_size)};
+            }
+            // the block decoder reports an undersized buffer and corrupt data alike,
+            // so decode again up to the end of the buffer to tell them apart
+            if (LZ4_decompress_safe_partial_usingDict(source, destination, source_size, capacity, capacity, dictionary, dictionary_size) == capacity)
+            {
+                // LZ4 blocks do not record the decompressed size
+                return {status::insufficient_output, 0};
+            }
+            return {status::corrupt_input, 0};
+        }
+
+        size_t decompress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            const size_t *output_sizes,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            return maxzip::decompress_batch(
+                inputs,
+                input_count,
+                output_sizes,
+                output,
+                entries,
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size) {
+                    return decompress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            // blocks cannot be decoded incrementally, so each attempt decodes from
+            // the start into a buffer twice the size of the last
+            output.resize(std::max({output.capacity(), size_t(4096), input_size * 2}));
+            while (true)
+            {
+                const codec_result result = try_decompress(input, input_size, output.data(), output.size());
+                if (result)
+                {
+                    output.resize(result.size);
+                    return result.size;
+                }
+                if (result.status != status::insufficient_output || output.size() >= lz4_max_size)
+                {
+                    throw_result(result, "LZ4 decompression");
+                }
+                output.resize(std::min(output.size() * 2, lz4_max_size));
+            }
+        }
+
+    private:
+        std::shared_ptr<dictionary> _dictionary;
+    };
+
+    compressor *create_lz4_compressor(const lz4_compressor_params &params)
+    {
+        if (params.acceleration && params.level)
+        {
+            throw std::invalid_argument("LZ4 acceleration and level are mutually exclusive");
+        }
+        const int acceleration = params.acceleration.value_or(1);
+        if (!maxzip::in_range(acceleration, 1, lz4_max_acceleration))
+        {
+            throw std::invalid_argument("Acceleration must be between 1 and " + std::to_string(lz4_max_acceleration));
+        }
+        if (params.level && !maxzip::in_range(*params.level, 1, LZ4HC_CLEVEL_MAX))
+        {
+            throw std::invalid_argument("Level must be between 1 and " + std::to_string(LZ4HC_CLEVEL_MAX));
+        }
+        return new lz4_compressor(acceleration, params.level, params.allocator, params.dictionary);
+    }
+
+    decompressor *create_lz4_decompressor(const lz4_decompressor_params &params)
+    {
+        return new lz4_decompressor(params.dictionary);
+    }
+}
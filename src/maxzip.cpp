@@ -22,4 +22,225 @@
 
  #include <internal.hpp>
 
- 
\ No newline at end of file
+namespace maxzip
+{
+    size_t compressor::compress_batch(
+        const input_buffer *inputs,
+        size_t input_count,
+        std::vector<uint8_t> &output,
+        batch_entry *entries)
+    {
+        return maxzip::compress_batch(
+            inputs,
+            input_count,
+            output,
+            entries,
+            [this](const input_buffer &input) {
+                size_t bound(0);
+                compress(input.data, input.size, nullptr, bound);
+                return bound;
+            },
+            [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                return compress(input, input_size, output, output_size);
+            });
+    }
+
+    size_t decompressor::decompress_batch(
+        const input_buffer *inputs,
+        size_t input_count,
+        const size_t *output_sizes,
+        std::vector<uint8_t> &output,
+        batch_entry *entries)
+    {
+        return maxzip::decompress_batch(
+            inputs,
+            input_count,
+            output_sizes,
+            output,
+            entries,
+            [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size) {
+                return decompress(input, input_size, output, output_size);
+            });
+    }
+
+    size_t compressor::compress_to(
+        const uint8_t *input,
+        size_t input_size,
+        std::vector<uint8_t> &output)
+    {
+        return maxzip::compress_to(
+            input,
+            input_size,
+            output,
+            [this](const input_buffer &input) {
+                size_t bound(0);
+                compress(input.data, input.size, nullptr, bound);
+                return bound;
+            },
+            [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                return compress(input, input_size, output, output_size);
+            });
+    }
+
+    std::optional<size_t> decompressor::decompressed_size(
+        const uint8_t *,
+        size_t)
+    {
+        return std::nullopt;
+    }
+
+    size_t decompressor::decompress_to(
+        const uint8_t *input,
+        size_t input_size,
+        std::vector<uint8_t> &output)
+    {
+        const std::optional<size_t> size = decompressed_size(input, input_size);
+        if (!size)
+        {
+            throw std::runtime_error("Decompressed size is unknown.");
+        }
+        output.resize(*size);
+        output.resize(decompress(input, input_size, output.data(), output.size()));
+        return output.size();
+    }
+
+    /*
+     * Backends without a streaming implementation of the vectored calls gather
+     * the input into one buffer and scatter the result. A single buffer is used
+     * in place.
+     */
+    static input_buffer gather(const input_buffer *inputs, size_t input_count, std::vector<uint8_t> &storage)
+    {
+        if (input_count == 1)
+        {
+            return inputs[0];
+        }
+        storage.clear();
+        for (size_t i = 0; i < input_count; i++)
+        {
+            storage.insert(storage.end(), inputs[i].data, inputs[i].data + inputs[i].size);
+        }
+        return {storage.data(), storage.size()};
+    }
+
+    static size_t scatter(const uint8_t *input, size_t input_size, const output_buffer *outputs, size_t output_count)
+    {
+        buffer_cursor<output_buffer> output(outputs, output_count);
+        if (output.remaining() < input_size)
+        {
+            throw std::runtime_error("Insufficient output buffer size.");
+        }
+        while (output.position() < input_size)
+        {
+            const size_t size = std::min(output.available(), input_size - output.position());
+            std::memcpy(output.data(), input + output.position(), size);
+            output.advance(size);
+        }
+        return input_size;
+    }
+
+    size_t compressor::compressv(
+        const input_buffer *inputs,
+        size_t input_count,
+        const output_buffer *outputs,
+        size_t output_count)
+    {
+        std::vector<uint8_t> storage;
+        const input_buffer input = gather(inputs, input_count, storage);
+        if (output_count == 1)
+        {
+            size_t output_size(outputs[0].size);
+            return compress(input.data, input.size, outputs[0].data, output_size);
+        }
+        std::vector<uint8_t> output;
+        compress_to(input.data, input.size, output);
+        return scatter(output.data(), output.size(), outputs, output_count);
+    }
+
+    size_t decompressor::decompressv(
+        const input_buffer *inputs,
+        size_t input_count,
+        const output_buffer *outputs,
+        size_t output_count)
+    {
+        std::vector<uint8_t> storage;
+        const input_buffer input = gather(inputs, input_count, storage);
+        if (output_count == 1)
+        {
+            return decompress(input.data, input.size, outputs[0].data, outputs[0].size);
+        }
+        std::vector<uint8_t> output(buffer_cursor<output_buffer>(outputs, output_count).remaining());
+        const size_t size = decompress(input.data, input.size, output.data(), output.size());
+        return scatter(output.data(), size, outputs, output_count);
+    }
+
+    codec_result compressor::try_compress(
+        const uint8_t *input,
+        size_t input_size,
+        uint8_t *output,
+        size_t output_size) noexcept
+    {
+        // backends without a native implementation fall back to the throwing call
+        try
+        {
+            size_t compressed_size(output_size);
+            return {status::ok, compress(input, input_size, output, compressed_size)};
+        }
+        catch (...)
+        {
+        }
+        try
+        {
+            size_t bound(0);
+            compress(input, input_size, nullptr, bound);
+            if (output_size < bound)
+            {
+                return {status::insufficient_output, bound};
+            }
+        }
+        catch (...)
+        {
+        }
+        return {status::failed, 0};
+    }
+
+    codec_result decompressor::try_decompress(
+        const uint8_t *input,
+        size_t input_size,
+        uint8_t *output,
+        size_t output_size) noexcept
+    {
+        try
+        {
+            return {status::ok, decompress(input, input_size, output, output_size)};
+        }
+        catch (...)
+        {
+        }
+        try
+        {
+            const std::optional<size_t> size = decompressed_size(input, input_size);
+            if (size && output_size < *size)
+            {
+                return {status::insufficient_output, *size};
+            }
+        }
+        catch (...)
+        {
+        }
+        return {status::failed, 0};
+    }
+
+    void throw_result(const codec_result &result, const char *operation)
+    {
+        switch (result.status)
+        {
+        case status::insufficient_output:
+            throw std::runtime_error("Insufficient output buffer size.");
+        case status::corrupt_input:
+            throw std::runtime_error(std::string(operation) + " failed: corrupt input");
+        default:
+            throw std::runtime_error(std::string(operation) + " failed");
+        }
+    }
+}
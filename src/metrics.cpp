@@ -0,0 +1,573 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <internal.hpp>
+
+#include <chrono>
+#include <cstdio>
+
+namespace maxzip
+{
+    double codec_metrics::ratio() const
+    {
+        if (compressed_bytes == 0)
+        {
+            return 0.0;
+        }
+        return static_cast<double>(uncompressed_bytes) / static_cast<double>(compressed_bytes);
+    }
+
+    uint64_t codec_metrics::latency_percentile(double fraction) const
+    {
+        uint64_t total(0);
+        for (uint64_t count : latency_histogram)
+        {
+            total += count;
+        }
+        const uint64_t rank = static_cast<uint64_t>(std::max(0.0, std::min(fraction, 1.0)) * static_cast<double>(total));
+        uint64_t seen(0);
+        for (size_t i = 0; i < latency_histogram.size(); i++)
+        {
+            seen += latency_histogram[i];
+            if (seen > rank || (seen == total && seen > 0))
+            {
+                return (uint64_t(1) << (i + 1)) - 1;
+            }
+        }
+        return 0;
+    }
+
+#ifdef MAXZIP_METRICS
+    /**
+     * @class metrics_counters
+     * @brief Counters of one instrumented object. Only the thread using the
+     * object writes them, so updates are plain relaxed loads and stores, and
+     * snapshots from other threads read them without locking.
+     */
+    class metrics_counters
+    {
+    public:
+        void record(uint64_t uncompressed_bytes, uint64_t compressed_bytes, uint64_t nanoseconds)
+        {
+            add(_calls, 1);
+            add(_uncompressed_bytes, uncompressed_bytes);
+            add(_compressed_bytes, compressed_bytes);
+            add(_total_nanoseconds, nanoseconds);
+            add(_latency_histogram[bucket(nanoseconds)], 1);
+        }
+
+        void record_failure(uint64_t nanoseconds)
+        {
+            add(_calls, 1);
+            add(_failures, 1);
+            add(_total_nanoseconds, nanoseconds);
+            add(_latency_histogram[bucket(nanoseconds)], 1);
+        }
+
+        void add_to(codec_metrics &metrics) const
+        {
+            metrics.calls += _calls.load(std::memory_order_relaxed);
+            metrics.failures += _failures.load(std::memory_order_relaxed);
+            metrics.uncompressed_bytes += _uncompressed_bytes.load(std::memory_order_relaxed);
+            metrics.compressed_bytes += _compressed_bytes.load(std::memory_order_relaxed);
+            metrics.total_nanoseconds += _total_nanoseconds.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < metrics_histogram_size; i++)
+            {
+                metrics.latency_histogram[i] += _latency_histogram[i].load(std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        static void add(std::atomic<uint64_t> &counter, uint64_t value)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        static size_t bucket(uint64_t nanoseconds)
+        {
+            size_t index(0);
+            while (nanoseconds > 1 && index + 1 < metrics_histogram_size)
+            {
+                nanoseconds >>= 1;
+                index++;
+            }
+            return index;
+        }
+
+        std::atomic<uint64_t> _calls{0};
+        std::atomic<uint64_t> _failures{0};
+        std::atomic<uint64_t> _uncompressed_bytes{0};
+        std::atomic<uint64_t> _compressed_bytes{0};
+        std::atomic<uint64_t> _total_nanoseconds{0};
+        std::array<std::atomic<uint64_t>, metrics_histogram_size> _latency_histogram = {};
+    };
+
+    /**
+     * @class metrics_registry
+     * @brief Process-wide set of live counters, plus the totals of destroyed
+     * instances, so snapshots cover the whole life of the process
+     */
+    class metrics_registry
+    {
+    public:
+        static metrics_registry &instance()
+        {
+            static metrics_registry registry;
+            return registry;
+        }
+
+        void attach(const std::string &key, const metrics_counters *counters)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _live.emplace(key, counters);
+        }
+
+        void detach(const std::string &key, const metrics_counters *counters)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto range = _live.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (it->second == counters)
+                {
+                    counters->add_to(_retired[key]);
+                    _live.erase(it);
+                    break;
+                }
+            }
+        }
+
+        std::map<std::string, codec_metrics> snapshot() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::map<std::string, codec_metrics> result(_retired);
+            for (const auto &entry : _live)
+            {
+                entry.second->add_to(result[entry.first]);
+            }
+            return result;
+        }
+
+    private:
+        mutable std::mutex _mutex;
+        std::unordered_multimap<std::string, const metrics_counters *> _live;
+        std::map<std::string, codec_metrics> _retired;
+    };
+
+    /**
+     * Time one call and record it in the counters. Failed calls are counted and
+     * their exception is rethrown.
+     */
+    template <typename Function>
+    static size_t measure(metrics_counters &counters, size_t input_size, bool compressing, Function function)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t output_size(0);
+        try
+        {
+            output_size = function();
+        }
+        catch (...)
+        {
+            counters.record_failure(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+            throw;
+        }
+        const uint64_t nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        if (compressing)
+        {
+            counters.record(input_size, output_size, nanoseconds);
+        }
+        else
+        {
+            counters.record(output_size, input_size, nanoseconds);
+        }
+        return output_size;
+    }
+
+    /**
+     * Time one non-throwing call and record it in the counters
+     */
+    template <typename Function>
+    static codec_result measure_result(metrics_counters &counters, size_t input_size, bool compressing, Function function)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const codec_result result = function();
+        const uint64_t nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        if (!result)
+        {
+            counters.record_failure(nanoseconds);
+        }
+        else if (compressing)
+        {
+            counters.record(input_size, result.size, nanoseconds);
+        }
+        else
+        {
+            counters.record(result.size, input_size, nanoseconds);
+        }
+        return result;
+    }
+#else
+    class metrics_counters
+    {
+    public:
+        void add_to(codec_metrics &) const
+        {
+        }
+    };
+
+    class metrics_registry
+    {
+    public:
+        static metrics_registry &instance()
+        {
+            static metrics_registry registry;
+            return registry;
+        }
+
+        void attach(const std::string &, const metrics_counters *)
+        {
+        }
+
+        void detach(const std::string &, const metrics_counters *)
+        {
+        }
+
+        std::map<std::string, codec_metrics> snapshot() const
+        {
+            return {};
+        }
+    };
+
+    template <typename Function>
+    static size_t measure(metrics_counters &, size_t, bool, Function function)
+    {
+        return function();
+    }
+
+    template <typename Function>
+    static codec_result measure_result(metrics_counters &, size_t, bool, Function function)
+    {
+        return function();
+    }
+#endif
+
+    /**
+     * @class metrics_registration
+     * @brief Keeps a set of counters in the registry for the life of an
+     * instrumented object
+     */
+    class metrics_registration
+    {
+    public:
+        explicit metrics_registration(std::string key) : _key(std::move(key))
+        {
+            metrics_registry::instance().attach(_key, &_counters);
+        }
+
+        metrics_registration(const metrics_registration &) = delete;
+        metrics_registration &operator=(const metrics_registration &) = delete;
+
+        ~metrics_registration()
+        {
+            metrics_registry::instance().detach(_key, &_counters);
+        }
+
+        metrics_counters &counters()
+        {
+            return _counters;
+        }
+
+        codec_metrics metrics() const
+        {
+            codec_metrics metrics;
+            _counters.add_to(metrics);
+            return metrics;
+        }
+
+    private:
+        std::string _key;
+        metrics_counters _counters;
+    };
+
+    class instrumented_compressor_impl final : public instrumented_compressor
+    {
+    public:
+        instrumented_compressor_impl(std::unique_ptr<compressor> compressor, const std::string &name) : _compressor(std::move(compressor)), _registration(name + ".compress")
+        {
+        }
+
+        size_t compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            if (output == nullptr)
+            {
+                return _compressor->compress(input, input_size, output, output_size);
+            }
+            return measure(_registration.counters(), input_size, true, [&]() {
+                return _compressor->compress(input, input_size, output, output_size);
+            });
+        }
+
+        size_t compress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            size_t input_size(0);
+            for (size_t i = 0; i < input_count; i++)
+            {
+                input_size += inputs[i].size;
+            }
+            return measure(_registration.counters(), input_size, true, [&]() {
+                return _compressor->compress_batch(inputs, input_count, output, entries);
+            });
+        }
+
+        size_t compress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            return measure(_registration.counters(), input_size, true, [&]() {
+                return _compressor->compress_to(input, input_size, output);
+            });
+        }
+
+        codec_result try_compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            return measure_result(_registration.counters(), input_size, true, [&]() {
+                return _compressor->try_compress(input, input_size, output, output_size);
+            });
+        }
+
+        size_t compressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count) override
+        {
+            size_t input_size(0);
+            for (size_t i = 0; i < input_count; i++)
+            {
+                input_size += inputs[i].size;
+            }
+            return measure(_registration.counters(), input_size, true, [&]() {
+                return _compressor->compressv(inputs, input_count, outputs, output_count);
+            });
+        }
+
+        codec_metrics metrics() const override
+        {
+            return _registration.metrics();
+        }
+
+    private:
+        std::unique_ptr<compressor> _compressor;
+        metrics_registration _registration;
+    };
+
+    class instrumented_decompressor_impl final : public instrumented_decompressor
+    {
+    public:
+        instrumented_decompressor_impl(std::unique_ptr<decompressor> decompressor, const std::string &name) : _decompressor(std::move(decompressor)), _registration(name + ".decompress")
+        {
+        }
+
+        size_t decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) override
+        {
+            return measure(_registration.counters(), input_size, false, [&]() {
+                return _decompressor->decompress(input, input_size, output, output_size);
+            });
+        }
+
+        size_t decompress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            const size_t *output_sizes,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            size_t input_size(0);
+            for (size_t i = 0; i < input_count; i++)
+            {
+                input_size += inputs[i].size;
+            }
+            return measure(_registration.counters(), input_size, false, [&]() {
+                return _decompressor->decompress_batch(inputs, input_count, output_sizes, output, entries);
+            });
+        }
+
+        std::optional<size_t> decompressed_size(
+            const uint8_t *input,
+            size_t input_size) override
+        {
+            return _decompressor->decompressed_size(input, input_size);
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            return measure(_registration.counters(), input_size, false, [&]() {
+                return _decompressor->decompress_to(input, input_size, output);
+            });
+        }
+
+        codec_result try_decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            return measure_result(_registration.counters(), input_size, false, [&]() {
+                return _decompressor->try_decompress(input, input_size, output, output_size);
+            });
+        }
+
+        size_t decompressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count) override
+        {
+            size_t input_size(0);
+            for (size_t i = 0; i < input_count; i++)
+            {
+                input_size += inputs[i].size;
+            }
+            return measure(_registration.counters(), input_size, false, [&]() {
+                return _decompressor->decompressv(inputs, input_count, outputs, output_count);
+            });
+        }
+
+        codec_metrics metrics() const override
+        {
+            return _registration.metrics();
+        }
+
+    private:
+        std::unique_ptr<decompressor> _decompressor;
+        metrics_registration _registration;
+    };
+
+    bool metrics_enabled()
+    {
+#ifdef MAXZIP_METRICS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    instrumented_compressor *create_instrumented_compressor(compressor *compressor, const std::string &name)
+    {
+        std::unique_ptr<maxzip::compressor> owned(compressor);
+        if (!owned)
+        {
+            throw std::invalid_argument("Cannot instrument a null compressor");
+        }
+        return new instrumented_compressor_impl(std::move(owned), name);
+    }
+
+    instrumented_decompressor *create_instrumented_decompressor(decompressor *decompressor, const std::string &name)
+    {
+        std::unique_ptr<maxzip::decompressor> owned(decompressor);
+        if (!owned)
+        {
+            throw std::invalid_argument("Cannot instrument a null decompressor");
+        }
+        return new instrumented_decompressor_impl(std::move(owned), name);
+    }
+
+    std::map<std::string, codec_metrics> metrics_snapshot()
+    {
+        return metrics_registry::instance().snapshot();
+    }
+
+    static void append_json_string(std::string &output, const std::string &value)
+    {
+        output += '"';
+        for (char c : value)
+        {
+            if (c == '"' || c == '\\')
+            {
+                output += '\\';
+                output += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+                output += escaped;
+            }
+            else
+            {
+                output += c;
+            }
+        }
+        output += '"';
+    }
+
+    std::string metrics_json()
+    {
+        std::string output("{");
+        const char *separator = "";
+        for (const auto &entry : metrics_snapshot())
+        {
+            const codec_metrics &metrics = entry.second;
+            output += separator;
+            append_json_string(output, entry.first);
+            char ratio[32];
+            std::snprintf(ratio, sizeof(ratio), "%.4f", metrics.ratio());
+            output += ":{\"calls\":" + std::to_string(metrics.calls) +
+                      ",\"failures\":" + std::to_string(metrics.failures) +
+                      ",\"uncompressed_bytes\":" + std::to_string(metrics.uncompressed_bytes) +
+                      ",\"compressed_bytes\":" + std::to_string(metrics.compressed_bytes) +
+                      ",\"ratio\":" + ratio +
+                      ",\"total_nanoseconds\":" + std::to_string(metrics.total_nanoseconds) +
+                      ",\"latency_histogram\":[";
+            for (size_t i = 0; i < metrics.latency_histogram.size(); i++)
+            {
+                output += (i > 0 ? "," : "") + std::to_string(metrics.latency_histogram[i]);
+            }
+            output += "]}";
+            separator = ",";
+        }
+        output += "}";
+        return output;
+    }
+}
@@ -0,0 +1,547 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <internal.hpp>
+
+#include <atomic>
+
+namespace maxzip
+{
+    /*
+     * Parallel frame layout (all integers little-endian):
+     *   magic        4 bytes  "MXZP"
+     *   version      1 byte
+     *   reserved     3 bytes
+     *   chunk_size   4 bytes
+     *   content_size 8 bytes
+     *   sizes        4 bytes per chunk, compressed size of each chunk
+     *   chunks       compressed chunks, back to back
+     */
+    static constexpr uint8_t parallel_magic[4] = {'M', 'X', 'Z', 'P'};
+    static constexpr uint8_t parallel_version = 1;
+    static constexpr size_t parallel_header_size = 20;
+    static constexpr size_t parallel_entry_size = 4;
+    static constexpr size_t parallel_default_chunk_size = 1 << 20;
+    static constexpr size_t parallel_max_chunk_size = 1 << 30;
+
+    static size_t default_thread_count()
+    {
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    static size_t chunk_count(uint64_t content_size, size_t chunk_size)
+    {
+        return static_cast<size_t>((content_size + chunk_size - 1) / chunk_size);
+    }
+
+    class parallel_compressor : public compressor
+    {
+    public:
+        parallel_compressor(const compressor_factory &factory, size_t chunk_size, size_t thread_count) : _chunk_size(chunk_size), _pool(thread_count)
+        {
+            if (!maxzip::in_range<size_t>(_chunk_size, 1, parallel_max_chunk_size))
+            {
+                throw std::invalid_argument("Chunk size must be between 1 and " +
+                                            std::to_string(parallel_max_chunk_size));
+            }
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                _compressors.emplace_back(factory());
+                if (!_compressors.back())
+                {
+                    throw std::invalid_argument("Compressor factory returned null");
+                }
+            }
+        }
+
+        size_t compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            const size_t count = chunk_count(input_size, _chunk_size);
+            const size_t table_size = parallel_header_size + count * parallel_entry_size;
+            size_t chunk_bound(0);
+            size_t last_bound(0);
+            if (count > 0)
+            {
+                _compressors[0]->compress(input, _chunk_size, nullptr, chunk_bound);
+                _compressors[0]->compress(input, input_size - (count - 1) * _chunk_size, nullptr, last_bound);
+            }
+            const size_t bound = (count > 0) ? table_size + (count - 1) * chunk_bound + last_bound : table_size;
+            if (output == nullptr)
+            {
+                output_size = bound;
+                return 0;
+            }
+            if (output_size < table_size)
+            {
+                throw std::runtime_error("Insufficient output buffer size.");
+            }
+            if (output_size >= bound)
+            {
+                return compress_in_place(input, input_size, output, count, table_size, chunk_bound, last_bound);
+            }
+            return compress_scratch(input, input_size, output, output_size, count, table_size);
+        }
+
+    private:
+        /*
+         * Compress chunk i straight into its bound-sized slot of the output,
+         * then move the chunks down in order behind the table. Each chunk only
+         * moves towards the start of the output and never past the slot of the
+         * next chunk, so no chunk is overwritten before it is moved.
+         */
+        size_t compress_in_place(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t count,
+            size_t table_size,
+            size_t chunk_bound,
+            size_t last_bound)
+        {
+            _sizes.resize(count);
+            std::atomic<size_t> next(0);
+            _pool.run([&](size_t worker) {
+                compressor &backend = *_compressors[worker];
+                for (size_t i = next++; i < count; i = next++)
+                {
+                    const size_t offset = i * _chunk_size;
+                    size_t slot_size = (i + 1 < count) ? chunk_bound : last_bound;
+                    _sizes[i] = backend.compress(input + offset, std::min(_chunk_size, input_size - offset), output + table_size + i * chunk_bound, slot_size);
+                }
+            });
+
+            size_t compressed_size = table_size;
+            for (size_t i = 0; i < count; i++)
+            {
+                check_chunk_size(_sizes[i]);
+                if (compressed_size != table_size + i * chunk_bound)
+                {
+                    std::memmove(output + compressed_size, output + table_size + i * chunk_bound, _sizes[i]);
+                }
+                compressed_size += _sizes[i];
+            }
+            write_table(input_size, output, count);
+            return compressed_size;
+        }
+
+        /*
+         * Compress the chunks into scratch buffers and copy them into an output
+         * smaller than the bound once their sizes are known. The buffers are
+         * kept for the next call, so only callers that pass less than the bound
+         * hold them.
+         */
+        size_t compress_scratch(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size,
+            size_t count,
+            size_t table_size)
+        {
+            if (_chunks.size() < count)
+            {
+                _chunks.resize(count);
+            }
+            _sizes.resize(count);
+
+            std::atomic<size_t> next(0);
+            _pool.run([&](size_t worker) {
+                compressor &backend = *_compressors[worker];
+                for (size_t i = next++; i < count; i = next++)
+                {
+                    const size_t offset = i * _chunk_size;
+                    const size_t size = std::min(_chunk_size, input_size - offset);
+                    size_t bound(0);
+                    backend.compress(input + offset, size, nullptr, bound);
+                    std::vector<uint8_t> &chunk = _chunks[i];
+                    if (chunk.size() < bound)
+                    {
+                        chunk.resize(bound);
+                    }
+                    _sizes[i] = backend.compress(input + offset, size, chunk.data(), bound);
+                }
+            });
+
+            size_t compressed_size = table_size;
+            std::vector<size_t> offsets(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                check_chunk_size(_sizes[i]);
+                offsets[i] = compressed_size;
+                compressed_size += _sizes[i];
+            }
+            if (compressed_size > output_size)
+            {
+                throw std::runtime_error("Insufficient output buffer size.");
+            }
+
+            write_table(input_size, output, count);
+            next = 0;
+            _pool.run([&](size_t) {
+                for (size_t i = next++; i < count; i = next++)
+                {
+                    std::memcpy(output + offsets[i], _chunks[i].data(), _sizes[i]);
+                }
+            });
+            return compressed_size;
+        }
+
+        static void check_chunk_size(size_t size)
+        {
+            if (size > std::numeric_limits<uint32_t>::max())
+            {
+                throw std::runtime_error("Compressed chunk is too large");
+            }
+        }
+
+        void write_table(size_t input_size, uint8_t *output, size_t count) const
+        {
+            std::memcpy(output, parallel_magic, sizeof(parallel_magic));
+            output[4] = parallel_version;
+            std::memset(output + 5, 0, 3);
+            store_le<uint32_t>(output + 8, static_cast<uint32_t>(_chunk_size));
+            store_le<uint64_t>(output + 12, input_size);
+            for (size_t i = 0; i < count; i++)
+            {
+                store_le<uint32_t>(output + parallel_header_size + i * parallel_entry_size, static_cast<uint32_t>(_sizes[i]));
+            }
+        }
+
+        size_t _chunk_size;
+        worker_pool _pool;
+        std::vector<std::unique_ptr<compressor>> _compressors;
+        std::vector<std::vector<uint8_t>> _chunks;
+        std::vector<size_t> _sizes;
+    };
+
+    class parallel_decompressor : public decompressor
+    {
+    public:
+        parallel_decompressor(const decompressor_factory &factory, size_t thread_count) : _pool(thread_count), _chunk_size(0), _content_size(0)
+        {
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                _decompressors.emplace_back(factory());
+                if (!_decompressors.back())
+                {
+                    throw std::invalid_argument("Decompressor factory returned null");
+                }
+            }
+        }
+
+        std::optional<size_t> decompressed_size(
+            const uint8_t *input,
+            size_t input_size) override
+        {
+            if (input_size < parallel_header_size ||
+                std::memcmp(input, parallel_magic, sizeof(parallel_magic)) != 0 ||
+                input[4] != parallel_version ||
+                !trusted_size(load_le<uint64_t>(input + 12), input_size))
+            {
+                return std::nullopt;
+            }
+            return static_cast<size_t>(load_le<uint64_t>(input + 12));
+        }
+
+        size_t decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) override
+        {
+            const size_t count = parse(input, input_size);
+            if (output == nullptr || output_size < _content_size)
+            {
+                throw std::runtime_error("Insufficient output buffer size.");
+            }
+
+            std::atomic<size_t> next(0);
+            _pool.run([&](size_t worker) {
+                decompressor &backend = *_decompressors[worker];
+                for (size_t i = next++; i < count; i = next++)
+                {
+                    const size_t size = chunk_output_size(i);
+                    const size_t decompressed_size = backend.decompress(
+                        input + _offsets[i],
+                        _offsets[i + 1] - _offsets[i],
+                        output + i * _chunk_size,
+                        size);
+                    if (decompressed_size != size)
+                    {
+                        throw std::runtime_error("Parallel chunk size mismatch");
+                    }
+                }
+            });
+
+            return static_cast<size_t>(_content_size);
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            if (decompressed_size(input, input_size))
+            {
+                return decompressor::decompress_to(input, input_size, output);
+            }
+
+            // an untrusted content size is never allocated up front. Each round
+            // decodes one chunk per worker into a growing buffer and appends the
+            // chunks once their sizes are checked.
+            const size_t count = parse(input, input_size);
+            std::vector<std::vector<uint8_t>> chunks(_pool.size());
+            output.clear();
+            for (size_t first = 0; first < count; first += chunks.size())
+            {
+                const size_t last = std::min(count, first + chunks.size());
+                _pool.run([&](size_t worker) {
+                    const size_t i = first + worker;
+                    if (i < last)
+                    {
+                        _decompressors[worker]->decompress_to(input + _offsets[i], _offsets[i + 1] - _offsets[i], chunks[worker]);
+                        if (chunks[worker].size() != chunk_output_size(i))
+                        {
+                            throw std::runtime_error("Parallel chunk size mismatch");
+                        }
+                    }
+                });
+                for (size_t i = first; i < last; i++)
+                {
+                    output.insert(output.end(), chunks[i - first].begin(), chunks[i - first].end());
+                }
+            }
+            return output.size();
+        }
+
+    private:
+        /*
+         * Validate the header and chunk table and fill in the chunk offsets.
+         * Returns the number of chunks.
+         */
+        size_t parse(const uint8_t *input, size_t input_size)
+        {
+            if (input_size < parallel_header_size ||
+                std::memcmp(input, parallel_magic, sizeof(parallel_magic)) != 0 ||
+                input[4] != parallel_version)
+            {
+                throw std::runtime_error("Invalid parallel frame header");
+            }
+
+            _chunk_size = load_le<uint32_t>(input + 8);
+            _content_size = load_le<uint64_t>(input + 12);
+            if (!maxzip::in_range<size_t>(_chunk_size, 1, parallel_max_chunk_size) ||
+                _content_size > std::numeric_limits<size_t>::max() ||
+                (input_size - parallel_header_size) / parallel_entry_size < chunk_count(_content_size, _chunk_size))
+            {
+                throw std::runtime_error("Invalid parallel frame header");
+            }
+
+            const size_t count = chunk_count(_content_size, _chunk_size);
+            _offsets.resize(count + 1);
+            _offsets[0] = parallel_header_size + count * parallel_entry_size;
+            for (size_t i = 0; i < count; i++)
+            {
+                _offsets[i + 1] = _offsets[i] + load_le<uint32_t>(input + parallel_header_size + i * parallel_entry_size);
+                if (_offsets[i + 1] > input_size)
+                {
+                    throw std::runtime_error("Parallel frame is truncated");
+                }
+            }
+            return count;
+        }
+
+        size_t chunk_output_size(size_t index) const
+        {
+            return static_cast<size_t>(std::min<uint64_t>(_chunk_size, _content_size - index * _chunk_size));
+        }
+
+        worker_pool _pool;
+        std::vector<std::unique_ptr<decompressor>> _decompressors;
+        std::vector<size_t> _offsets;
+        size_t _chunk_size;
+        uint64_t _content_size;
+    };
+
+    class multiframe_decompressor : public decompressor
+    {
+    public:
+        multiframe_decompressor(const decompressor_factory &factory, size_t thread_count) : _pool(thread_count), _content_size(0)
+        {
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                _decompressors.emplace_back(factory());
+                if (!_decompressors.back())
+                {
+                    throw std::invalid_argument("Decompressor factory returned null");
+                }
+            }
+        }
+
+        std::optional<size_t> decompressed_size(
+            const uint8_t *input,
+            size_t input_size) override
+        {
+            if (!scan(input, input_size))
+            {
+                return std::nullopt;
+            }
+            return _content_size;
+        }
+
+        size_t decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) override
+        {
+            if (!scan(input, input_size) || _frames.size() < 2)
+            {
+                return _decompressors[0]->decompress(input, input_size, output, output_size);
+            }
+            if (output == nullptr || output_size < _content_size)
+            {
+                throw std::runtime_error("Insufficient output buffer size.");
+            }
+            return decompress_frames(input, output);
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            if (!scan(input, input_size) || _frames.size() < 2)
+            {
+                return _decompressors[0]->decompress_to(input, input_size, output);
+            }
+            output.resize(_content_size);
+            return decompress_frames(input, output.data());
+        }
+
+    private:
+        struct frame
+        {
+            size_t input_offset;
+            size_t input_size;
+            size_t output_offset;
+            size_t output_size;
+        };
+
+        size_t decompress_frames(const uint8_t *input, uint8_t *output)
+        {
+            std::atomic<size_t> next(0);
+            _pool.run([&](size_t worker) {
+                decompressor &backend = *_decompressors[worker];
+                for (size_t i = next++; i < _frames.size(); i = next++)
+                {
+                    const frame &frame = _frames[i];
+                    const size_t decompressed_size = backend.decompress(
+                        input + frame.input_offset,
+                        frame.input_size,
+                        output + frame.output_offset,
+                        frame.output_size);
+                    if (decompressed_size != frame.output_size)
+                    {
+                        throw std::runtime_error("Zstandard frame size mismatch");
+                    }
+                }
+            });
+
+            return _content_size;
+        }
+
+        /*
+         * Collect the data frames and their output offsets. Returns false if the
+         * input does not split into whole frames or a frame does not record a
+         * content size that it could expand to, which leaves the serial backend
+         * to decode or reject it.
+         */
+        bool scan(const uint8_t *input, size_t input_size)
+        {
+            _frames.clear();
+            _content_size = 0;
+            for (size_t offset = 0; offset < input_size;)
+            {
+                const size_t frame_size = ZSTD_findFrameCompressedSize(input + offset, input_size - offset);
+                if (ZSTD_isError(frame_size))
+                {
+                    return false;
+                }
+                if (!ZSTD_isSkippableFrame(input + offset, frame_size))
+                {
+                    const unsigned long long content_size = ZSTD_getFrameContentSize(input + offset, frame_size);
+                    if (content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size == ZSTD_CONTENTSIZE_ERROR ||
+                        !trusted_size(content_size, frame_size) ||
+                        content_size > std::numeric_limits<size_t>::max() - _content_size)
+                    {
+                        return false;
+                    }
+                    _frames.push_back({offset, frame_size, _content_size, static_cast<size_t>(content_size)});
+                    _content_size += static_cast<size_t>(content_size);
+                }
+                offset += frame_size;
+            }
+            return true;
+        }
+
+        worker_pool _pool;
+        std::vector<std::unique_ptr<decompressor>> _decompressors;
+        std::vector<frame> _frames;
+        size_t _content_size;
+    };
+
+    compressor *create_parallel_compressor(
+        const compressor_factory &factory,
+        const parallel_compressor_params &params)
+    {
+        std::unique_ptr<compressor> compressor = std::make_unique<parallel_compressor>(
+            factory,
+            params.chunk_size.value_or(parallel_default_chunk_size),
+            params.thread_count.value_or(default_thread_count()));
+        return compressor.release();
+    }
+
+    decompressor *create_parallel_decompressor(
+        const decompressor_factory &factory,
+        const parallel_decompressor_params &params)
+    {
+        std::unique_ptr<decompressor> decompressor = std::make_unique<parallel_decompressor>(
+            factory,
+            params.thread_count.value_or(default_thread_count()));
+        return decompressor.release();
+    }
+
+    decompressor *create_multiframe_decompressor(
+        const decompressor_factory &factory,
+        const parallel_decompressor_params &params)
+    {
+        std::unique_ptr<decompressor> decompressor = std::make_unique<multiframe_decompressor>(
+            factory,
+            params.thread_count.value_or(default_thread_count()));
+        return decompressor.release();
+    }
+}
@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <internal.hpp>
+
+#include <deque>
+#include <map>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace maxzip
+{
+    /*
+     * Stream layout (all integers little-endian):
+     *   magic        4 bytes  "MXZS"
+     *   version      1 byte
+     *   reserved     3 bytes
+     *   block_size   4 bytes
+     *   blocks       8-byte record header followed by the compressed block
+     *                  compressed_size    4 bytes
+     *                  decompressed_size  4 bytes
+     *   end          record header with both sizes 0
+     */
+    static constexpr uint8_t pipeline_magic[4] = {'M', 'X', 'Z', 'S'};
+    static constexpr uint8_t pipeline_version = 1;
+    static constexpr size_t pipeline_header_size = 12;
+    static constexpr size_t pipeline_record_size = 8;
+    static constexpr size_t pipeline_default_block_size = 1 << 20;
+    static constexpr size_t pipeline_max_block_size = 1 << 30;
+
+    struct pipeline_block
+    {
+        std::vector<uint8_t> input;
+        size_t input_size = 0;
+        std::vector<uint8_t> output;
+        size_t output_size = 0;
+        uint64_t sequence = 0;
+    };
+
+    static size_t read_fully(const read_function &read, uint8_t *buffer, size_t size)
+    {
+        size_t total(0);
+        while (total < size)
+        {
+            const size_t count = read(buffer + total, size - total);
+            if (count == 0)
+            {
+                break;
+            }
+            total += count;
+        }
+        return total;
+    }
+
+    /**
+     * @class pipeline_engine
+     * @brief Runs the reader, the workers and the writer on one worker pool.
+     * Derived classes define the stream format through the block hooks.
+     */
+    class pipeline_engine : public pipeline
+    {
+    public:
+        pipeline_engine(size_t thread_count, size_t queue_depth) : _pool(thread_count + 2), _blocks(queue_depth)
+        {
+        }
+
+        uint64_t run(const read_function &read, const write_function &write) override
+        {
+            uint64_t written(0);
+            const write_function counted = [&](const uint8_t *data, size_t size) {
+                write(data, size);
+                written += size;
+            };
+
+            start(read, counted);
+            _free.clear();
+            _work.clear();
+            _done.clear();
+            for (size_t i = 0; i < _blocks.size(); i++)
+            {
+                _free.push_back(i);
+            }
+            _read_count = 0;
+            _write_count = 0;
+            _end_of_input = false;
+            _failed = false;
+
+            _pool.run([&](size_t worker) {
+                try
+                {
+                    if (worker == 0)
+                    {
+                        writer(counted);
+                    }
+                    else if (worker == 1)
+                    {
+                        reader(read);
+                    }
+                    else
+                    {
+                        compute(worker - 2);
+                    }
+                }
+                catch (...)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _failed = true;
+                    }
+                    _changed.notify_all();
+                    throw;
+                }
+            });
+
+            finish(counted);
+            return written;
+        }
+
+    protected:
+        /**
+         * Called on the calling thread before any block is read
+         */
+        virtual void start(const read_function &read, const write_function &write) = 0;
+
+        /**
+         * Fill the input of a block. Returns false at the end of the stream.
+         */
+        virtual bool read_block(const read_function &read, pipeline_block &block) = 0;
+
+        /**
+         * Turn the input of a block into its output on the given worker
+         */
+        virtual void process_block(size_t worker, pipeline_block &block) = 0;
+
+        virtual void write_block(const write_function &write, const pipeline_block &block) = 0;
+
+        /**
+         * Called on the calling thread after every block has been written
+         */
+        virtual void finish(const write_function &write) = 0;
+
+    private:
+        void reader(const read_function &read)
+        {
+            while (true)
+            {
+                size_t index(0);
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _changed.wait(lock, [this]() { return _failed || !_free.empty(); });
+                    if (_failed)
+                    {
+                        return;
+                    }
+                    index = _free.front();
+                    _free.pop_front();
+                }
+
+                pipeline_block &block = _blocks[index];
+                const bool more = read_block(read, block);
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (more)
+                    {
+                        block.sequence = _read_count++;
+                        _work.push_back(index);
+                    }
+                    else
+                    {
+                        _free.push_back(index);
+                        _end_of_input = true;
+                    }
+                }
+                _changed.notify_all();
+                if (!more)
+                {
+                    return;
+                }
+            }
+        }
+
+        void compute(size_t worker)
+        {
+            while (true)
+            {
+                size_t index(0);
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _changed.wait(lock, [this]() { return _failed || !_work.empty() || _end_of_input; });
+                    if (_failed || _work.empty())
+                    {
+                        return;
+                    }
+                    index = _work.front();
+                    _work.pop_front();
+                }
+
+                pipeline_block &block = _blocks[index];
+                process_block(worker, block);
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _done.emplace(block.sequence, index);
+                }
+                _changed.notify_all();
+            }
+        }
+
+        void writer(const write_function &write)
+        {
+            while (true)
+            {
+                size_t index(0);
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _changed.wait(lock, [this]() {
+                        return _failed ||
+                               (!_done.empty() && _done.begin()->first == _write_count) ||
+                               (_end_of_input && _write_count == _read_count);
+                    });
+                    if (_failed || _done.empty() || _done.begin()->first != _write_count)
+                    {
+                        return;
+                    }
+                    index = _done.begin()->second;
+                    _done.erase(_done.begin());
+                }
+
+                write_block(write, _blocks[index]);
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _write_count++;
+                    _free.push_back(index);
+                }
+                _changed.notify_all();
+            }
+        }
+
+        worker_pool _pool;
+        std::vector<pipeline_block> _blocks;
+        std::mutex _mutex;
+        std::condition_variable _changed;
+        std::deque<size_t> _free;
+        std::deque<size_t> _work;
+        std::map<uint64_t, size_t> _done;
+        uint64_t _read_count;
+        uint64_t _write_count;
+        bool _end_of_input;
+        bool _failed;
+    };
+
+    class compression_pipeline : public pipeline_engine
+    {
+    public:
+        compression_pipeline(const compressor_factory &factory, size_t block_size, size_t thread_count, size_t queue_depth) : pipeline_engine(thread_count, queue_depth), _block_size(block_size)
+        {
+            if (!maxzip::in_range<size_t>(_block_size, 1, pipeline_max_block_size))
+            {
+                throw std::invalid_argument("Block size must be between 1 and " +
+                                            std::to_string(pipeline_max_block_size));
+            }
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                _compressors.emplace_back(factory());
+                if (!_compressors.back())
+                {
+                    throw std::invalid_argument("Compressor factory returned null");
+                }
+            }
+        }
+
+    protected:
+        void start(const read_function &, const write_function &write) override
+        {
+            uint8_t header[pipeline_header_size] = {};
+            std::memcpy(header, pipeline_magic, sizeof(pipeline_magic));
+            header[4] = pipeline_version;
+            store_le<uint32_t>(header + 8, static_cast<uint32_t>(_block_size));
+            write(header, sizeof(header));
+        }
+
+        bool read_block(const read_function &read, pipeline_block &block) override
+        {
+            if (block.input.size() < _block_size)
+            {
+                block.input.resize(_block_size);
+            }
+            block.input_size = read_fully(read, block.input.data(), _block_size);
+            return block.input_size > 0;
+        }
+
+        void process_block(size_t worker, pipeline_block &block) override
+        {
+            compressor &backend = *_compressors[worker];
+            size_t bound(0);
+            backend.compress(block.input.data(), block.input_size, nullptr, bound);
+            if (block.output.size() < pipeline_record_size + bound)
+            {
+                block.output.resize(pipeline_record_size + bound);
+            }
+            const size_t compressed_size = backend.compress(block.input.data(), block.input_size, block.output.data() + pipeline_record_size, bound);
+            if (compressed_size > std::numeric_limits<uint32_t>::max())
+            {
+                throw std::runtime_error("Compressed block is too large");
+            }
+            store_le<uint32_t>(block.output.data(), static_cast<uint32_t>(compressed_size));
+            store_le<uint32_t>(block.output.data() + 4, static_cast<uint32_t>(block.input_size));
+            block.output_size = pipeline_record_size + compressed_size;
+        }
+
+        void write_block(const write_function &write, const pipeline_block &block) override
+        {
+            write(block.output.data(), block.output_size);
+        }
+
+        void finish(const write_function &write) override
+        {
+            const uint8_t end[pipeline_record_size] = {};
+            write(end, sizeof(end));
+        }
+
+    private:
+        size_t _block_size;
+        std::vector<std::unique_ptr<compressor>> _compressors;
+    };
+
+    class decompression_pipeline : public pipeline_engine
+    {
+    public:
+        decompression_pipeline(const decompressor_factory &factory, size_t thread_count, size_t queue_depth) : pipeline_engine(thread_count, queue_depth), _block_size(0)
+        {
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                _decompressors.emplace_back(factory());
+                if (!_decompressors.back())
+                {
+                    throw std::invalid_argument("Decompressor factory returned null");
+                }
+            }
+        }
+
+    protected:
+        void start(const read_function &read, const write_function &) override
+        {
+            uint8_t header[pipeline_header_size];
+            if (read_fully(read, header, sizeof(header)) != sizeof(header) ||
+                std::memcmp(header, pipeline_magic, sizeof(pipeline_magic)) != 0 ||
+                header[4] != pipeline_version)
+            {
+                throw std::runtime_error("Invalid pipeline stream header");
+            }
+            _block_size = load_le<uint32_t>(header + 8);
+            if (!maxzip::in_range<size_t>(_block_size, 1, pipeline_max_block_size))
+            {
+                throw std::runtime_error("Invalid pipeline stream header");
+            }
+        }
+
+        bool read_block(const read_function &read, pipeline_block &block) override
+        {
+            uint8_t record[pipeline_record_size];
+            if (read_fully(read, record, sizeof(record)) != sizeof(record))
+            {
+                throw std::runtime_error("Pipeline stream is truncated");
+            }
+            const size_t compressed_size = load_le<uint32_t>(record);
+            const size_t decompressed_size = load_le<uint32_t>(record + 4);
+            if (compressed_size == 0 && decompressed_size == 0)
+            {
+                return false;
+            }
+            // no backend expands a block by half, so larger sizes are corrupt
+            if (decompressed_size > _block_size || compressed_size > _block_size + _block_size / 2 + 4096)
+            {
+                throw std::runtime_error("Invalid pipeline block size");
+            }
+            if (block.input.size() < compressed_size)
+            {
+                block.input.resize(compressed_size);
+            }
+            if (read_fully(read, block.input.data(), compressed_size) != compressed_size)
+            {
+                throw std::runtime_error("Pipeline stream is truncated");
+            }
+            block.input_size = compressed_size;
+            block.output_size = decompressed_size;
+            return true;
+        }
+
+        void process_block(size_t worker, pipeline_block &block) override
+        {
+            if (block.output.size() < block.output_size)
+            {
+                block.output.resize(block.output_size);
+            }
+            const size_t decompressed_size = _decompressors[worker]->decompress(block.input.data(), block.input_size, block.output.data(), block.output_size);
+            if (decompressed_size != block.output_size)
+            {
+                throw std::runtime_error("Pipeline block size mismatch");
+            }
+        }
+
+        void write_block(const write_function &write, const pipeline_block &block) override
+        {
+            write(block.output.data(), block.output_size);
+        }
+
+        void finish(const write_function &) override
+        {
+        }
+
+    private:
+        size_t _block_size;
+        std::vector<std::unique_ptr<decompressor>> _decompressors;
+    };
+
+    uint64_t pipeline::run(int input_fd, int output_fd)
+    {
+        return run(
+            [input_fd](uint8_t *buffer, size_t size) {
+                while (true)
+                {
+#if defined(_WIN32)
+                    const int count = ::_read(input_fd, buffer, static_cast<unsigned int>(std::min<size_t>(size, std::numeric_limits<int>::max())));
+#else
+                    const ssize_t count = ::read(input_fd, buffer, size);
+                    if (count < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+#endif
+                    if (count < 0)
+                    {
+                        throw std::runtime_error("Failed to read pipeline input");
+                    }
+                    return static_cast<size_t>(count);
+                }
+            },
+            [output_fd](const uint8_t *data, size_t size) {
+                while (size > 0)
+                {
+#if defined(_WIN32)
+                    const int count = ::_write(output_fd, data, static_cast<unsigned int>(std::min<size_t>(size, std::numeric_limits<int>::max())));
+#else
+                    const ssize_t count = ::write(output_fd, data, size);
+                    if (count < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+#endif
+                    if (count < 0)
+                    {
+                        throw std::runtime_error("Failed to write pipeline output");
+                    }
+                    data += count;
+                    size -= static_cast<size_t>(count);
+                }
+            });
+    }
+
+    static size_t pipeline_thread_count(const pipeline_params &params)
+    {
+        const size_t thread_count = params.thread_count.value_or(std::max<size_t>(1, std::thread::hardware_concurrency()));
+        if (thread_count == 0)
+        {
+            throw std::invalid_argument("Thread count must be greater than 0");
+        }
+        return thread_count;
+    }
+
+    static size_t pipeline_queue_depth(const pipeline_params &params, size_t thread_count)
+    {
+        // enough blocks for every worker plus one being read and one being written
+        const size_t queue_depth = params.queue_depth.value_or(2 * thread_count + 2);
+        if (queue_depth == 0)
+        {
+            throw std::invalid_argument("Queue depth must be greater than 0");
+        }
+        return queue_depth;
+    }
+
+    pipeline *create_compression_pipeline(
+        const compressor_factory &factory,
+        const pipeline_params &params)
+    {
+        const size_t thread_count = pipeline_thread_count(params);
+        return new compression_pipeline(
+            factory,
+            params.block_size.value_or(pipeline_default_block_size),
+            thread_count,
+            pipeline_queue_depth(params, thread_count));
+    }
+
+    pipeline *create_decompression_pipeline(
+        const decompressor_factory &factory,
+        const pipeline_params &params)
+    {
+        const size_t thread_count = pipeline_thread_count(params);
+        return new decompression_pipeline(
+            factory,
+            thread_count,
+            pipeline_queue_depth(params, thread_count));
+    }
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <internal.hpp>
+
+namespace maxzip
+{
+    static size_t default_pool_size()
+    {
+        return 2 * std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    static size_t thread_slot_hint()
+    {
+        static thread_local const size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+        return hint;
+    }
+
+    template <typename T>
+    context_pool<T>::lease::lease(context_pool *pool, T *object) : _pool(pool), _object(object)
+    {
+    }
+
+    template <typename T>
+    context_pool<T>::lease::lease(lease &&other) noexcept : _pool(other._pool), _object(other._object)
+    {
+        other._pool = nullptr;
+        other._object = nullptr;
+    }
+
+    template <typename T>
+    typename context_pool<T>::lease &context_pool<T>::lease::operator=(lease &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            _pool = other._pool;
+            _object = other._object;
+            other._pool = nullptr;
+            other._object = nullptr;
+        }
+        return *this;
+    }
+
+    template <typename T>
+    context_pool<T>::lease::~lease()
+    {
+        reset();
+    }
+
+    template <typename T>
+    void context_pool<T>::lease::reset()
+    {
+        if (_object != nullptr)
+        {
+            _pool->release(_object);
+            _object = nullptr;
+        }
+        _pool = nullptr;
+    }
+
+    template <typename T>
+    context_pool<T>::context_pool(factory factory, const context_pool_params &params) : _factory(std::move(factory))
+    {
+        if (!_factory)
+        {
+            throw std::invalid_argument("Invalid factory for context pool.");
+        }
+        _capacity = params.max_size.value_or(default_pool_size());
+        const size_t initial_size = params.initial_size.value_or(0);
+        if (_capacity == 0)
+        {
+            throw std::invalid_argument("Invalid maximum size for context pool.");
+        }
+        if (initial_size > _capacity)
+        {
+            throw std::invalid_argument("Invalid initial size for context pool.");
+        }
+        _slots.reset(new std::atomic<T *>[_capacity]);
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            _slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+        try
+        {
+            for (size_t i = 0; i < initial_size; i++)
+            {
+                std::unique_ptr<T> object(_factory());
+                if (!object)
+                {
+                    throw std::runtime_error("Failed to create pooled object.");
+                }
+                _slots[i].store(object.release(), std::memory_order_relaxed);
+            }
+        }
+        catch (...)
+        {
+            for (size_t i = 0; i < initial_size; i++)
+            {
+                delete _slots[i].load(std::memory_order_relaxed);
+            }
+            throw;
+        }
+    }
+
+    template <typename T>
+    context_pool<T>::~context_pool()
+    {
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            delete _slots[i].exchange(nullptr, std::memory_order_acquire);
+        }
+    }
+
+    template <typename T>
+    typename context_pool<T>::lease context_pool<T>::acquire()
+    {
+        const size_t start = thread_slot_hint() % _capacity;
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            std::atomic<T *> &slot = _slots[(start + i) % _capacity];
+            if (slot.load(std::memory_order_relaxed) != nullptr)
+            {
+                T *object = slot.exchange(nullptr, std::memory_order_acquire);
+                if (object != nullptr)
+                {
+                    return lease(this, object);
+                }
+            }
+        }
+        T *object = _factory();
+        if (object == nullptr)
+        {
+            throw std::runtime_error("Failed to create pooled object.");
+        }
+        return lease(this, object);
+    }
+
+    template <typename T>
+    void context_pool<T>::release(T *object)
+    {
+        const size_t start = thread_slot_hint() % _capacity;
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            std::atomic<T *> &slot = _slots[(start + i) % _capacity];
+            T *expected = nullptr;
+            if (slot.load(std::memory_order_relaxed) == nullptr &&
+                slot.compare_exchange_strong(expected, object, std::memory_order_release, std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+        delete object;
+    }
+
+    template <typename T>
+    size_t context_pool<T>::size() const
+    {
+        size_t count(0);
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            if (_slots[i].load(std::memory_order_relaxed) != nullptr)
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    template <typename T>
+    size_t context_pool<T>::capacity() const
+    {
+        return _capacity;
+    }
+
+    template class context_pool<compressor>;
+    template class context_pool<decompressor>;
+    template class context_pool<encoder>;
+    template class context_pool<decoder>;
+}
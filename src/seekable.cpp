@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <internal.hpp>
+
+namespace maxzip
+{
+    /*
+     * Seek table layout, following the zstd seekable format. The table is stored in
+     * a skippable frame after the compressed frames (all integers little-endian):
+     *   skippable magic  4 bytes  0x184D2A5E
+     *   frame size       4 bytes  size of the entries and footer
+     *   entries          8 bytes per frame (12 with checksums)
+     *     compressed size    4 bytes
+     *     decompressed size  4 bytes
+     *     checksum           4 bytes, only if the descriptor checksum flag is set
+     *   frame count      4 bytes
+     *   descriptor       1 byte
+     *   seekable magic   4 bytes  0x8F92EAB1
+     */
+    static constexpr uint32_t seekable_skippable_magic = 0x184D2A5E;
+    static constexpr uint32_t seekable_magic = 0x8F92EAB1;
+    static constexpr size_t seekable_skippable_header_size = 8;
+    static constexpr size_t seekable_footer_size = 9;
+    static constexpr size_t seekable_entry_size = 8;
+    static constexpr size_t seekable_checksum_entry_size = 12;
+    static constexpr uint8_t seekable_checksum_flag = 0x80;
+    static constexpr uint8_t seekable_reserved_mask = 0x7C;
+    static constexpr size_t seekable_default_frame_size = 1 << 16;
+    static constexpr size_t seekable_max_frame_size = 1 << 30;
+
+    static size_t seek_table_size(size_t frame_count)
+    {
+        return seekable_skippable_header_size + frame_count * seekable_entry_size + seekable_footer_size;
+    }
+
+    class seekable_compressor : public compressor
+    {
+    public:
+        seekable_compressor(const compressor_factory &factory, size_t frame_size) : _frame_size(frame_size), _compressor(factory())
+        {
+            if (!maxzip::in_range<size_t>(_frame_size, 1, seekable_max_frame_size))
+            {
+                throw std::invalid_argument("Frame size must be between 1 and " +
+                                            std::to_string(seekable_max_frame_size));
+            }
+            if (!_compressor)
+            {
+                throw std::invalid_argument("Compressor factory returned null");
+            }
+        }
+
+        size_t compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            const size_t frame_count = (input_size + _frame_size - 1) / _frame_size;
+            const size_t table_size = seek_table_size(frame_count);
+            size_t compressed_size(0);
+            if (frame_count > std::numeric_limits<uint32_t>::max())
+            {
+                throw std::invalid_argument("Too many frames for seek table");
+            }
+            if (output != nullptr)
+            {
+                if (output_size < table_size)
+                {
+                    throw std::runtime_error("Insufficient output buffer size.");
+                }
+                _entries.resize(frame_count);
+                for (size_t i = 0; i < frame_count; i++)
+                {
+                    const size_t offset = i * _frame_size;
+                    const size_t size = std::min(_frame_size, input_size - offset);
+                    size_t available = output_size - table_size - compressed_size;
+                    const size_t frame_size = _compressor->compress(input + offset, size, output + compressed_size, available);
+                    if (frame_size > std::numeric_limits<uint32_t>::max())
+                    {
+                        throw std::runtime_error("Compressed frame is too large");
+                    }
+                    _entries[i] = frame_size;
+                    compressed_size += frame_size;
+                }
+
+                uint8_t *table = output + compressed_size;
+                const size_t frame_table_size = table_size - seekable_skippable_header_size;
+                store_le<uint32_t>(table, seekable_skippable_magic);
+                store_le<uint32_t>(table + 4, static_cast<uint32_t>(frame_table_size));
+                table += seekable_skippable_header_size;
+                for (size_t i = 0; i < frame_count; i++)
+                {
+                    store_le<uint32_t>(table, static_cast<uint32_t>(_entries[i]));
+                    store_le<uint32_t>(table + 4, static_cast<uint32_t>(std::min(_frame_size, input_size - i * _frame_size)));
+                    table += seekable_entry_size;
+                }
+                store_le<uint32_t>(table, static_cast<uint32_t>(frame_count));
+                table[4] = 0;
+                store_le<uint32_t>(table + 5, seekable_magic);
+                compressed_size += table_size;
+            }
+            else
+            {
+                output_size = table_size;
+                if (frame_count > 0)
+                {
+                    const size_t last_size = input_size - (frame_count - 1) * _frame_size;
+                    size_t bound(0);
+                    _compressor->compress(input, _frame_size, nullptr, bound);
+                    output_size += (frame_count - 1) * bound;
+                    _compressor->compress(input, last_size, nullptr, bound);
+                    output_size += bound;
+                }
+            }
+            return compressed_size;
+        }
+
+    private:
+        size_t _frame_size;
+        std::unique_ptr<compressor> _compressor;
+        std::vector<size_t> _entries;
+    };
+
+    class seekable_decompressor_impl : public seekable_decompressor
+    {
+    public:
+        seekable_decompressor_impl(const decompressor_factory &factory) : _decompressor(factory()), _input(nullptr), _cached_frame(0), _cached(false), _trusted(true)
+        {
+            if (!_decompressor)
+            {
+                throw std::invalid_argument("Decompressor factory returned null");
+            }
+            // offsets always hold one more entry than the frame count
+            _compressed_offsets.push_back(0);
+            _decompressed_offsets.push_back(0);
+        }
+
+        void load(const uint8_t *input, size_t input_size) override
+        {
+            if (input_size < seekable_skippable_header_size + seekable_footer_size)
+            {
+                throw std::runtime_error("Seekable input is too small");
+            }
+            const uint8_t *footer = input + input_size - seekable_footer_size;
+            const size_t frame_count = load_le<uint32_t>(footer);
+            const uint8_t descriptor = footer[4];
+            if (load_le<uint32_t>(footer + 5) != seekable_magic || (descriptor & seekable_reserved_mask) != 0)
+            {
+                throw std::runtime_error("Invalid seek table footer");
+            }
+
+            const size_t entry_size = (descriptor & seekable_checksum_flag) ? seekable_checksum_entry_size : seekable_entry_size;
+            const size_t available = input_size - seekable_skippable_header_size - seekable_footer_size;
+            if (frame_count > available / entry_size)
+            {
+                throw std::runtime_error("Seek table is truncated");
+            }
+            const size_t frame_table_size = frame_count * entry_size + seekable_footer_size;
+            const uint8_t *header = input + input_size - frame_table_size - seekable_skippable_header_size;
+            if (load_le<uint32_t>(header) != seekable_skippable_magic || load_le<uint32_t>(header + 4) != frame_table_size)
+            {
+                throw std::runtime_error("Invalid seek table header");
+            }
+
+            const size_t data_size = static_cast<size_t>(header - input);
+            const uint8_t *entry = header + seekable_skippable_header_size;
+            std::vector<size_t> compressed_offsets(frame_count + 1, 0);
+            std::vector<size_t> decompressed_offsets(frame_count + 1, 0);
+            bool trusted(true);
+            for (size_t i = 0; i < frame_count; i++)
+            {
+                const size_t compressed_size = load_le<uint32_t>(entry);
+                const size_t decompressed_size = load_le<uint32_t>(entry + 4);
+                compressed_offsets[i + 1] = compressed_offsets[i] + compressed_size;
+                decompressed_offsets[i + 1] = decompressed_offsets[i] + decompressed_size;
+                trusted = trusted && trusted_size(decompressed_size, compressed_size);
+                entry += entry_size;
+            }
+            if (compressed_offsets.back() != data_size)
+            {
+                throw std::runtime_error("Seek table does not match input size");
+            }
+            _compressed_offsets.swap(compressed_offsets);
+            _decompressed_offsets.swap(decompressed_offsets);
+            _input = input;
+            _trusted = trusted;
+            _cached = false;
+        }
+
+        size_t size() const override
+        {
+            return _decompressed_offsets.back();
+        }
+
+        size_t read(size_t offset, size_t length, uint8_t *output) override
+        {
+            if (offset > size())
+            {
+                throw std::out_of_range("Read offset is past the end of the data");
+            }
+            length = std::min(length, size() - offset);
+
+            size_t written(0);
+            size_t frame = static_cast<size_t>(std::upper_bound(_decompressed_offsets.begin(), _decompressed_offsets.end(), offset) - _decompressed_offsets.begin()) - 1;
+            while (written < length)
+            {
+                const size_t frame_start = _decompressed_offsets[frame];
+                const size_t frame_size = _decompressed_offsets[frame + 1] - frame_start;
+                const size_t position = offset + written;
+                const size_t count = std::min(length - written, frame_start + frame_size - position);
+                if (position == frame_start && count == frame_size)
+                {
+                    decode(frame, output + written);
+                }
+                else
+                {
+                    // partially covered frames are decoded once and kept for the next read
+                    cache(frame);
+                    std::memcpy(output + written, _frame.data() + (position - frame_start), count);
+                }
+                written += count;
+                frame++;
+            }
+            return written;
+        }
+
+        size_t decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) override
+        {
+            load(input, input_size);
+            if (output == nullptr || output_size < size())
+            {
+                throw std::runtime_error("Insufficient output buffer size.");
+            }
+            return read(0, size(), output);
+        }
+
+        std::optional<size_t> decompressed_size(
+            const uint8_t *input,
+            size_t input_size) override
+        {
+            load(input, input_size);
+            if (!_trusted)
+            {
+                return std::nullopt;
+            }
+            return size();
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            load(input, input_size);
+            if (_trusted)
+            {
+                output.resize(size());
+                return read(0, size(), output.data());
+            }
+
+            // frames claiming more than their data can hold are appended one at a
+            // time, so memory follows the data actually decoded
+            output.clear();
+            for (size_t frame = 0; frame + 1 < _decompressed_offsets.size(); frame++)
+            {
+                cache(frame);
+                output.insert(output.end(), _frame.begin(), _frame.end());
+            }
+            return output.size();
+        }
+
+    private:
+        /*
+         * Decode a frame into the cache. The backend sizes the buffer, so a
+         * frame size taken from the seek table is checked before it is trusted.
+         */
+        void cache(size_t frame)
+        {
+            if (_cached && _cached_frame == frame)
+            {
+                return;
+            }
+            _cached = false;
+            _decompressor->decompress_to(
+                _input + _compressed_offsets[frame],
+                _compressed_offsets[frame + 1] - _compressed_offsets[frame],
+                _frame);
+            if (_frame.size() != _decompressed_offsets[frame + 1] - _decompressed_offsets[frame])
+            {
+                throw std::runtime_error("Seekable frame size mismatch");
+            }
+            _cached_frame = frame;
+            _cached = true;
+        }
+
+        void decode(size_t frame, uint8_t *output)
+        {
+            const size_t frame_size = _decompressed_offsets[frame + 1] - _decompressed_offsets[frame];
+            const size_t decompressed_size = _decompressor->decompress(
+                _input + _compressed_offsets[frame],
+                _compressed_offsets[frame + 1] - _compressed_offsets[frame],
+                output,
+                frame_size);
+            if (decompressed_size != frame_size)
+            {
+                throw std::runtime_error("Seekable frame size mismatch");
+            }
+        }
+
+        std::unique_ptr<decompressor> _decompressor;
+        const uint8_t *_input;
+        std::vector<size_t> _compressed_offsets;
+        std::vector<size_t> _decompressed_offsets;
+        std::vector<uint8_t> _frame;
+        size_t _cached_frame;
+        bool _cached;
+        bool _trusted;
+    };
+
+    compressor *create_seekable_compressor(
+        const compressor_factory &factory,
+        const seekable_compressor_params &params)
+    {
+        std::unique_ptr<compressor> compressor = std::make_unique<seekable_compressor>(
+            factory,
+            params.frame_size.value_or(seekable_default_frame_size));
+        return compressor.release();
+    }
+
+    seekable_decompressor *create_seekable_decompressor(
+        const decompressor_factory &factory)
+    {
+        return new seekable_decompressor_impl(factory);
+    }
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <internal.hpp>
+
+#include <array>
+
+namespace maxzip
+{
+    static constexpr uint32_t zstd_frame_magic = 0xFD2FB528;
+    static constexpr uint32_t zstd_skippable_magic = 0x184D2A50;
+    static constexpr uint32_t zstd_skippable_mask = 0xFFFFFFF0;
+
+    void codec_registry::add(codec type, compressor_factory compressor_factory, decompressor_factory decompressor_factory)
+    {
+        if (!compressor_factory || !decompressor_factory)
+        {
+            throw std::invalid_argument("Codec factories must not be empty");
+        }
+        if ((static_cast<uint8_t>(type) & envelope_mask) != 0 || type == codec::stored)
+        {
+            throw std::invalid_argument("Codec must be between 1 and 15");
+        }
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _factories[type] = {std::move(compressor_factory), std::move(decompressor_factory)};
+    }
+
+    void codec_registry::erase(codec type)
+    {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _factories.erase(type);
+    }
+
+    bool codec_registry::contains(codec type) const
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _factories.find(type) != _factories.end();
+    }
+
+    compressor *codec_registry::create_compressor(codec type) const
+    {
+        return find(type).compressor();
+    }
+
+    decompressor *codec_registry::create_decompressor(codec type) const
+    {
+        return find(type).decompressor();
+    }
+
+    codec_registry::factories codec_registry::find(codec type) const
+    {
+        // the factories are copied so that they run without holding the lock
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        const auto it = _factories.find(type);
+        if (it == _factories.end())
+        {
+            throw std::invalid_argument("Codec " + std::to_string(static_cast<int>(type)) + " is not registered");
+        }
+        return it->second;
+    }
+
+    std::shared_ptr<codec_registry> default_codec_registry()
+    {
+        static const std::shared_ptr<codec_registry> registry = []() {
+            std::shared_ptr<codec_registry> registry = std::make_shared<codec_registry>();
+            registry->add(
+                codec::brotli,
+                []() { return create_brotli_compressor(); },
+                []() { return create_brotli_decompressor(); });
+            registry->add(
+                codec::zlib,
+                []() { return create_zlib_compressor(); },
+                []() {
+                    zlib_decompressor_params params;
+                    // automatic zlib or gzip header detection
+                    params.window_bits = 15 + 32;
+                    return create_zlib_decompressor(params);
+                });
+            registry->add(
+                codec::zstd,
+                []() { return create_zstd_compressor(); },
+                []() { return create_zstd_decompressor(); });
+            registry->add(
+                codec::lz4,
+                []() { return create_lz4_compressor(); },
+                []() { return create_lz4_decompressor(); });
+            return registry;
+        }();
+        return registry;
+    }
+
+    std::optional<format_detection> detect_format(const uint8_t *input, size_t input_size) noexcept
+    {
+        if (input_size < 1)
+        {
+            return std::nullopt;
+        }
+        if ((input[0] & envelope_mask) == envelope_tag)
+        {
+            return format_detection{static_cast<codec>(input[0] & ~envelope_mask), 1};
+        }
+        if (input_size >= 4)
+        {
+            const uint32_t magic = load_le<uint32_t>(input);
+            if (magic == zstd_frame_magic || (magic & zstd_skippable_mask) == zstd_skippable_magic)
+            {
+                return format_detection{codec::zstd, 0};
+            }
+        }
+        if (input_size >= 3 && input[0] == 0x1F && input[1] == 0x8B && input[2] == Z_DEFLATED)
+        {
+            return format_detection{codec::zlib, 0};
+        }
+        // deflate with a window of at most 32K, and a header check that is a
+        // multiple of 31
+        if (input_size >= 2 && (input[0] & 0x0F) == Z_DEFLATED && (input[0] >> 4) <= 7 && ((input[0] << 8) | input[1]) % 31 == 0)
+        {
+            return format_detection{codec::zlib, 0};
+        }
+        return std::nullopt;
+    }
+
+    class enveloped_compressor final : public compressor
+    {
+    public:
+        enveloped_compressor(codec type, std::unique_ptr<compressor> backend) : _envelope(envelope_byte(type)), _backend(std::move(backend))
+        {
+            if (!_backend)
+            {
+                throw std::invalid_argument("Compressor must not be null");
+            }
+        }
+
+        size_t compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            if (output == nullptr)
+            {
+                _backend->compress(input, input_size, nullptr, output_size);
+                output_size += 1;
+                return 0;
+            }
+            if (output_size < 1)
+            {
+                throw std::runtime_error("Insufficient output buffer size.");
+            }
+            size_t backend_size(output_size - 1);
+            const size_t compressed_size = _backend->compress(input, input_size, output + 1, backend_size);
+            output[0] = _envelope;
+            return compressed_size + 1;
+        }
+
+        codec_result try_compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            codec_result result = _backend->try_compress(input, input_size, output + (output_size > 0 ? 1 : 0), (output_size > 0) ? output_size - 1 : 0);
+            if (result.status == status::ok || result.status == status::insufficient_output)
+            {
+                result.size += 1;
+            }
+            if (result && output_size > 0)
+            {
+                output[0] = _envelope;
+            }
+            return result;
+        }
+
+    private:
+        uint8_t _envelope;
+        std::unique_ptr<compressor> _backend;
+    };
+
+    class universal_decompressor final : public decompressor
+    {
+    public:
+        universal_decompressor(std::shared_ptr<codec_registry> registry) : _registry(std::move(registry))
+        {
+            if (!_registry)
+            {
+                _registry = default_codec_registry();
+            }
+        }
+
+        size_t decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) override
+        {
+            const format_detection format = detect(input, input_size);
+            const size_t size = input_size - format.header_size;
+            if (format.codec == codec::stored)
+            {
+                if (size > output_size)
+                {
+                    throw std::runtime_error("Insufficient output buffer size.");
+                }
+                std::copy(input + 1, input + input_size, output);
+                return size;
+            }
+            return backend(format.codec).decompress(input + format.header_size, size, output, output_size);
+        }
+
+        codec_result try_decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            const std::optional<format_detection> format = detect_format(input, input_size);
+            if (!format)
+            {
+                return {status::corrupt_input, 0};
+            }
+            const size_t size = input_size - format->header_size;
+            if (format->codec == codec::stored)
+            {
+                if (size > output_size)
+                {
+                    return {status::insufficient_output, size};
+                }
+                std::copy(input + 1, input + input_size, output);
+                return {status::ok, size};
+            }
+            decompressor *decompressor(nullptr);
+            try
+            {
+                decompressor = &backend(format->codec);
+            }
+            catch (...)
+            {
+                return {status::failed, 0};
+            }
+            return decompressor->try_decompress(input + format->header_size, size, output, output_size);
+        }
+
+        std::optional<size_t> decompressed_size(
+            const uint8_t *input,
+            size_t input_size) override
+        {
+            const std::optional<format_detection> format = detect_format(input, input_size);
+            if (!format)
+            {
+                return std::nullopt;
+            }
+            const size_t size = input_size - format->header_size;
+            if (format->codec == codec::stored)
+            {
+                return size;
+            }
+            return backend(format->codec).decompressed_size(input + format->header_size, size);
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            const format_detection format = detect(input, input_size);
+            if (format.codec == codec::stored)
+            {
+                output.assign(input + 1, input + input_size);
+                return output.size();
+            }
+            return backend(format.codec).decompress_to(input + format.header_size, input_size - format.header_size, output);
+        }
+
+    private:
+        static format_detection detect(const uint8_t *input, size_t input_size)
+        {
+            const std::optional<format_detection> format = detect_format(input, input_size);
+            if (!format)
+            {
+                throw std::runtime_error("Unrecognized compression format.");
+            }
+            return *format;
+        }
+
+        decompressor &backend(codec type)
+        {
+            std::unique_ptr<decompressor> &backend = _backends[static_cast<size_t>(type) & ~envelope_mask];
+            if (!backend)
+            {
+                backend.reset(_registry->create_decompressor(type));
+            }
+            return *backend;
+        }
+
+        std::shared_ptr<codec_registry> _registry;
+        std::array<std::unique_ptr<decompressor>, 16> _backends;
+    };
+
+    compressor *create_enveloped_compressor(codec type, compressor *compressor)
+    {
+        std::unique_ptr<maxzip::compressor> backend(compressor);
+        if ((static_cast<uint8_t>(type) & envelope_mask) != 0 || type == codec::stored)
+        {
+            throw std::invalid_argument("Codec must be between 1 and 15");
+        }
+        return new enveloped_compressor(type, std::move(backend));
+    }
+
+    decompressor *create_universal_decompressor(const universal_decompressor_params &params)
+    {
+        return new universal_decompressor(params.registry);
+    }
+}
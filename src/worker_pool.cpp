@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2025 Maxtek Consulting
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <internal.hpp>
+
+namespace maxzip
+{
+    worker_pool::worker_pool(size_t size) : _task(nullptr), _generation(0), _active(0), _stopping(false)
+    {
+        if (size == 0)
+        {
+            throw std::invalid_argument("Worker pool size must be greater than 0");
+        }
+        _threads.reserve(size - 1);
+        for (size_t index = 1; index < size; index++)
+        {
+            _threads.emplace_back(&worker_pool::worker_loop, this, index);
+        }
+    }
+
+    worker_pool::~worker_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _start.notify_all();
+        for (std::thread &thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    size_t worker_pool::size() const
+    {
+        return _threads.size() + 1;
+    }
+
+    void worker_pool::run(const std::function<void(size_t)> &task)
+    {
+        std::lock_guard<std::mutex> run_lock(_run_mutex);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task = &task;
+            _error = nullptr;
+            _active = _threads.size();
+            _generation++;
+        }
+        _start.notify_all();
+
+        std::exception_ptr error;
+        try
+        {
+            task(0);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this]() { return _active == 0; });
+        _task = nullptr;
+        if (!error)
+        {
+            error = _error;
+        }
+        lock.unlock();
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void worker_pool::worker_loop(size_t index)
+    {
+        uint64_t generation(0);
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true)
+        {
+            _start.wait(lock, [&]() { return _stopping || _generation != generation; });
+            if (_stopping)
+            {
+                break;
+            }
+            generation = _generation;
+            const std::function<void(size_t)> *task = _task;
+            lock.unlock();
+
+            std::exception_ptr error;
+            try
+            {
+                (*task)(index);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            if (error && !_error)
+            {
+                _error = error;
+            }
+            if (--_active == 0)
+            {
+                _done.notify_one();
+            }
+        }
+    }
+}
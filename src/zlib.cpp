@@ -22,23 +22,225 @@
 
 #include <internal.hpp>
 
+// the unit tests lower the chunk size so that small buffers take the path of
+// buffers over 4 GiB
+#ifndef MAXZIP_ZLIB_MAX_CHUNK
+#define MAXZIP_ZLIB_MAX_CHUNK std::numeric_limits<uInt>::max()
+#endif
+
 namespace maxzip
 {
-    class zlib_compressor : public compressor
+#ifdef MAXZIP_ZLIB_NG
+    /*
+     * zlib-ng in native mode prefixes its API with zng_ and uses fixed-width
+     * types. The zlib names used in this file are mapped onto it here, so the
+     * backend is the same code for both libraries and writes the same formats.
+     */
+    using z_stream = zng_stream;
+    using uInt = uint32_t;
+    using uLong = unsigned long;
+    using Bytef = uint8_t;
+    using voidpf = void *;
+
+    static int deflateInit2(z_stream *stream, int level, int method, int window_bits, int mem_level, int strategy)
+    {
+        return zng_deflateInit2(stream, level, method, window_bits, mem_level, strategy);
+    }
+
+    static int deflate(z_stream *stream, int flush)
+    {
+        return zng_deflate(stream, flush);
+    }
+
+    static int deflateEnd(z_stream *stream)
+    {
+        return zng_deflateEnd(stream);
+    }
+
+    static int deflateReset(z_stream *stream)
+    {
+        return zng_deflateReset(stream);
+    }
+
+    static int deflateSetDictionary(z_stream *stream, const uint8_t *dictionary, uInt size)
+    {
+        return zng_deflateSetDictionary(stream, dictionary, size);
+    }
+
+    static uLong deflateBound(z_stream *stream, uLong size)
+    {
+        return zng_deflateBound(stream, size);
+    }
+
+    static int inflateInit2(z_stream *stream, int window_bits)
+    {
+        return zng_inflateInit2(stream, window_bits);
+    }
+
+    static int inflate(z_stream *stream, int flush)
+    {
+        return zng_inflate(stream, flush);
+    }
+
+    static int inflateEnd(z_stream *stream)
+    {
+        return zng_inflateEnd(stream);
+    }
+
+    static int inflateReset(z_stream *stream)
+    {
+        return zng_inflateReset(stream);
+    }
+
+    static int inflateSetDictionary(z_stream *stream, const uint8_t *dictionary, uInt size)
+    {
+        return zng_inflateSetDictionary(stream, dictionary, size);
+    }
+#endif
+
+    /**
+     * Run a deflate or inflate function over buffers that may exceed the range of
+     * uInt. On return, input_size and output_size hold the number of bytes consumed
+     * and produced.
+     */
+    template <typename Function>
+    static int zlib_process(
+        z_stream &stream,
+        Function function,
+        int flush,
+        const uint8_t *input,
+        size_t &input_size,
+        uint8_t *output,
+        size_t &output_size)
+    {
+        constexpr size_t max_chunk = MAXZIP_ZLIB_MAX_CHUNK;
+        size_t consumed(0);
+        size_t produced(0);
+        int ret(Z_OK);
+        bool pending(true);
+        while (pending)
+        {
+            const size_t input_chunk = std::min(input_size - consumed, max_chunk);
+            const size_t output_chunk = std::min(output_size - produced, max_chunk);
+            const bool last_chunk = (consumed + input_chunk == input_size);
+            stream.next_in = const_cast<Bytef *>(input + consumed);
+            stream.avail_in = static_cast<uInt>(input_chunk);
+            stream.next_out = reinterpret_cast<Bytef *>(output + produced);
+            stream.avail_out = static_cast<uInt>(output_chunk);
+            ret = function(&stream, last_chunk ? flush : Z_NO_FLUSH);
+            const size_t step_in = input_chunk - stream.avail_in;
+            const size_t step_out = output_chunk - stream.avail_out;
+            consumed += step_in;
+            produced += step_out;
+            // inflate reports Z_BUF_ERROR when Z_FINISH runs out of output space
+            pending = (ret == Z_OK || ret == Z_BUF_ERROR) &&
+                      (step_in > 0 || step_out > 0) &&
+                      (produced < output_size) &&
+                      (consumed < input_size || flush != Z_NO_FLUSH);
+        }
+        input_size = consumed;
+        output_size = produced;
+        return ret;
+    }
+
+    /**
+     * Run a step with the signature of zlib_process across lists of buffers,
+     * passing the flush mode only with the last input buffer. On return, the
+     * cursors have advanced past the bytes consumed and produced.
+     */
+    template <typename Step>
+    static int zlib_process_vectored(
+        buffer_cursor<input_buffer> &input,
+        buffer_cursor<output_buffer> &output,
+        int flush,
+        Step step)
+    {
+        int ret(Z_OK);
+        bool pending(true);
+        while (pending)
+        {
+            size_t step_in = input.available();
+            size_t step_out = output.available();
+            const bool last_buffer = (step_in == input.remaining());
+            ret = step(input.data(), step_in, output.data(), step_out, last_buffer ? flush : Z_NO_FLUSH);
+            input.advance(step_in);
+            output.advance(step_out);
+            pending = (ret == Z_OK || ret == Z_BUF_ERROR) &&
+                      (step_in > 0 || step_out > 0) &&
+                      (output.remaining() > 0) &&
+                      (input.remaining() > 0 || flush != Z_NO_FLUSH);
+        }
+        return ret;
+    }
+
+    static voidpf zlib_allocate(voidpf opaque, uInt items, uInt size)
+    {
+        return static_cast<allocator *>(opaque)->allocate(static_cast<size_t>(items) * size);
+    }
+
+    static void zlib_deallocate(voidpf opaque, voidpf address)
+    {
+        static_cast<allocator *>(opaque)->deallocate(address);
+    }
+
+    static z_stream zlib_stream(allocator *allocator)
+    {
+        z_stream stream = {};
+        stream.zalloc = (allocator != nullptr) ? zlib_allocate : Z_NULL;
+        stream.zfree = (allocator != nullptr) ? zlib_deallocate : Z_NULL;
+        stream.opaque = allocator;
+        return stream;
+    }
+
+    template <typename Function>
+    static void zlib_set_dictionary(z_stream &stream, Function function, const std::shared_ptr<dictionary> &dictionary)
+    {
+        if (dictionary)
+        {
+            const size_t size = std::min<size_t>(dictionary->size(), std::numeric_limits<uInt>::max());
+            if (function(&stream, dictionary->data(), static_cast<uInt>(size)) != Z_OK)
+            {
+                throw std::runtime_error("Failed to set zlib dictionary");
+            }
+        }
+    }
+
+    /**
+     * Upper bound on the deflated size of input_size bytes. deflateBound takes a
+     * uLong, which is 32 bits on some platforms, so larger inputs are bounded
+     * piecewise. The pieces overstate the stream overhead slightly, which is
+     * harmless for a bound.
+     */
+    static size_t zlib_bound(z_stream &stream, size_t input_size)
+    {
+        constexpr size_t max_chunk = std::numeric_limits<uLong>::max() >> 2;
+        size_t bound(0);
+        do
+        {
+            const size_t chunk = std::min(input_size, max_chunk);
+            bound += deflateBound(&stream, static_cast<uLong>(chunk));
+            input_size -= chunk;
+        } while (input_size > 0);
+        return bound;
+    }
+
+    class zlib_compressor final : public compressor
     {
     public:
-        zlib_compressor(int level, int window_bits, int mem_level, int strategy)
+        zlib_compressor(int level, int window_bits, int mem_level, int strategy, std::shared_ptr<allocator> allocator, std::shared_ptr<dictionary> dictionary) : _allocator(std::move(allocator)), _dictionary(std::move(dictionary))
         {
-            _stream = {};
-            _stream.zalloc = Z_NULL;
-            _stream.zfree = Z_NULL;
-            _stream.opaque = Z_NULL;
+            _stream = zlib_stream(_allocator.get());
 
             int ret = deflateInit2(&_stream, level, Z_DEFLATED, window_bits, mem_level, strategy);
             if (ret != Z_OK)
             {
                 throw std::runtime_error("Failed to initialize zlib compressor");
             }
+            if (_dictionary && window_bits > 15)
+            {
+                deflateEnd(&_stream);
+                throw std::invalid_argument("Zlib dictionaries are not supported with gzip");
+            }
         }
 
         ~zlib_compressor()
@@ -53,40 +255,114 @@ namespace maxzip
             size_t &output_size)
         {
             size_t compressed_size(0);
-            deflateReset(&_stream);
-            _stream.avail_in = static_cast<uInt>(input_size);
             if (output != nullptr)
             {
-                _stream.next_in = const_cast<Bytef *>(input);
-                _stream.next_out = reinterpret_cast<Bytef *>(output);
-                _stream.avail_out = static_cast<uInt>(output_size);
-                int ret = deflate(&_stream, Z_FINISH);
-                if (ret != Z_STREAM_END)
+                const codec_result result = try_compress(input, input_size, output, output_size);
+                if (!result)
                 {
-                    throw std::runtime_error("Zlib compression failed");
+                    throw_result(result, "Zlib compression");
                 }
-                compressed_size = output_size - _stream.avail_out;
+                compressed_size = result.size;
             }
             else
             {
-                output_size = deflateBound(&_stream, input_size);
+                output_size = zlib_bound(_stream, input_size);
             }
             return compressed_size;
         }
 
+        codec_result try_compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            try
+            {
+                deflateReset(&_stream);
+                zlib_set_dictionary(_stream, deflateSetDictionary, _dictionary);
+                size_t compressed_size(output_size);
+                const int ret = zlib_process(_stream, deflate, Z_FINISH, input, input_size, output, compressed_size);
+                if (ret == Z_STREAM_END)
+                {
+                    return {status::ok, compressed_size};
+                }
+                if ((ret == Z_OK || ret == Z_BUF_ERROR) && compressed_size == output_size)
+                {
+                    return {status::insufficient_output, zlib_bound(_stream, input_size)};
+                }
+                return {status::failed, 0};
+            }
+            catch (...)
+            {
+                return {status::failed, 0};
+            }
+        }
+
+        size_t compress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            return maxzip::compress_batch(
+                inputs,
+                input_count,
+                output,
+                entries,
+                [this](const input_buffer &input) { return zlib_bound(_stream, input.size); },
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                    return compress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t compress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            return maxzip::compress_to(
+                input,
+                input_size,
+                output,
+                [this](const input_buffer &input) { return zlib_bound(_stream, input.size); },
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                    return compress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t compressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count) override
+        {
+            deflateReset(&_stream);
+            zlib_set_dictionary(_stream, deflateSetDictionary, _dictionary);
+            buffer_cursor<input_buffer> input(inputs, input_count);
+            buffer_cursor<output_buffer> output(outputs, output_count);
+            const int ret = zlib_process_vectored(input, output, Z_FINISH, [this](const uint8_t *input, size_t &input_size, uint8_t *output, size_t &output_size, int flush) {
+                return zlib_process(_stream, deflate, flush, input, input_size, output, output_size);
+            });
+            if (ret != Z_STREAM_END)
+            {
+                throw_result({(output.remaining() == 0) ? status::insufficient_output : status::failed, 0}, "Zlib compression");
+            }
+            return output.position();
+        }
+
     private:
+        std::shared_ptr<allocator> _allocator;
+        std::shared_ptr<dictionary> _dictionary;
         z_stream _stream;
     };
 
-    class zlib_decompressor : public decompressor
+    class zlib_decompressor final : public decompressor
     {
     public:
-        zlib_decompressor(int window_bits)
+        zlib_decompressor(int window_bits, std::shared_ptr<allocator> allocator, std::shared_ptr<dictionary> dictionary) : _allocator(std::move(allocator)), _dictionary(std::move(dictionary)), _window_bits(window_bits)
         {
-            _stream = {};
-            _stream.zalloc = Z_NULL;
-            _stream.zfree = Z_NULL;
-            _stream.opaque = Z_NULL;
+            _stream = zlib_stream(_allocator.get());
             int ret = inflateInit2(&_stream, window_bits);
             if (ret != Z_OK)
             {
@@ -104,25 +380,318 @@ namespace maxzip
             size_t input_size,
             uint8_t *output,
             size_t output_size) override
+        {
+            const codec_result result = try_decompress(input, input_size, output, output_size);
+            if (!result)
+            {
+                throw_result(result, "Zlib decompression");
+            }
+            return result.size;
+        }
+
+        codec_result try_decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            try
+            {
+                reset();
+                size_t decompressed_size(output_size);
+                const int ret = process(input, input_size, output, decompressed_size, Z_FINISH);
+                if (ret == Z_STREAM_END)
+                {
+                    return {status::ok, decompressed_size};
+                }
+                // input before the last uInt-sized chunk is passed without
+                // Z_FINISH, so a full output can also end in Z_OK
+                if ((ret == Z_OK || ret == Z_BUF_ERROR) && decompressed_size == output_size)
+                {
+                    // zlib does not record the decompressed size
+                    return {status::insufficient_output, 0};
+                }
+                if (ret == Z_OK || ret == Z_BUF_ERROR || ret == Z_DATA_ERROR || ret == Z_NEED_DICT)
+                {
+                    return {status::corrupt_input, 0};
+                }
+                return {status::failed, 0};
+            }
+            catch (...)
+            {
+                return {status::failed, 0};
+            }
+        }
+
+        size_t decompress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            const size_t *output_sizes,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            return maxzip::decompress_batch(
+                inputs,
+                input_count,
+                output_sizes,
+                output,
+                entries,
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size) {
+                    return decompress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            reset();
+            size_t consumed(0);
+            return decompress_growing(input_size, output, [&](uint8_t *output, size_t output_size, bool &finished) {
+                size_t step_in(input_size - consumed);
+                size_t produced(output_size);
+                int ret = process(input + consumed, step_in, output, produced, Z_NO_FLUSH);
+                consumed += step_in;
+                finished = (ret == Z_STREAM_END);
+                if (!finished && ((ret != Z_OK && ret != Z_BUF_ERROR) || produced < output_size))
+                {
+                    throw std::runtime_error("Zlib decompression failed");
+                }
+                return produced;
+            });
+        }
+
+        size_t decompressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count) override
+        {
+            reset();
+            buffer_cursor<input_buffer> input(inputs, input_count);
+            buffer_cursor<output_buffer> output(outputs, output_count);
+            const int ret = zlib_process_vectored(input, output, Z_FINISH, [this](const uint8_t *input, size_t &input_size, uint8_t *output, size_t &output_size, int flush) {
+                return process(input, input_size, output, output_size, flush);
+            });
+            if (ret != Z_STREAM_END)
+            {
+                throw_result({((ret == Z_OK || ret == Z_BUF_ERROR) && output.remaining() == 0) ? status::insufficient_output : status::corrupt_input, 0}, "Zlib decompression");
+            }
+            return output.position();
+        }
+
+    private:
+        /**
+         * Inflate as much as possible, supplying the dictionary when the stream
+         * asks for it. On return, input_size and output_size hold the number of
+         * bytes consumed and produced.
+         */
+        int process(const uint8_t *input, size_t &input_size, uint8_t *output, size_t &output_size, int flush)
+        {
+            size_t consumed(0);
+            size_t produced(0);
+            int ret(Z_OK);
+            bool pending(true);
+            while (pending)
+            {
+                size_t step_in = input_size - consumed;
+                size_t step_out = output_size - produced;
+                ret = zlib_process(_stream, inflate, flush, input + consumed, step_in, output + produced, step_out);
+                consumed += step_in;
+                produced += step_out;
+                pending = (ret == Z_NEED_DICT && _dictionary);
+                if (pending)
+                {
+                    zlib_set_dictionary(_stream, inflateSetDictionary, _dictionary);
+                }
+            }
+            input_size = consumed;
+            output_size = produced;
+            return ret;
+        }
+
+        void reset()
         {
             (void)inflateReset(&_stream);
-            
-            _stream.avail_in = static_cast<uInt>(input_size);
-            _stream.next_in = const_cast<Bytef *>(input);
-            _stream.avail_out = static_cast<uInt>(output_size);
-            _stream.next_out = reinterpret_cast<Bytef *>(output);
+            if (_window_bits < 0)
+            {
+                zlib_set_dictionary(_stream, inflateSetDictionary, _dictionary);
+            }
+        }
+
+        std::shared_ptr<allocator> _allocator;
+        std::shared_ptr<dictionary> _dictionary;
+        int _window_bits;
+        z_stream _stream;
+    };
+
+    class zlib_encoder : public encoder
+    {
+    public:
+        zlib_encoder(int level, int window_bits, int mem_level, int strategy, std::shared_ptr<allocator> allocator, std::shared_ptr<dictionary> dictionary) : _allocator(std::move(allocator)), _dictionary(std::move(dictionary))
+        {
+            _stream = zlib_stream(_allocator.get());
+
+            int ret = deflateInit2(&_stream, level, Z_DEFLATED, window_bits, mem_level, strategy);
+            if (ret != Z_OK)
+            {
+                throw std::runtime_error("Failed to initialize zlib encoder");
+            }
+            if (_dictionary && window_bits > 15)
+            {
+                deflateEnd(&_stream);
+                throw std::invalid_argument("Zlib dictionaries are not supported with gzip");
+            }
+            zlib_set_dictionary(_stream, deflateSetDictionary, _dictionary);
+        }
+
+        ~zlib_encoder()
+        {
+            deflateEnd(&_stream);
+        }
+
+        void init() override
+        {
+            (void)deflateReset(&_stream);
+            zlib_set_dictionary(_stream, deflateSetDictionary, _dictionary);
+        }
+
+        size_t update(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            size_t consumed(input_size);
+            int ret = zlib_process(_stream, deflate, Z_NO_FLUSH, input, consumed, output, output_size);
+            if (ret != Z_OK && ret != Z_BUF_ERROR)
+            {
+                throw std::runtime_error("Zlib compression failed");
+            }
+            return consumed;
+        }
 
-            int ret = inflate(&_stream, Z_FINISH);
-            if (ret != Z_STREAM_END && ret != Z_OK)
+        bool finish(
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            size_t consumed(0);
+            int ret = zlib_process(_stream, deflate, Z_FINISH, nullptr, consumed, output, output_size);
+            if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END)
             {
-                throw std::runtime_error("Zlib decompression failed");
+                throw std::runtime_error("Zlib compression failed");
+            }
+            return ret == Z_STREAM_END;
+        }
+
+    private:
+        std::shared_ptr<allocator> _allocator;
+        std::shared_ptr<dictionary> _dictionary;
+        z_stream _stream;
+    };
+
+    class zlib_decoder : public decoder
+    {
+    public:
+        zlib_decoder(int window_bits, std::shared_ptr<allocator> allocator, std::shared_ptr<dictionary> dictionary) : _allocator(std::move(allocator)), _dictionary(std::move(dictionary)), _window_bits(window_bits), _finished(false)
+        {
+            _stream = zlib_stream(_allocator.get());
+            int ret = inflateInit2(&_stream, window_bits);
+            if (ret != Z_OK)
+            {
+                throw std::runtime_error("Failed to initialize zlib decoder");
+            }
+            if (_window_bits < 0)
+            {
+                zlib_set_dictionary(_stream, inflateSetDictionary, _dictionary);
+            }
+        }
+
+        ~zlib_decoder()
+        {
+            inflateEnd(&_stream);
+        }
+
+        void init() override
+        {
+            (void)inflateReset(&_stream);
+            if (_window_bits < 0)
+            {
+                zlib_set_dictionary(_stream, inflateSetDictionary, _dictionary);
             }
+            _finished = false;
+        }
 
-            return output_size - _stream.avail_out;
+        size_t update(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            if (_finished && input_size > 0)
+            {
+                throw std::runtime_error("Unexpected data after end of zlib stream");
+            }
+            size_t consumed(input_size);
+            process(input, consumed, output, output_size);
+            return consumed;
+        }
+
+        bool finish(
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            const size_t capacity(output_size);
+            if (_finished)
+            {
+                output_size = 0;
+            }
+            else
+            {
+                size_t consumed(0);
+                process(nullptr, consumed, output, output_size);
+                if (!_finished && output_size < capacity)
+                {
+                    throw std::runtime_error("Zlib stream is truncated");
+                }
+            }
+            return _finished;
         }
 
     private:
+        void process(
+            const uint8_t *input,
+            size_t &input_size,
+            uint8_t *output,
+            size_t &output_size)
+        {
+            size_t consumed(input_size);
+            size_t produced(output_size);
+            int ret = zlib_process(_stream, inflate, Z_NO_FLUSH, input, consumed, output, produced);
+            if (ret == Z_NEED_DICT && _dictionary)
+            {
+                zlib_set_dictionary(_stream, inflateSetDictionary, _dictionary);
+                size_t remaining_in(input_size - consumed);
+                size_t remaining_out(output_size - produced);
+                ret = zlib_process(_stream, inflate, Z_NO_FLUSH, input + consumed, remaining_in, output + produced, remaining_out);
+                consumed += remaining_in;
+                produced += remaining_out;
+            }
+            input_size = consumed;
+            output_size = produced;
+            if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END)
+            {
+                throw std::runtime_error("Zlib decompression failed");
+            }
+            _finished = (ret == Z_STREAM_END);
+        }
+
+        std::shared_ptr<allocator> _allocator;
+        std::shared_ptr<dictionary> _dictionary;
+        int _window_bits;
         z_stream _stream;
+        bool _finished;
     };
 
     compressor *create_zlib_compressor(
@@ -132,13 +701,34 @@ namespace maxzip
             params.level.value_or(Z_DEFAULT_COMPRESSION),
             params.window_bits.value_or(15),
             params.mem_level.value_or(8),
-            params.strategy.value_or(Z_DEFAULT_STRATEGY));
+            params.strategy.value_or(Z_DEFAULT_STRATEGY),
+            params.allocator,
+            params.dictionary);
         return compressor.release();
     }
 
     decompressor *create_zlib_decompressor(
         const zlib_decompressor_params &params)
     {
-        return new zlib_decompressor(params.window_bits.value_or(15));
+        return new zlib_decompressor(params.window_bits.value_or(15), params.allocator, params.dictionary);
+    }
+
+    encoder *create_zlib_encoder(
+        const zlib_compressor_params &params)
+    {
+        std::unique_ptr<encoder> encoder = std::make_unique<zlib_encoder>(
+            params.level.value_or(Z_DEFAULT_COMPRESSION),
+            params.window_bits.value_or(15),
+            params.mem_level.value_or(8),
+            params.strategy.value_or(Z_DEFAULT_STRATEGY),
+            params.allocator,
+            params.dictionary);
+        return encoder.release();
+    }
+
+    decoder *create_zlib_decoder(
+        const zlib_decompressor_params &params)
+    {
+        return new zlib_decoder(params.window_bits.value_or(15), params.allocator, params.dictionary);
     }
 }
\ No newline at end of file
@@ -2,6 +2,26 @@
 
 namespace maxzip
 {
+    static void *zstd_allocate(void *opaque, size_t size)
+    {
+        return static_cast<allocator *>(opaque)->allocate(size);
+    }
+
+    static void zstd_deallocate(void *opaque, void *address)
+    {
+        static_cast<allocator *>(opaque)->deallocate(address);
+    }
+
+    static ZSTD_customMem zstd_memory(allocator *allocator)
+    {
+        ZSTD_customMem memory = ZSTD_defaultCMem;
+        if (allocator != nullptr)
+        {
+            memory = {zstd_allocate, zstd_deallocate, allocator};
+        }
+        return memory;
+    }
+
     template<
         class ContextType, 
         class ParameterType, 
@@ -12,13 +32,20 @@ namespace maxzip
     class zstd_context
     {
     public:
-        static void deleter(ContextType *ctx)
+        struct deleter
         {
-            static_cast<void>(DeleterFunc(ctx));
-        }
+            void operator()(ContextType *ctx) const noexcept
+            {
+                static_cast<void>(DeleterFunc(ctx));
+            }
+        };
 
-        zstd_context(ContextType *ctx) : _ctx(ctx, deleter)
+        zstd_context(ContextType *ctx, std::shared_ptr<allocator> allocator) : _allocator(std::move(allocator)), _ctx(ctx)
         {
+            if (!_ctx)
+            {
+                throw std::runtime_error("Failed to create Zstandard context");
+            }
         }
 
         void set_parameter(ParameterType key, int value)
@@ -36,14 +63,175 @@ namespace maxzip
             static_cast<void>(SetParameterFunc(_ctx.get(), key, value ? 1 : 0));
         }
 
+        template <typename RefFuncType, typename DigestedType>
+        void ref_dictionary(RefFuncType ref, const DigestedType *digested, std::shared_ptr<dictionary> owner)
+        {
+            if (ZSTD_isError(ref(_ctx.get(), digested)))
+            {
+                throw std::runtime_error("Failed to attach Zstandard dictionary");
+            }
+            _dictionary = std::move(owner);
+        }
+
+        template <typename RefFuncType, typename PoolType>
+        void ref_thread_pool(RefFuncType ref, PoolType *pool, std::shared_ptr<zstd_thread_pool> owner)
+        {
+            if (ZSTD_isError(ref(_ctx.get(), pool)))
+            {
+                throw std::runtime_error("Failed to attach Zstandard thread pool");
+            }
+            _thread_pool = std::move(owner);
+        }
+
     protected:
-        std::unique_ptr<ContextType, std::function<void(ContextType*)>> _ctx;
+        std::shared_ptr<allocator> _allocator;
+        std::shared_ptr<dictionary> _dictionary;
+        // declared before the context so that the pool outlives it
+        std::shared_ptr<zstd_thread_pool> _thread_pool;
+        std::unique_ptr<ContextType, deleter> _ctx;
     };
 
-    class zstd_compressor : public compressor, public zstd_context<ZSTD_CCtx, ZSTD_cParameter, decltype(&ZSTD_CCtx_setParameter), &ZSTD_CCtx_setParameter, decltype(&ZSTD_freeCCtx), &ZSTD_freeCCtx>
+    class zstd_thread_pool_impl final : public zstd_thread_pool
     {
     public:
-        zstd_compressor() : zstd_context(ZSTD_createCCtx())
+        explicit zstd_thread_pool_impl(size_t size) : _size(size), _pool(ZSTD_createThreadPool(size))
+        {
+            if (!_pool)
+            {
+                throw std::runtime_error("Failed to create Zstandard thread pool");
+            }
+        }
+
+        size_t size() const override
+        {
+            return _size;
+        }
+
+        ZSTD_threadPool *get() const
+        {
+            return _pool.get();
+        }
+
+        static zstd_thread_pool_impl *from(const std::shared_ptr<zstd_thread_pool> &pool)
+        {
+            zstd_thread_pool_impl *impl(nullptr);
+            if (pool)
+            {
+                impl = dynamic_cast<zstd_thread_pool_impl *>(pool.get());
+                if (impl == nullptr)
+                {
+                    throw std::invalid_argument("Thread pool must be created by create_zstd_thread_pool");
+                }
+            }
+            return impl;
+        }
+
+    private:
+        struct deleter
+        {
+            void operator()(ZSTD_threadPool *pool) const noexcept
+            {
+                ZSTD_freeThreadPool(pool);
+            }
+        };
+
+        size_t _size;
+        std::unique_ptr<ZSTD_threadPool, deleter> _pool;
+    };
+
+    using zstd_compression_context = zstd_context<ZSTD_CCtx, ZSTD_cParameter, decltype(&ZSTD_CCtx_setParameter), &ZSTD_CCtx_setParameter, decltype(&ZSTD_freeCCtx), &ZSTD_freeCCtx>;
+    using zstd_decompression_context = zstd_context<ZSTD_DCtx, ZSTD_dParameter, decltype(&ZSTD_DCtx_setParameter), &ZSTD_DCtx_setParameter, decltype(&ZSTD_freeDCtx), &ZSTD_freeDCtx>;
+
+    static void configure(zstd_compression_context &context, const zstd_compressor_params &params)
+    {
+        std::unordered_map<ZSTD_cParameter, std::optional<int>> param_map; 
+        param_map[ZSTD_c_compressionLevel] = params.level;
+        param_map[ZSTD_c_windowLog] = params.window_log;
+        param_map[ZSTD_c_hashLog] = params.hash_log;
+        param_map[ZSTD_c_chainLog] = params.chain_log;
+        param_map[ZSTD_c_searchLog] = params.search_log;
+        param_map[ZSTD_c_minMatch] = params.min_match;
+        param_map[ZSTD_c_targetLength] = params.target_length;
+        param_map[ZSTD_c_strategy] = params.strategy;
+        param_map[ZSTD_c_nbWorkers] = params.nb_workers;
+        param_map[ZSTD_c_jobSize] = params.job_size;
+        param_map[ZSTD_c_overlapLog] = params.overlap_log;
+
+        std::unordered_map<ZSTD_cParameter, std::optional<bool>> flag_map;
+        flag_map[ZSTD_c_enableLongDistanceMatching] = params.enable_long_distance_matching;
+        flag_map[ZSTD_c_contentSizeFlag] = params.enable_content_size;
+        flag_map[ZSTD_c_checksumFlag] = params.enable_checksum;
+        flag_map[ZSTD_c_dictIDFlag] = params.enable_dict_id;
+
+        for (const auto &[key, value] : param_map)
+        {
+            if (value.has_value())
+            {
+                context.set_parameter(key, value.value());
+            }
+        }
+
+        for (const auto &[key, value] : flag_map)
+        {
+            if (value.has_value())
+            {
+                context.set_flag(key, value.value());
+            }
+        }
+
+        dictionary_impl *dictionary = dictionary_impl::from(params.dictionary);
+        if (dictionary != nullptr)
+        {
+            context.ref_dictionary(ZSTD_CCtx_refCDict, dictionary->zstd_cdict(params.level.value_or(ZSTD_CLEVEL_DEFAULT)), params.dictionary);
+        }
+
+        zstd_thread_pool_impl *thread_pool = zstd_thread_pool_impl::from(params.thread_pool);
+        if (thread_pool != nullptr)
+        {
+            context.ref_thread_pool(ZSTD_CCtx_refThreadPool, thread_pool->get(), params.thread_pool);
+        }
+    }
+
+    static void configure(zstd_decompression_context &context, const zstd_decompressor_params &params)
+    {
+        if(params.window_log_max.has_value())
+        {
+            context.set_parameter(ZSTD_d_windowLogMax, params.window_log_max.value());
+        }
+
+        dictionary_impl *dictionary = dictionary_impl::from(params.dictionary);
+        if (dictionary != nullptr)
+        {
+            context.ref_dictionary(ZSTD_DCtx_refDDict, dictionary->zstd_ddict(), params.dictionary);
+        }
+    }
+
+    static status zstd_status(size_t ret)
+    {
+        switch (ZSTD_getErrorCode(ret))
+        {
+        case ZSTD_error_no_error:
+            return status::ok;
+        case ZSTD_error_dstSize_tooSmall:
+            return status::insufficient_output;
+        case ZSTD_error_prefix_unknown:
+        case ZSTD_error_frameParameter_unsupported:
+        case ZSTD_error_frameParameter_windowTooLarge:
+        case ZSTD_error_corruption_detected:
+        case ZSTD_error_checksum_wrong:
+        case ZSTD_error_dictionary_corrupted:
+        case ZSTD_error_dictionary_wrong:
+        case ZSTD_error_srcSize_wrong:
+            return status::corrupt_input;
+        default:
+            return status::failed;
+        }
+    }
+
+    class zstd_compressor final : public compressor, public zstd_compression_context
+    {
+    public:
+        zstd_compressor(const std::shared_ptr<allocator> &allocator) : zstd_context(ZSTD_createCCtx_advanced(zstd_memory(allocator.get())), allocator)
         {
         }
 
@@ -56,14 +244,12 @@ namespace maxzip
             size_t compressed_size(0);
             if (output != nullptr)
             {
-                static_cast<void>(ZSTD_CCtx_reset(_ctx.get(), ZSTD_reset_session_only));
-                compressed_size = ZSTD_compressCCtx(
+                compressed_size = ZSTD_compress2(
                     _ctx.get(),
                     output,
                     output_size,
                     input,
-                    input_size,
-                    0);
+                    input_size);
                 if(ZSTD_isError(compressed_size))
                 {
                     throw std::runtime_error("Zstandard compression failed: " + std::string(ZSTD_getErrorName(compressed_size)));
@@ -75,12 +261,102 @@ namespace maxzip
             }
             return compressed_size;
         }
+
+        codec_result try_compress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            const size_t compressed_size = ZSTD_compress2(
+                _ctx.get(),
+                output,
+                output_size,
+                input,
+                input_size);
+            switch (const status code = zstd_status(compressed_size))
+            {
+            case status::ok:
+                return {code, compressed_size};
+            case status::insufficient_output:
+                return {code, ZSTD_compressBound(input_size)};
+            default:
+                return {code, 0};
+            }
+        }
+
+        size_t compress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            return maxzip::compress_batch(
+                inputs,
+                input_count,
+                output,
+                entries,
+                [](const input_buffer &input) { return ZSTD_compressBound(input.size); },
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                    return compress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t compress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            return maxzip::compress_to(
+                input,
+                input_size,
+                output,
+                [](const input_buffer &input) { return ZSTD_compressBound(input.size); },
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t &output_size) {
+                    return compress(input, input_size, output, output_size);
+                });
+        }
+
+        size_t compressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count) override
+        {
+            buffer_cursor<input_buffer> input(inputs, input_count);
+            buffer_cursor<output_buffer> output(outputs, output_count);
+            static_cast<void>(ZSTD_CCtx_reset(_ctx.get(), ZSTD_reset_session_only));
+            // the pledged size keeps the content size in the frame header
+            static_cast<void>(ZSTD_CCtx_setPledgedSrcSize(_ctx.get(), input.remaining()));
+            while (true)
+            {
+                ZSTD_inBuffer in = {input.data(), input.available(), 0};
+                ZSTD_outBuffer out = {output.data(), output.available(), 0};
+                const bool last_buffer = (in.size == input.remaining());
+                const size_t ret = ZSTD_compressStream2(_ctx.get(), &out, &in, last_buffer ? ZSTD_e_end : ZSTD_e_continue);
+                if (ZSTD_isError(ret))
+                {
+                    throw std::runtime_error("Zstandard compression failed: " + std::string(ZSTD_getErrorName(ret)));
+                }
+                input.advance(in.pos);
+                output.advance(out.pos);
+                if (last_buffer && ret == 0)
+                {
+                    break;
+                }
+                if (output.remaining() == 0)
+                {
+                    throw std::runtime_error("Insufficient output buffer size.");
+                }
+            }
+            return output.position();
+        }
     };
 
-    class zstd_decompressor : public decompressor, public zstd_context<ZSTD_DCtx, ZSTD_dParameter, decltype(&ZSTD_DCtx_setParameter), &ZSTD_DCtx_setParameter, decltype(&ZSTD_freeDCtx), &ZSTD_freeDCtx>
+    class zstd_decompressor final : public decompressor, public zstd_decompression_context
     {
     public:
-        zstd_decompressor() : zstd_context(ZSTD_createDCtx())
+        zstd_decompressor(const std::shared_ptr<allocator> &allocator) : zstd_context(ZSTD_createDCtx_advanced(zstd_memory(allocator.get())), allocator)
         {
         }
 
@@ -102,56 +378,281 @@ namespace maxzip
             }
             return decompressed_size;
         }
+
+        codec_result try_decompress(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t output_size) noexcept override
+        {
+            const size_t decompressed_size = ZSTD_decompressDCtx(
+                _ctx.get(),
+                output,
+                output_size,
+                input,
+                input_size);
+            switch (const status code = zstd_status(decompressed_size))
+            {
+            case status::ok:
+                return {code, decompressed_size};
+            case status::insufficient_output:
+                return {code, this->decompressed_size(input, input_size).value_or(0)};
+            default:
+                return {code, 0};
+            }
+        }
+
+        size_t decompress_batch(
+            const input_buffer *inputs,
+            size_t input_count,
+            const size_t *output_sizes,
+            std::vector<uint8_t> &output,
+            batch_entry *entries) override
+        {
+            return maxzip::decompress_batch(
+                inputs,
+                input_count,
+                output_sizes,
+                output,
+                entries,
+                [this](const uint8_t *input, size_t input_size, uint8_t *output, size_t output_size) {
+                    return decompress(input, input_size, output, output_size);
+                });
+        }
+
+        std::optional<size_t> decompressed_size(
+            const uint8_t *input,
+            size_t input_size) override
+        {
+            const unsigned long long size = ZSTD_findDecompressedSize(input, input_size);
+            if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR || !trusted_size(size, input_size))
+            {
+                return std::nullopt;
+            }
+            return static_cast<size_t>(size);
+        }
+
+        size_t decompress_to(
+            const uint8_t *input,
+            size_t input_size,
+            std::vector<uint8_t> &output) override
+        {
+            const std::optional<size_t> size = decompressed_size(input, input_size);
+            if (size)
+            {
+                output.resize(*size);
+                output.resize(decompress(input, input_size, output.data(), output.size()));
+                return output.size();
+            }
+
+            // frames without a trusted content size are streamed into a growing buffer
+            static_cast<void>(ZSTD_DCtx_reset(_ctx.get(), ZSTD_reset_session_only));
+            ZSTD_inBuffer in = {input, input_size, 0};
+            return decompress_growing(input_size, output, [&](uint8_t *output, size_t output_size, bool &finished) {
+                ZSTD_outBuffer out = {output, output_size, 0};
+                while (!finished && out.pos < out.size)
+                {
+                    const size_t ret = ZSTD_decompressStream(_ctx.get(), &out, &in);
+                    if (ZSTD_isError(ret))
+                    {
+                        throw std::runtime_error("Zstandard decompression failed: " + std::string(ZSTD_getErrorName(ret)));
+                    }
+                    finished = (ret == 0 && in.pos == in.size);
+                    if (!finished && in.pos == in.size && out.pos < out.size)
+                    {
+                        throw std::runtime_error("Zstandard stream is truncated");
+                    }
+                }
+                return out.pos;
+            });
+        }
+
+        size_t decompressv(
+            const input_buffer *inputs,
+            size_t input_count,
+            const output_buffer *outputs,
+            size_t output_count) override
+        {
+            buffer_cursor<input_buffer> input(inputs, input_count);
+            buffer_cursor<output_buffer> output(outputs, output_count);
+            static_cast<void>(ZSTD_DCtx_reset(_ctx.get(), ZSTD_reset_session_only));
+            while (true)
+            {
+                ZSTD_inBuffer in = {input.data(), input.available(), 0};
+                ZSTD_outBuffer out = {output.data(), output.available(), 0};
+                const size_t ret = ZSTD_decompressStream(_ctx.get(), &out, &in);
+                if (ZSTD_isError(ret))
+                {
+                    throw std::runtime_error("Zstandard decompression failed: " + std::string(ZSTD_getErrorName(ret)));
+                }
+                input.advance(in.pos);
+                output.advance(out.pos);
+                if (ret == 0 && input.remaining() == 0)
+                {
+                    break;
+                }
+                if (in.pos == 0 && out.pos == 0)
+                {
+                    if (output.remaining() == 0)
+                    {
+                        throw std::runtime_error("Insufficient output buffer size.");
+                    }
+                    throw std::runtime_error("Zstandard stream is truncated");
+                }
+            }
+            return output.position();
+        }
     };
 
-    compressor *create_zstd_compressor(const zstd_compressor_params &params)
+    class zstd_encoder : public encoder, public zstd_compression_context
     {
-        std::unique_ptr<zstd_compressor> compressor = std::make_unique<zstd_compressor>();
+    public:
+        zstd_encoder(const std::shared_ptr<allocator> &allocator) : zstd_context(ZSTD_createCCtx_advanced(zstd_memory(allocator.get())), allocator)
+        {
+        }
 
-        std::unordered_map<ZSTD_cParameter, std::optional<int>> param_map; 
-        param_map[ZSTD_c_compressionLevel] = params.level;
-        param_map[ZSTD_c_windowLog] = params.window_log;
-        param_map[ZSTD_c_hashLog] = params.hash_log;
-        param_map[ZSTD_c_chainLog] = params.chain_log;
-        param_map[ZSTD_c_searchLog] = params.search_log;
-        param_map[ZSTD_c_minMatch] = params.min_match;
-        param_map[ZSTD_c_targetLength] = params.target_length;
-        param_map[ZSTD_c_strategy] = params.strategy;
+        void init() override
+        {
+            static_cast<void>(ZSTD_CCtx_reset(_ctx.get(), ZSTD_reset_session_only));
+        }
 
-        std::unordered_map<ZSTD_cParameter, std::optional<bool>> flag_map;
-        flag_map[ZSTD_c_enableLongDistanceMatching] = params.enable_long_distance_matching;
-        flag_map[ZSTD_c_contentSizeFlag] = params.enable_content_size;
-        flag_map[ZSTD_c_checksumFlag] = params.enable_checksum;
-        flag_map[ZSTD_c_dictIDFlag] = params.enable_dict_id;
+        size_t update(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            ZSTD_inBuffer in = {input, input_size, 0};
+            ZSTD_outBuffer out = {output, output_size, 0};
+            do
+            {
+                check(ZSTD_compressStream2(_ctx.get(), &out, &in, ZSTD_e_continue));
+            } while (in.pos < in.size && out.pos < out.size);
+            output_size = out.pos;
+            return in.pos;
+        }
 
-        for (const auto &[key, value] : param_map)
+        bool finish(
+            uint8_t *output,
+            size_t &output_size) override
         {
-            if (value.has_value())
+            ZSTD_inBuffer in = {nullptr, 0, 0};
+            ZSTD_outBuffer out = {output, output_size, 0};
+            size_t remaining(0);
+            do
             {
-                compressor->set_parameter(key, value.value());
+                remaining = check(ZSTD_compressStream2(_ctx.get(), &out, &in, ZSTD_e_end));
+            } while (remaining > 0 && out.pos < out.size);
+            output_size = out.pos;
+            return remaining == 0;
+        }
+
+    private:
+        static size_t check(size_t ret)
+        {
+            if (ZSTD_isError(ret))
+            {
+                throw std::runtime_error("Zstandard compression failed: " + std::string(ZSTD_getErrorName(ret)));
             }
+            return ret;
         }
+    };
 
-        for (const auto &[key, value] : flag_map)
+    class zstd_decoder : public decoder, public zstd_decompression_context
+    {
+    public:
+        zstd_decoder(const std::shared_ptr<allocator> &allocator) : zstd_context(ZSTD_createDCtx_advanced(zstd_memory(allocator.get())), allocator), _finished(false)
         {
-            if (value.has_value())
+        }
+
+        void init() override
+        {
+            static_cast<void>(ZSTD_DCtx_reset(_ctx.get(), ZSTD_reset_session_only));
+            _finished = false;
+        }
+
+        size_t update(
+            const uint8_t *input,
+            size_t input_size,
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            ZSTD_inBuffer in = {input, input_size, 0};
+            ZSTD_outBuffer out = {output, output_size, 0};
+            do
             {
-                compressor->set_flag(key, value.value());
+                process(in, out);
+            } while (in.pos < in.size && out.pos < out.size);
+            output_size = out.pos;
+            return in.pos;
+        }
+
+        bool finish(
+            uint8_t *output,
+            size_t &output_size) override
+        {
+            ZSTD_inBuffer in = {nullptr, 0, 0};
+            ZSTD_outBuffer out = {output, output_size, 0};
+            if (!_finished)
+            {
+                process(in, out);
+                if (!_finished && out.pos < out.size)
+                {
+                    throw std::runtime_error("Zstandard stream is truncated");
+                }
             }
+            output_size = out.pos;
+            return _finished;
         }
 
-        return compressor.release();
-    }
+    private:
+        void process(ZSTD_inBuffer &in, ZSTD_outBuffer &out)
+        {
+            const size_t ret = ZSTD_decompressStream(_ctx.get(), &out, &in);
+            if (ZSTD_isError(ret))
+            {
+                throw std::runtime_error("Zstandard decompression failed: " + std::string(ZSTD_getErrorName(ret)));
+            }
+            _finished = (ret == 0);
+        }
 
-    decompressor *create_zstd_decompressor(const zstd_decompressor_params &params)
+        bool _finished;
+    };
+
+    zstd_thread_pool *create_zstd_thread_pool(size_t thread_count)
     {
-        std::unique_ptr<zstd_decompressor> decompressor = std::make_unique<zstd_decompressor>();
-        
-        if(params.window_log_max.has_value())
+        if (thread_count == 0)
         {
-            decompressor->set_parameter(ZSTD_d_windowLogMax, params.window_log_max.value());
+            throw std::invalid_argument("Thread count must be at least 1");
         }
+        return new zstd_thread_pool_impl(thread_count);
+    }
+
+    compressor *create_zstd_compressor(const zstd_compressor_params &params)
+    {
+        std::unique_ptr<zstd_compressor> compressor = std::make_unique<zstd_compressor>(params.allocator);
+        configure(*compressor, params);
+        return compressor.release();
+    }
 
+    decompressor *create_zstd_decompressor(const zstd_decompressor_params &params)
+    {
+        std::unique_ptr<zstd_decompressor> decompressor = std::make_unique<zstd_decompressor>(params.allocator);
+        configure(*decompressor, params);
         return decompressor.release();
     }
+
+    encoder *create_zstd_encoder(const zstd_compressor_params &params)
+    {
+        std::unique_ptr<zstd_encoder> encoder = std::make_unique<zstd_encoder>(params.allocator);
+        configure(*encoder, params);
+        return encoder.release();
+    }
+
+    decoder *create_zstd_decoder(const zstd_decompressor_params &params)
+    {
+        std::unique_ptr<zstd_decoder> decoder = std::make_unique<zstd_decoder>(params.allocator);
+        configure(*decoder, params);
+        return decoder.release();
+    }
 }
\ No newline at end of file
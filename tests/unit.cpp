@@ -22,7 +22,20 @@
 
 #include <maxtest.hpp>
 #include <maxzip.hpp>
+#include <maxzip/basic.hpp>
+#include <internal.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <memory>
+#include <string>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 template <typename CreateFunction, typename ParamType>
 static std::pair<bool, std::unique_ptr<maxzip::compressor>> try_create_compressor(CreateFunction create_func, ParamType &&param)
@@ -73,6 +86,20 @@ static bool try_func(const std::function<void()> &func)
     return result;
 }
 
+// true if func rejects its input with runtime_error; other exceptions such as bad_alloc escape
+static bool rejects_input(const std::function<void()> &func)
+{
+    try
+    {
+        func();
+    }
+    catch (const std::runtime_error &)
+    {
+        return true;
+    }
+    return false;
+}
+
 static void test_block_compression(const std::unique_ptr<maxzip::compressor> &compressor,
                             const std::unique_ptr<maxzip::decompressor> &decompressor)
 {
@@ -119,6 +146,707 @@ static void test_block_compression(const std::unique_ptr<maxzip::compressor> &co
     MAXTEST_ASSERT(std::equal(decompressed_data.begin(), decompressed_data.end(), input_data.begin()));
 }
 
+static std::vector<uint8_t> stream_encode(const std::unique_ptr<maxzip::encoder> &encoder, const std::vector<uint8_t> &input)
+{
+    std::vector<uint8_t> output;
+    uint8_t buffer[64];
+    size_t offset(0);
+    size_t output_size;
+    bool finished(false);
+
+    encoder->init();
+    while (offset < input.size())
+    {
+        const size_t input_size = std::min<size_t>(100, input.size() - offset);
+        output_size = sizeof(buffer);
+        offset += encoder->update(input.data() + offset, input_size, buffer, output_size);
+        output.insert(output.end(), buffer, buffer + output_size);
+    }
+    while (!finished)
+    {
+        output_size = sizeof(buffer);
+        finished = encoder->finish(buffer, output_size);
+        output.insert(output.end(), buffer, buffer + output_size);
+    }
+    return output;
+}
+
+static std::vector<uint8_t> stream_decode(const std::unique_ptr<maxzip::decoder> &decoder, const std::vector<uint8_t> &input)
+{
+    std::vector<uint8_t> output;
+    uint8_t buffer[64];
+    size_t offset(0);
+    size_t output_size;
+    bool finished(false);
+
+    decoder->init();
+    while (offset < input.size())
+    {
+        const size_t input_size = std::min<size_t>(10, input.size() - offset);
+        output_size = sizeof(buffer);
+        offset += decoder->update(input.data() + offset, input_size, buffer, output_size);
+        output.insert(output.end(), buffer, buffer + output_size);
+    }
+    while (!finished)
+    {
+        output_size = sizeof(buffer);
+        finished = decoder->finish(buffer, output_size);
+        output.insert(output.end(), buffer, buffer + output_size);
+    }
+    return output;
+}
+
+static void test_stream_compression(const std::unique_ptr<maxzip::encoder> &encoder,
+                                    const std::unique_ptr<maxzip::decoder> &decoder)
+{
+    std::vector<uint8_t> input_data(16384);
+    std::vector<uint8_t> compressed_data;
+    std::vector<uint8_t> decompressed_data;
+
+    for (size_t i = 0; i < input_data.size(); i++)
+    {
+        input_data[i] = static_cast<uint8_t>((i * 7) ^ (i >> 5));
+    }
+
+    // compress and decompress twice to check that init resets the stream
+    for (int pass = 0; pass < 2; pass++)
+    {
+        MAXTEST_ASSERT(try_func([&]() {
+            compressed_data = stream_encode(encoder, input_data);
+        }));
+        MAXTEST_ASSERT(!compressed_data.empty());
+
+        MAXTEST_ASSERT(try_func([&]() {
+            decompressed_data = stream_decode(decoder, compressed_data);
+        }));
+        MAXTEST_ASSERT(decompressed_data == input_data);
+    }
+
+    // a truncated stream should fail to finish
+    compressed_data.resize(compressed_data.size() / 2);
+    MAXTEST_ASSERT(!try_func([&]() {
+        decompressed_data = stream_decode(decoder, compressed_data);
+    }));
+}
+
+static void test_parallel_compression(const maxzip::compressor_factory &compressor_factory,
+                                      const maxzip::decompressor_factory &decompressor_factory)
+{
+    maxzip::parallel_compressor_params compress_params;
+    maxzip::parallel_decompressor_params decompress_params;
+    std::unique_ptr<maxzip::compressor> compressor;
+    std::unique_ptr<maxzip::decompressor> decompressor;
+
+    compress_params.chunk_size = 0;
+    MAXTEST_ASSERT(!try_func([&]() {
+        compressor.reset(maxzip::create_parallel_compressor(compressor_factory, compress_params));
+    }));
+    compress_params.chunk_size = 4096;
+    compress_params.thread_count = 0;
+    MAXTEST_ASSERT(!try_func([&]() {
+        compressor.reset(maxzip::create_parallel_compressor(compressor_factory, compress_params));
+    }));
+    compress_params.thread_count = 4;
+    decompress_params.thread_count = 3;
+    MAXTEST_ASSERT(try_func([&]() {
+        compressor.reset(maxzip::create_parallel_compressor(compressor_factory, compress_params));
+        decompressor.reset(maxzip::create_parallel_decompressor(decompressor_factory, decompress_params));
+    }));
+
+    std::vector<uint8_t> input_data(40000);
+    for (size_t i = 0; i < input_data.size(); i++)
+    {
+        input_data[i] = static_cast<uint8_t>((i % 251) ^ (i >> 12));
+    }
+
+    size_t max_compressed_size(0);
+    compressor->compress(input_data.data(), input_data.size(), nullptr, max_compressed_size);
+    std::vector<uint8_t> compressed_data(max_compressed_size);
+    size_t compressed_size(0);
+    MAXTEST_ASSERT(try_func([&]() {
+        compressed_size = compressor->compress(input_data.data(), input_data.size(), compressed_data.data(), max_compressed_size);
+    }));
+    MAXTEST_ASSERT(compressed_size > 0 && compressed_size <= max_compressed_size);
+    compressed_data.resize(compressed_size);
+
+    // an output smaller than the bound goes through scratch buffers and
+    // produces the same frame
+    std::vector<uint8_t> exact_data(compressed_size);
+    size_t exact_size(compressed_size);
+    MAXTEST_ASSERT(compressor->compress(input_data.data(), input_data.size(), exact_data.data(), exact_size) == compressed_size);
+    MAXTEST_ASSERT(exact_data == compressed_data);
+    exact_size = compressed_size - 1;
+    MAXTEST_ASSERT(!try_func([&]() {
+        compressor->compress(input_data.data(), input_data.size(), exact_data.data(), exact_size);
+    }));
+
+    // the output buffer must hold the whole frame
+    std::vector<uint8_t> decompressed_data(input_data.size() - 1);
+    MAXTEST_ASSERT(!try_func([&]() {
+        decompressor->decompress(compressed_data.data(), compressed_data.size(), decompressed_data.data(), decompressed_data.size());
+    }));
+
+    size_t decompressed_size(0);
+    decompressed_data.resize(input_data.size());
+    MAXTEST_ASSERT(try_func([&]() {
+        decompressed_size = decompressor->decompress(compressed_data.data(), compressed_data.size(), decompressed_data.data(), decompressed_data.size());
+    }));
+    MAXTEST_ASSERT(decompressed_size == input_data.size());
+    MAXTEST_ASSERT(decompressed_data == input_data);
+
+    // a truncated frame or a bad header should be rejected
+    MAXTEST_ASSERT(!try_func([&]() {
+        decompressor->decompress(compressed_data.data(), compressed_data.size() / 2, decompressed_data.data(), decompressed_data.size());
+    }));
+    compressed_data[0] ^= 0xFF;
+    MAXTEST_ASSERT(!try_func([&]() {
+        decompressor->decompress(compressed_data.data(), compressed_data.size(), decompressed_data.data(), decompressed_data.size());
+    }));
+}
+
+static void test_seekable_compression(const maxzip::compressor_factory &compressor_factory,
+                                      const maxzip::decompressor_factory &decompressor_factory)
+{
+    maxzip::seekable_compressor_params params;
+    std::unique_ptr<maxzip::compressor> compressor;
+    std::unique_ptr<maxzip::seekable_decompressor> decompressor;
+
+    params.frame_size = 0;
+    MAXTEST_ASSERT(!try_func([&]() {
+        compressor.reset(maxzip::create_seekable_compressor(compressor_factory, params));
+    }));
+    params.frame_size = 4096;
+    MAXTEST_ASSERT(try_func([&]() {
+        compressor.reset(maxzip::create_seekable_compressor(compressor_factory, params));
+        decompressor.reset(maxzip::create_seekable_decompressor(decompressor_factory));
+    }));
+
+    std::vector<uint8_t> input_data(100000);
+    for (size_t i = 0; i < input_data.size(); i++)
+    {
+        input_data[i] = static_cast<uint8_t>((i % 253) ^ (i >> 10));
+    }
+
+    size_t max_compressed_size(0);
+    compressor->compress(input_data.data(), input_data.size(), nullptr, max_compressed_size);
+    std::vector<uint8_t> compressed_data(max_compressed_size);
+    size_t compressed_size(0);
+    MAXTEST_ASSERT(try_func([&]() {
+        compressed_size = compressor->compress(input_data.data(), input_data.size(), compressed_data.data(), max_compressed_size);
+    }));
+    compressed_data.resize(compressed_size);
+
+    MAXTEST_ASSERT(try_func([&]() {
+        decompressor->load(compressed_data.data(), compressed_data.size());
+    }));
+    MAXTEST_ASSERT(decompressor->size() == input_data.size());
+
+    // ranges inside one frame, across several frames and past the end
+    const std::pair<size_t, size_t> ranges[] = {{5000, 100}, {5000, 200}, {4000, 20000}, {8192, 4096}, {99000, 5000}};
+    for (const auto &[offset, length] : ranges)
+    {
+        std::vector<uint8_t> range(length);
+        size_t read_size(0);
+        MAXTEST_ASSERT(try_func([&]() {
+            read_size = decompressor->read(offset, length, range.data());
+        }));
+        MAXTEST_ASSERT(read_size == std::min(length, input_data.size() - offset));
+        MAXTEST_ASSERT(std::equal(range.begin(), range.begin() + read_size, input_data.begin() + offset));
+    }
+    MAXTEST_ASSERT(!try_func([&]() {
+        uint8_t byte;
+        decompressor->read(input_data.size() + 1, 1, &byte);
+    }));
+
+    std::vector<uint8_t> decompressed_data(input_data.size());
+    size_t decompressed_size(0);
+    MAXTEST_ASSERT(try_func([&]() {
+        decompressed_size = decompressor->decompress(compressed_data.data(), compressed_data.size(), decompressed_data.data(), decompressed_data.size());
+    }));
+    MAXTEST_ASSERT(decompressed_size == input_data.size());
+    MAXTEST_ASSERT(decompressed_data == input_data);
+
+    // a damaged footer should be rejected
+    compressed_data.back() ^= 0xFF;
+    MAXTEST_ASSERT(!try_func([&]() {
+        decompressor->load(compressed_data.data(), compressed_data.size());
+    }));
+}
+
+class counting_allocator : public maxzip::allocator
+{
+public:
+    counting_allocator() : allocations(0), live(0)
+    {
+    }
+
+    void *allocate(size_t size) override
+    {
+        allocations++;
+        live++;
+        return std::malloc(size);
+    }
+
+    void deallocate(void *address) override
+    {
+        if (address != nullptr)
+        {
+            live--;
+            std::free(address);
+        }
+    }
+
+    size_t allocations;
+    size_t live;
+};
+
+template <typename CompressorParams, typename DecompressorParams>
+static void test_allocator_hooks(maxzip::compressor *(*create_compressor)(const CompressorParams &),
+                                 maxzip::decompressor *(*create_decompressor)(const DecompressorParams &),
+                                 maxzip::encoder *(*create_encoder)(const CompressorParams &),
+                                 maxzip::decoder *(*create_decoder)(const DecompressorParams &))
+{
+    std::shared_ptr<counting_allocator> allocator = std::make_shared<counting_allocator>();
+    CompressorParams compress_params;
+    DecompressorParams decompress_params;
+    compress_params.allocator = allocator;
+    decompress_params.allocator = allocator;
+    {
+        std::unique_ptr<maxzip::compressor> compressor(create_compressor(compress_params));
+        std::unique_ptr<maxzip::decompressor> decompressor(create_decompressor(decompress_params));
+        test_block_compression(compressor, decompressor);
+        std::unique_ptr<maxzip::encoder> encoder(create_encoder(compress_params));
+        std::unique_ptr<maxzip::decoder> decoder(create_decoder(decompress_params));
+        test_stream_compression(encoder, decoder);
+    }
+    MAXTEST_ASSERT(allocator->allocations > 0);
+    MAXTEST_ASSERT(allocator->live == 0);
+}
+
+static std::vector<uint8_t> make_message(size_t index)
+{
+    const std::string message =
+        "{\"id\":" + std::to_string(index) +
+        ",\"user\":\"user" + std::to_string(index % 97) +
+        "\",\"status\":\"" + ((index % 3 == 0) ? "active" : "inactive") +
+        "\",\"tags\":[\"alpha\",\"beta\",\"gamma\"],\"score\":" + std::to_string((index * 7919) % 1000) +
+        ",\"region\":\"eu-west-" + std::to_string(index % 4) + "\"}";
+    return std::vector<uint8_t>(message.begin(), message.end());
+}
+
+// concatenated messages, at least size bytes in all
+static std::vector<uint8_t> make_corpus(size_t size)
+{
+    std::vector<uint8_t> corpus;
+    for (size_t i = 0; corpus.size() < size; i++)
+    {
+        const std::vector<uint8_t> message = make_message(i);
+        corpus.insert(corpus.end(), message.begin(), message.end());
+    }
+    return corpus;
+}
+
+static std::vector<uint8_t> make_dictionary()
+{
+    std::vector<uint8_t> samples;
+    std::vector<size_t> sample_sizes;
+    for (size_t i = 0; i < 2000; i++)
+    {
+        const std::vector<uint8_t> message = make_message(i);
+        samples.insert(samples.end(), message.begin(), message.end());
+        sample_sizes.push_back(message.size());
+    }
+    std::vector<uint8_t> dictionary(4096);
+    dictionary.resize(maxzip::train_dictionary(samples.data(), sample_sizes.data(), sample_sizes.size(), dictionary.data(), dictionary.size()));
+    return dictionary;
+}
+
+static size_t compressed_message_size(const std::unique_ptr<maxzip::compressor> &compressor,
+                                      const std::unique_ptr<maxzip::decompressor> &decompressor,
+                                      const std::vector<uint8_t> &message)
+{
+    size_t compressed_size(0);
+    compressor->compress(message.data(), message.size(), nullptr, compressed_size);
+    std::vector<uint8_t> compressed_data(compressed_size);
+    compressed_size = compressor->compress(message.data(), message.size(), compressed_data.data(), compressed_size);
+    std::vector<uint8_t> decompressed_data(message.size());
+    MAXTEST_ASSERT(decompressor->decompress(compressed_data.data(), compressed_size, decompressed_data.data(), decompressed_data.size()) == message.size());
+    MAXTEST_ASSERT(decompressed_data == message);
+    return compressed_size;
+}
+
+template <typename CompressorParams, typename DecompressorParams>
+static void test_dictionary(maxzip::compressor *(*create_compressor)(const CompressorParams &),
+                            maxzip::decompressor *(*create_decompressor)(const DecompressorParams &),
+                            const std::shared_ptr<maxzip::dictionary> &dictionary)
+{
+    CompressorParams compress_params;
+    DecompressorParams decompress_params;
+    std::unique_ptr<maxzip::compressor> plain_compressor(create_compressor(compress_params));
+    std::unique_ptr<maxzip::decompressor> plain_decompressor(create_decompressor(decompress_params));
+    compress_params.dictionary = dictionary;
+    decompress_params.dictionary = dictionary;
+    std::unique_ptr<maxzip::compressor> compressor(create_compressor(compress_params));
+    std::unique_ptr<maxzip::decompressor> decompressor(create_decompressor(decompress_params));
+
+    size_t plain_size(0);
+    size_t dictionary_size(0);
+    for (size_t i = 5000; i < 5010; i++)
+    {
+        const std::vector<uint8_t> message = make_message(i);
+        plain_size += compressed_message_size(plain_compressor, plain_decompressor, message);
+        dictionary_size += compressed_message_size(compressor, decompressor, message);
+    }
+    MAXTEST_ASSERT(dictionary_size < plain_size);
+}
+
+static void test_batch_compression(maxzip::compressor *compressor, maxzip::decompressor *decompressor)
+{
+    std::vector<std::vector<uint8_t>> messages;
+    std::vector<maxzip::input_buffer> inputs;
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < 1000; i++)
+    {
+        messages.push_back(make_message(i));
+    }
+    for (const std::vector<uint8_t> &message : messages)
+    {
+        inputs.push_back({message.data(), message.size()});
+        sizes.push_back(message.size());
+    }
+
+    std::vector<uint8_t> compressed;
+    std::vector<maxzip::batch_entry> compressed_entries(inputs.size());
+    std::vector<uint8_t> decompressed;
+    std::vector<maxzip::batch_entry> decompressed_entries(inputs.size());
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const size_t compressed_size = compressor->compress_batch(inputs.data(), inputs.size(), compressed, compressed_entries.data());
+        MAXTEST_ASSERT(compressed_size <= compressed.size());
+
+        std::vector<maxzip::input_buffer> frames;
+        for (const maxzip::batch_entry &entry : compressed_entries)
+        {
+            MAXTEST_ASSERT(entry.offset + entry.size <= compressed_size);
+            frames.push_back({compressed.data() + entry.offset, entry.size});
+        }
+        const size_t decompressed_size = decompressor->decompress_batch(frames.data(), frames.size(), sizes.data(), decompressed, decompressed_entries.data());
+        MAXTEST_ASSERT(decompressed_size <= decompressed.size());
+        for (size_t i = 0; i < messages.size(); i++)
+        {
+            const maxzip::batch_entry &entry = decompressed_entries[i];
+            MAXTEST_ASSERT(entry.size == messages[i].size());
+            MAXTEST_ASSERT(std::equal(messages[i].begin(), messages[i].end(), decompressed.begin() + entry.offset));
+        }
+    }
+    MAXTEST_ASSERT(compressor->compress_batch(nullptr, 0, compressed, nullptr) == 0);
+}
+
+static std::vector<uint8_t> adaptive_round_trip(maxzip::compressor *compressor, maxzip::decompressor *decompressor, const std::vector<uint8_t> &input)
+{
+    size_t compressed_size(0);
+    compressor->compress(input.data(), input.size(), nullptr, compressed_size);
+    std::vector<uint8_t> compressed(compressed_size);
+    compressed_size = compressor->compress(input.data(), input.size(), compressed.data(), compressed_size);
+    MAXTEST_ASSERT(compressed_size <= input.size() + 1);
+    compressed.resize(compressed_size);
+    std::vector<uint8_t> decompressed(input.size());
+    MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed_size, decompressed.data(), decompressed.size()) == input.size());
+    MAXTEST_ASSERT(decompressed == input);
+    return compressed;
+}
+
+// envelope byte and compressed size of each adaptive setting, fastest first
+static std::vector<std::pair<uint8_t, size_t>> adaptive_settings(const std::vector<uint8_t> &input)
+{
+    std::vector<std::unique_ptr<maxzip::compressor>> compressors;
+    std::vector<uint8_t> headers;
+    for (int level : {1, 3, 6, 9, 15, 19})
+    {
+        maxzip::zstd_compressor_params params;
+        params.level = level;
+        compressors.emplace_back(maxzip::create_zstd_compressor(params));
+        headers.push_back(0xB3);
+    }
+    for (int level : {1, 6, 9})
+    {
+        maxzip::zlib_compressor_params params;
+        params.level = level;
+        compressors.emplace_back(maxzip::create_zlib_compressor(params));
+        headers.push_back(0xB2);
+    }
+    for (int quality : {1, 5, 9, 11})
+    {
+        maxzip::brotli_compressor_params params;
+        params.quality = quality;
+        compressors.emplace_back(maxzip::create_brotli_compressor(params));
+        headers.push_back(0xB1);
+    }
+    std::vector<std::pair<uint8_t, size_t>> settings;
+    std::vector<uint8_t> compressed;
+    for (size_t i = 0; i < compressors.size(); i++)
+    {
+        settings.emplace_back(headers[i], compressors[i]->compress_to(input.data(), input.size(), compressed) + 1);
+    }
+    return settings;
+}
+
+static void test_owned_buffers(maxzip::compressor *compressor, maxzip::decompressor *decompressor, const std::vector<uint8_t> &input)
+{
+    std::vector<uint8_t> compressed;
+    std::vector<uint8_t> decompressed;
+    MAXTEST_ASSERT(compressor->compress_to(input.data(), input.size(), compressed) == compressed.size());
+    MAXTEST_ASSERT(decompressor->decompress_to(compressed.data(), compressed.size(), decompressed) == input.size());
+    MAXTEST_ASSERT(decompressed == input);
+
+    // steady-state calls reuse the buffers
+    const uint8_t *compressed_data = compressed.data();
+    const uint8_t *decompressed_data = decompressed.data();
+    compressor->compress_to(input.data(), input.size(), compressed);
+    decompressor->decompress_to(compressed.data(), compressed.size(), decompressed);
+    MAXTEST_ASSERT(compressed.data() == compressed_data);
+    MAXTEST_ASSERT(decompressed.data() == decompressed_data);
+    MAXTEST_ASSERT(decompressed == input);
+
+    MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress_to(compressed.data(), compressed.size() / 2, decompressed); }));
+}
+
+static std::vector<uint8_t> read_test_file(const std::string &path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+static void write_test_file(const std::string &path, const std::vector<uint8_t> &data)
+{
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    stream.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+}
+
+static void test_file_compression(maxzip::compressor &compressor, maxzip::decompressor &decompressor, const std::vector<uint8_t> &input)
+{
+    const std::string directory = std::filesystem::temp_directory_path().string();
+    const std::string input_path = directory + "/maxzip_unit_input";
+    const std::string compressed_path = directory + "/maxzip_unit_compressed";
+    const std::string output_path = directory + "/maxzip_unit_output";
+    write_test_file(input_path, input);
+    const size_t compressed_size = maxzip::compress_file(input_path, compressed_path, compressor);
+    MAXTEST_ASSERT(std::filesystem::file_size(compressed_path) == compressed_size);
+    MAXTEST_ASSERT(maxzip::decompress_file(compressed_path, output_path, decompressor) == input.size());
+    MAXTEST_ASSERT(read_test_file(output_path) == input);
+
+    // a failed call leaves no output behind
+    std::filesystem::remove(output_path);
+    std::filesystem::resize_file(compressed_path, compressed_size / 2);
+    MAXTEST_ASSERT(!try_func([&]() { maxzip::decompress_file(compressed_path, output_path, decompressor); }));
+    MAXTEST_ASSERT(!std::filesystem::exists(output_path));
+
+    // a file is never replaced while it is read
+    MAXTEST_ASSERT(!try_func([&]() { maxzip::compress_file(input_path, input_path, compressor); }));
+    MAXTEST_ASSERT(!try_func([&]() { maxzip::decompress_file(compressed_path, directory + "/./maxzip_unit_compressed", decompressor); }));
+    MAXTEST_ASSERT(read_test_file(input_path) == input);
+    MAXTEST_ASSERT(std::filesystem::file_size(compressed_path) == compressed_size / 2);
+
+    std::filesystem::remove(input_path);
+    std::filesystem::remove(compressed_path);
+}
+
+static std::vector<uint8_t> run_pipeline(maxzip::pipeline &pipeline, const std::vector<uint8_t> &input, size_t read_size)
+{
+    std::vector<uint8_t> output;
+    size_t offset(0);
+    const uint64_t written = pipeline.run(
+        [&](uint8_t *buffer, size_t size) {
+            // short reads, as from a pipe or socket
+            const size_t count = std::min({size, read_size, input.size() - offset});
+            std::copy(input.begin() + offset, input.begin() + offset + count, buffer);
+            offset += count;
+            return count;
+        },
+        [&](const uint8_t *data, size_t size) { output.insert(output.end(), data, data + size); });
+    MAXTEST_ASSERT(written == output.size());
+    return output;
+}
+
+static void test_pipeline(const maxzip::compressor_factory &compressor_factory,
+                          const maxzip::decompressor_factory &decompressor_factory)
+{
+    maxzip::pipeline_params params;
+    params.block_size = 0;
+    MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::pipeline>(maxzip::create_compression_pipeline(compressor_factory, params)); }));
+    params.block_size = 4096;
+    params.thread_count = 0;
+    MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::pipeline>(maxzip::create_compression_pipeline(compressor_factory, params)); }));
+    params.thread_count = 3;
+    params.queue_depth = 0;
+    MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::pipeline>(maxzip::create_decompression_pipeline(decompressor_factory, params)); }));
+    params.queue_depth = 4;
+
+    std::unique_ptr<maxzip::pipeline> compression(maxzip::create_compression_pipeline(compressor_factory, params));
+    std::unique_ptr<maxzip::pipeline> decompression(maxzip::create_decompression_pipeline(decompressor_factory, params));
+    const std::vector<uint8_t> input = make_corpus(100000);
+    for (size_t size : {size_t(0), size_t(4096), input.size()})
+    {
+        const std::vector<uint8_t> data(input.begin(), input.begin() + size);
+        const std::vector<uint8_t> compressed = run_pipeline(*compression, data, 1000);
+        MAXTEST_ASSERT(run_pipeline(*decompression, compressed, 777) == data);
+    }
+
+    const std::vector<uint8_t> compressed = run_pipeline(*compression, input, input.size());
+    const std::vector<uint8_t> truncated(compressed.begin(), compressed.end() - 4);
+    MAXTEST_ASSERT(!try_func([&]() { run_pipeline(*decompression, truncated, 1000); }));
+    std::vector<uint8_t> corrupted(compressed);
+    corrupted[20] ^= 0xFF;
+    MAXTEST_ASSERT(!try_func([&]() { run_pipeline(*decompression, corrupted, 1000); }));
+    MAXTEST_ASSERT(!try_func([&]() { run_pipeline(*decompression, input, 1000); }));
+    // the pipeline is reusable after a failure
+    MAXTEST_ASSERT(run_pipeline(*decompression, compressed, 1000) == input);
+
+#if defined(__unix__) || defined(__APPLE__)
+    int fds[2];
+    MAXTEST_ASSERT(::pipe(fds) == 0);
+    std::thread producer([&]() {
+        size_t offset(0);
+        while (offset < input.size())
+        {
+            const ssize_t count = ::write(fds[1], input.data() + offset, std::min<size_t>(input.size() - offset, 3000));
+            if (count <= 0)
+            {
+                break;
+            }
+            offset += static_cast<size_t>(count);
+        }
+        ::close(fds[1]);
+    });
+    const std::string path = (std::filesystem::temp_directory_path() / "maxzip_unit_pipeline").string();
+    const int output_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    MAXTEST_ASSERT(output_fd >= 0);
+    const uint64_t written = compression->run(fds[0], output_fd);
+    producer.join();
+    ::close(fds[0]);
+    ::close(output_fd);
+    const std::vector<uint8_t> piped = read_test_file(path);
+    std::filesystem::remove(path);
+    MAXTEST_ASSERT(written == piped.size());
+    MAXTEST_ASSERT(run_pipeline(*decompression, piped, 1000) == input);
+#endif
+}
+
+template <maxzip::codec Codec, int Level>
+static void test_basic(const maxzip::decompressor_factory &decompressor_factory)
+{
+    maxzip::basic_compressor<Codec, Level> compressor;
+    maxzip::basic_decompressor<Codec> decompressor;
+    std::unique_ptr<maxzip::decompressor> reference(decompressor_factory());
+    std::vector<uint8_t> compressed;
+    std::vector<uint8_t> decompressed;
+    for (size_t i = 0; i < 200; i++)
+    {
+        // small records, as in a tight per-message loop
+        const std::vector<uint8_t> record = (i == 0) ? std::vector<uint8_t>() : make_message(i);
+        compressed.resize(compressor.bound(record.size()));
+        compressed.resize(compressor.compress(record.data(), record.size(), compressed.data(), compressed.size()));
+        decompressed.resize(record.size());
+        MAXTEST_ASSERT(decompressor.decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == record.size());
+        MAXTEST_ASSERT(decompressed == record);
+        if (!record.empty())
+        {
+            MAXTEST_ASSERT(reference->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == record.size());
+            MAXTEST_ASSERT(decompressed == record);
+        }
+    }
+
+    const std::vector<uint8_t> record = make_message(1000);
+    compressed.resize(compressor.bound(record.size()));
+    MAXTEST_ASSERT(!try_func([&]() { compressor.compress(record.data(), record.size(), compressed.data(), 4); }));
+    compressed.resize(compressor.compress(record.data(), record.size(), compressed.data(), compressed.size()));
+    decompressed.resize(record.size());
+    MAXTEST_ASSERT(!try_func([&]() { decompressor.decompress(compressed.data(), compressed.size() - 2, decompressed.data(), decompressed.size()); }));
+    MAXTEST_ASSERT(!try_func([&]() { decompressor.decompress(compressed.data(), compressed.size(), decompressed.data(), 8); }));
+    // a failed call leaves the codec usable
+    MAXTEST_ASSERT(decompressor.decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == record.size());
+    MAXTEST_ASSERT(decompressed == record);
+
+    std::unique_ptr<maxzip::compressor> adapted(maxzip::create_basic_compressor<Codec, Level>());
+    std::unique_ptr<maxzip::decompressor> adapted_decompressor(maxzip::create_basic_decompressor<Codec>());
+    test_block_compression(adapted, adapted_decompressor);
+}
+
+static void test_try_calls(maxzip::compressor *compressor, maxzip::decompressor *decompressor, bool size_recorded, maxzip::status truncated_status)
+{
+    const std::vector<uint8_t> input = make_corpus(20000);
+
+    // an undersized buffer reports the space needed instead of throwing
+    std::vector<uint8_t> compressed(16);
+    maxzip::codec_result result = compressor->try_compress(input.data(), input.size(), compressed.data(), compressed.size());
+    MAXTEST_ASSERT(!result);
+    MAXTEST_ASSERT(result.status == maxzip::status::insufficient_output);
+    size_t bound(0);
+    compressor->compress(input.data(), input.size(), nullptr, bound);
+    MAXTEST_ASSERT(result.size == bound);
+    compressed.resize(result.size);
+    result = compressor->try_compress(input.data(), input.size(), compressed.data(), compressed.size());
+    MAXTEST_ASSERT(result);
+    MAXTEST_ASSERT(result.status == maxzip::status::ok);
+    compressed.resize(result.size);
+
+    std::vector<uint8_t> decompressed(16);
+    result = decompressor->try_decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+    MAXTEST_ASSERT(result.status == maxzip::status::insufficient_output);
+    MAXTEST_ASSERT(result.size == (size_recorded ? input.size() : 0));
+    decompressed.resize(input.size());
+    result = decompressor->try_decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+    MAXTEST_ASSERT(result.status == maxzip::status::ok);
+    MAXTEST_ASSERT(result.size == input.size());
+    MAXTEST_ASSERT(decompressed == input);
+
+    result = decompressor->try_decompress(compressed.data(), compressed.size() / 2, decompressed.data(), decompressed.size());
+    MAXTEST_ASSERT(result.status == truncated_status);
+    MAXTEST_ASSERT(result.size == 0);
+    result = decompressor->try_decompress(input.data(), input.size(), decompressed.data(), decompressed.size());
+    MAXTEST_ASSERT(!result);
+    MAXTEST_ASSERT(result.size == 0);
+
+    // the throwing calls report the same failures
+    MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(compressed.data(), compressed.size() / 2, decompressed.data(), decompressed.size()); }));
+    MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == input.size());
+}
+
+static std::vector<uint8_t> compress_block(maxzip::compressor *compressor, const std::vector<uint8_t> &input)
+{
+    std::vector<uint8_t> compressed;
+    compressor->compress_to(input.data(), input.size(), compressed);
+    return compressed;
+}
+
+static std::vector<maxzip::input_buffer> split_input(const std::vector<uint8_t> &data, const std::vector<size_t> &sizes)
+{
+    std::vector<maxzip::input_buffer> buffers;
+    size_t offset(0);
+    for (const size_t size : sizes)
+    {
+        const size_t step = std::min(size, data.size() - offset);
+        buffers.push_back({data.data() + offset, step});
+        offset += step;
+    }
+    buffers.push_back({data.data() + offset, data.size() - offset});
+    return buffers;
+}
+
+static std::vector<maxzip::output_buffer> split_output(std::vector<uint8_t> &data, const std::vector<size_t> &sizes)
+{
+    std::vector<maxzip::output_buffer> buffers;
+    size_t offset(0);
+    for (const size_t size : sizes)
+    {
+        const size_t step = std::min(size, data.size() - offset);
+        buffers.push_back({data.data() + offset, step});
+        offset += step;
+    }
+    buffers.push_back({data.data() + offset, data.size() - offset});
+    return buffers;
+}
+
 MAXTEST_MAIN
 {
     MAXTEST_TEST_CASE(brotli::block)
@@ -141,6 +869,31 @@ MAXTEST_MAIN
         auto decompressor_result = try_create_decompressor(maxzip::create_brotli_decompressor, maxzip::brotli_decompressor_params{});
         MAXTEST_ASSERT(decompressor_result.first && (decompressor_result.second != nullptr));
         test_block_compression(compressor_result.second, decompressor_result.second);
+
+        // repeated calls reuse cached state, including across quality levels and
+        // incompressible input that has to fit within the bound
+        std::vector<uint8_t> input_data(65536);
+        for (size_t i = 0; i < input_data.size(); i++)
+        {
+            input_data[i] = static_cast<uint8_t>((i * 2654435761u) >> 13);
+        }
+        for (int quality : {1, 5, 11, 5})
+        {
+            params.quality = quality;
+            std::unique_ptr<maxzip::compressor> compressor(maxzip::create_brotli_compressor(params));
+            for (int pass = 0; pass < 2; pass++)
+            {
+                size_t compressed_size(0);
+                compressor->compress(input_data.data(), input_data.size(), nullptr, compressed_size);
+                std::vector<uint8_t> compressed_data(compressed_size);
+                MAXTEST_ASSERT(try_func([&]() {
+                    compressed_size = compressor->compress(input_data.data(), input_data.size(), compressed_data.data(), compressed_size);
+                }));
+                std::vector<uint8_t> decompressed_data(input_data.size());
+                MAXTEST_ASSERT(decompressor_result.second->decompress(compressed_data.data(), compressed_size, decompressed_data.data(), decompressed_data.size()) == input_data.size());
+                MAXTEST_ASSERT(decompressed_data == input_data);
+            }
+        }
     };
 
     MAXTEST_TEST_CASE(zlib::block)
@@ -160,6 +913,30 @@ MAXTEST_MAIN
         auto decompressor_result = try_create_decompressor(maxzip::create_zlib_decompressor, decompress_params);
         MAXTEST_ASSERT(decompressor_result.first && (decompressor_result.second != nullptr));
         test_block_compression(compressor_result.second, decompressor_result.second);
+
+        // the unit build splits buffers into 64 KiB chunks, so incompressible
+        // data spans several input chunks and an undersized output fills up
+        // before the last one
+        std::vector<uint8_t> noise(1 << 18);
+        uint64_t state(31);
+        for (uint8_t &byte : noise)
+        {
+            state = state * 6364136223846793005 + 1442695040888963407;
+            byte = static_cast<uint8_t>(state >> 56);
+        }
+        const std::vector<uint8_t> compressed = compress_block(compressor_result.second.get(), noise);
+        MAXTEST_ASSERT(compressed.size() > 3 * (1 << 16));
+        std::vector<uint8_t> decompressed(noise.size());
+        for (const size_t size : {noise.size() / 2, noise.size() - 1})
+        {
+            const maxzip::codec_result result = decompressor_result.second->try_decompress(compressed.data(), compressed.size(), decompressed.data(), size);
+            MAXTEST_ASSERT(result.status == maxzip::status::insufficient_output);
+            MAXTEST_ASSERT(!try_func([&]() { decompressor_result.second->decompress(compressed.data(), compressed.size(), decompressed.data(), size); }));
+        }
+        MAXTEST_ASSERT(decompressor_result.second->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == noise.size());
+        MAXTEST_ASSERT(decompressed == noise);
+        const maxzip::codec_result truncated = decompressor_result.second->try_decompress(compressed.data(), compressed.size() / 2, decompressed.data(), decompressed.size());
+        MAXTEST_ASSERT(truncated.status == maxzip::status::corrupt_input);
     };
 
     MAXTEST_TEST_CASE(zstd::block)
@@ -184,4 +961,1169 @@ MAXTEST_MAIN
         MAXTEST_ASSERT(decompressor_result.first && (decompressor_result.second != nullptr));
         test_block_compression(compressor_result.second, decompressor_result.second);
     };
-}
\ No newline at end of file
+
+    MAXTEST_TEST_CASE(brotli::stream)
+    {
+        maxzip::brotli_compressor_params params;
+        params.quality = -100;
+        MAXTEST_ASSERT(!try_func([&]() {
+            std::unique_ptr<maxzip::encoder> encoder(maxzip::create_brotli_encoder(params));
+        }));
+        params.quality.reset();
+        std::unique_ptr<maxzip::encoder> encoder(maxzip::create_brotli_encoder(params));
+        std::unique_ptr<maxzip::decoder> decoder(maxzip::create_brotli_decoder());
+        test_stream_compression(encoder, decoder);
+    };
+
+    MAXTEST_TEST_CASE(zlib::stream)
+    {
+        maxzip::zlib_compressor_params params;
+        params.level = -100;
+        MAXTEST_ASSERT(!try_func([&]() {
+            std::unique_ptr<maxzip::encoder> encoder(maxzip::create_zlib_encoder(params));
+        }));
+        params.level.reset();
+        std::unique_ptr<maxzip::encoder> encoder(maxzip::create_zlib_encoder(params));
+        std::unique_ptr<maxzip::decoder> decoder(maxzip::create_zlib_decoder());
+        test_stream_compression(encoder, decoder);
+    };
+
+    MAXTEST_TEST_CASE(zstd::stream)
+    {
+        maxzip::zstd_compressor_params params;
+        params.window_log = -100;
+        MAXTEST_ASSERT(!try_func([&]() {
+            std::unique_ptr<maxzip::encoder> encoder(maxzip::create_zstd_encoder(params));
+        }));
+        params.window_log.reset();
+        params.enable_checksum = true;
+        std::unique_ptr<maxzip::encoder> encoder(maxzip::create_zstd_encoder(params));
+        std::unique_ptr<maxzip::decoder> decoder(maxzip::create_zstd_decoder());
+        test_stream_compression(encoder, decoder);
+    };
+
+    MAXTEST_TEST_CASE(parallel::block)
+    {
+        test_parallel_compression(
+            []() { return maxzip::create_brotli_compressor(); },
+            []() { return maxzip::create_brotli_decompressor(); });
+        test_parallel_compression(
+            []() { return maxzip::create_zlib_compressor(); },
+            []() { return maxzip::create_zlib_decompressor(); });
+        test_parallel_compression(
+            []() { return maxzip::create_zstd_compressor(); },
+            []() { return maxzip::create_zstd_decompressor(); });
+    };
+
+    MAXTEST_TEST_CASE(seekable::block)
+    {
+        test_seekable_compression(
+            []() { return maxzip::create_brotli_compressor(); },
+            []() { return maxzip::create_brotli_decompressor(); });
+        test_seekable_compression(
+            []() { return maxzip::create_zlib_compressor(); },
+            []() { return maxzip::create_zlib_decompressor(); });
+        test_seekable_compression(
+            []() { return maxzip::create_zstd_compressor(); },
+            []() { return maxzip::create_zstd_decompressor(); });
+
+        // seekable zstd output is still a valid zstd stream
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_seekable_compressor(
+            []() { return maxzip::create_zstd_compressor(); }));
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_zstd_decompressor());
+        std::vector<uint8_t> input_data(200000, 0x5A);
+        size_t compressed_size(0);
+        compressor->compress(input_data.data(), input_data.size(), nullptr, compressed_size);
+        std::vector<uint8_t> compressed_data(compressed_size);
+        compressed_size = compressor->compress(input_data.data(), input_data.size(), compressed_data.data(), compressed_size);
+        std::vector<uint8_t> decompressed_data(input_data.size());
+        MAXTEST_ASSERT(decompressor->decompress(compressed_data.data(), compressed_size, decompressed_data.data(), decompressed_data.size()) == input_data.size());
+        MAXTEST_ASSERT(decompressed_data == input_data);
+    };
+
+    MAXTEST_TEST_CASE(allocator::hooks)
+    {
+        test_allocator_hooks(
+            maxzip::create_brotli_compressor,
+            maxzip::create_brotli_decompressor,
+            maxzip::create_brotli_encoder,
+            maxzip::create_brotli_decoder);
+        test_allocator_hooks(
+            maxzip::create_zlib_compressor,
+            maxzip::create_zlib_decompressor,
+            maxzip::create_zlib_encoder,
+            maxzip::create_zlib_decoder);
+        test_allocator_hooks(
+            maxzip::create_zstd_compressor,
+            maxzip::create_zstd_decompressor,
+            maxzip::create_zstd_encoder,
+            maxzip::create_zstd_decoder);
+    };
+
+    MAXTEST_TEST_CASE(dictionary::block)
+    {
+        const std::vector<uint8_t> content = make_dictionary();
+        MAXTEST_ASSERT(!content.empty());
+        MAXTEST_ASSERT(!try_func([&]() {
+            uint8_t sample = 0;
+            size_t sample_size = 1;
+            uint8_t output[64];
+            maxzip::train_dictionary(&sample, &sample_size, 1, output, sizeof(output));
+        }));
+
+        std::shared_ptr<maxzip::dictionary> dictionary(maxzip::create_dictionary(content.data(), content.size()));
+        MAXTEST_ASSERT(dictionary->id() != 0);
+        test_dictionary(maxzip::create_zlib_compressor, maxzip::create_zlib_decompressor, dictionary);
+        test_dictionary(maxzip::create_zstd_compressor, maxzip::create_zstd_decompressor, dictionary);
+
+        // brotli dictionaries need brotli 1.1.0, which the vendored build uses
+#if MAXZIP_BROTLI_DICTIONARY
+        test_dictionary(maxzip::create_brotli_compressor, maxzip::create_brotli_decompressor, dictionary);
+#else
+        maxzip::brotli_compressor_params params;
+        params.dictionary = dictionary;
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_brotli_compressor(params)); }));
+#endif
+
+        // a zstd frame that needs a dictionary cannot be decoded without it
+        maxzip::zstd_compressor_params compress_params;
+        compress_params.dictionary = dictionary;
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_zstd_compressor(compress_params));
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_zstd_decompressor());
+        MAXTEST_ASSERT(!try_func([&]() { compressed_message_size(compressor, decompressor, make_message(1)); }));
+    };
+
+    MAXTEST_TEST_CASE(dictionary::cache)
+    {
+        const std::vector<uint8_t> content = make_dictionary();
+        maxzip::dictionary_cache cache;
+        std::vector<std::shared_ptr<maxzip::dictionary>> loaded(8);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < loaded.size(); i++)
+        {
+            threads.emplace_back([&, i]() { loaded[i] = cache.load(content.data(), content.size()); });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        MAXTEST_ASSERT(cache.size() == 1);
+        for (const std::shared_ptr<maxzip::dictionary> &dictionary : loaded)
+        {
+            MAXTEST_ASSERT(dictionary == loaded.front());
+        }
+        MAXTEST_ASSERT(cache.find(loaded.front()->id()) == loaded.front());
+        MAXTEST_ASSERT(!try_func([&]() { cache.load(nullptr, 0); }));
+
+        std::vector<uint8_t> raw_content(content.begin() + 8, content.end());
+        std::shared_ptr<maxzip::dictionary> raw = cache.load(raw_content.data(), raw_content.size());
+        MAXTEST_ASSERT(cache.size() == 2);
+        test_dictionary(maxzip::create_zlib_compressor, maxzip::create_zlib_decompressor, raw);
+
+        cache.erase(raw->id());
+        MAXTEST_ASSERT(cache.size() == 1);
+        MAXTEST_ASSERT(cache.find(raw->id()) == nullptr);
+    };
+
+    MAXTEST_TEST_CASE(batch::block)
+    {
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_brotli_compressor());
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_brotli_decompressor());
+        test_batch_compression(compressor.get(), decompressor.get());
+        compressor.reset(maxzip::create_zlib_compressor());
+        decompressor.reset(maxzip::create_zlib_decompressor());
+        test_batch_compression(compressor.get(), decompressor.get());
+        compressor.reset(maxzip::create_zstd_compressor());
+        decompressor.reset(maxzip::create_zstd_decompressor());
+        test_batch_compression(compressor.get(), decompressor.get());
+
+        // wrappers fall back to the generic batch loop
+        maxzip::parallel_compressor_params compress_params;
+        compress_params.chunk_size = 4096;
+        compress_params.thread_count = 2;
+        compressor.reset(maxzip::create_parallel_compressor([]() { return maxzip::create_zstd_compressor(); }, compress_params));
+        decompressor.reset(maxzip::create_parallel_decompressor([]() { return maxzip::create_zstd_decompressor(); }));
+        test_batch_compression(compressor.get(), decompressor.get());
+    };
+
+    MAXTEST_TEST_CASE(pool::lease)
+    {
+        maxzip::context_pool_params params;
+        params.max_size = 0;
+        MAXTEST_ASSERT(!try_func([&]() { maxzip::compressor_pool pool([]() { return maxzip::create_zstd_compressor(); }, params); }));
+        params.max_size = 2;
+        params.initial_size = 3;
+        MAXTEST_ASSERT(!try_func([&]() { maxzip::compressor_pool pool([]() { return maxzip::create_zstd_compressor(); }, params); }));
+        MAXTEST_ASSERT(!try_func([&]() { maxzip::compressor_pool pool(nullptr); }));
+
+        params.max_size = 4;
+        params.initial_size = 2;
+        maxzip::compressor_pool compressors([]() { return maxzip::create_zstd_compressor(); }, params);
+        maxzip::decompressor_pool decompressors([]() { return maxzip::create_zstd_decompressor(); }, params);
+        MAXTEST_ASSERT(compressors.size() == 2);
+        MAXTEST_ASSERT(compressors.capacity() == 4);
+
+        maxzip::compressor *first(nullptr);
+        {
+            maxzip::compressor_pool::lease lease = compressors.acquire();
+            MAXTEST_ASSERT(lease);
+            MAXTEST_ASSERT(compressors.size() == 1);
+            first = lease.get();
+            maxzip::compressor_pool::lease moved(std::move(lease));
+            MAXTEST_ASSERT(!lease);
+            MAXTEST_ASSERT(moved.get() == first);
+        }
+        MAXTEST_ASSERT(compressors.size() == 2);
+        MAXTEST_ASSERT(compressors.acquire().get() == first);
+
+        // leases beyond the maximum size are destroyed on return
+        {
+            std::vector<maxzip::compressor_pool::lease> leases;
+            for (size_t i = 0; i < 6; i++)
+            {
+                leases.push_back(compressors.acquire());
+            }
+            MAXTEST_ASSERT(compressors.size() == 0);
+        }
+        MAXTEST_ASSERT(compressors.size() == 4);
+
+        std::vector<std::thread> threads;
+        std::vector<int> results(8, 0);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            threads.emplace_back([&, i]() {
+                bool ok = true;
+                for (size_t j = 0; j < 200; j++)
+                {
+                    const std::vector<uint8_t> message = make_message(i * 1000 + j);
+                    maxzip::compressor_pool::lease compressor = compressors.acquire();
+                    maxzip::decompressor_pool::lease decompressor = decompressors.acquire();
+                    size_t compressed_size(0);
+                    compressor->compress(message.data(), message.size(), nullptr, compressed_size);
+                    std::vector<uint8_t> compressed(compressed_size);
+                    compressed_size = compressor->compress(message.data(), message.size(), compressed.data(), compressed_size);
+                    std::vector<uint8_t> decompressed(message.size());
+                    ok = ok && decompressor->decompress(compressed.data(), compressed_size, decompressed.data(), decompressed.size()) == message.size();
+                    ok = ok && decompressed == message;
+                }
+                results[i] = ok;
+            });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        for (int result : results)
+        {
+            MAXTEST_ASSERT(result);
+        }
+        MAXTEST_ASSERT(compressors.size() <= compressors.capacity());
+    };
+
+    MAXTEST_TEST_CASE(adaptive::block)
+    {
+        maxzip::adaptive_compressor_params params;
+        params.min_throughput = 100.0;
+        params.min_ratio = 2.0;
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_adaptive_compressor(params)); }));
+        params.min_throughput.reset();
+        params.min_ratio = -1.0;
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_adaptive_compressor(params)); }));
+
+        std::vector<uint8_t> text;
+        for (size_t i = 0; i < 200; i++)
+        {
+            const std::vector<uint8_t> message = make_message(i);
+            text.insert(text.end(), message.begin(), message.end());
+        }
+        std::vector<uint8_t> noise(4096);
+        uint32_t state(12345);
+        for (uint8_t &value : noise)
+        {
+            state = state * 1103515245 + 12345;
+            value = static_cast<uint8_t>(state >> 24);
+        }
+
+        params.min_ratio.reset();
+        params.probe_budget = -1.0;
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_adaptive_compressor(params)); }));
+
+        // the fastest setting is zstd level 1, and the strongest is the smallest output
+        const std::vector<std::pair<uint8_t, size_t>> settings = adaptive_settings(text);
+        const std::pair<uint8_t, size_t> fastest = settings.front();
+        const std::pair<uint8_t, size_t> strongest = *std::min_element(settings.begin(), settings.end(), [](const std::pair<uint8_t, size_t> &a, const std::pair<uint8_t, size_t> &b) { return a.second < b.second; });
+        MAXTEST_ASSERT(fastest.first == 0xB3);
+
+        struct policy
+        {
+            std::optional<double> min_throughput;
+            std::optional<double> min_ratio;
+            std::optional<double> probe_budget;
+            std::pair<uint8_t, size_t> expected;
+        };
+        const policy policies[] = {
+            // a reachable ratio is met by the fastest setting
+            {std::nullopt, 1.01, 60.0, fastest},
+            // an unreachable ratio walks to the strongest setting
+            {std::nullopt, 1000.0, 60.0, strongest},
+            // a throughput every setting meets picks the best ratio
+            {0.001, std::nullopt, 60.0, strongest},
+            // an unreachable throughput keeps the fastest setting
+            {1e12, std::nullopt, 60.0, fastest},
+            // without a probe budget nothing but the setting in use is measured
+            {0.001, std::nullopt, 0.0, fastest},
+        };
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_adaptive_decompressor());
+        for (const policy &policy : policies)
+        {
+            params.min_throughput = policy.min_throughput;
+            params.min_ratio = policy.min_ratio;
+            params.probe_budget = policy.probe_budget;
+            params.probe_interval = 4;
+            std::unique_ptr<maxzip::compressor> compressor(maxzip::create_adaptive_compressor(params));
+            for (size_t i = 0; i < 10; i++)
+            {
+                const std::vector<uint8_t> compressed = adaptive_round_trip(compressor.get(), decompressor.get(), text);
+                MAXTEST_ASSERT(compressed[0] == policy.expected.first);
+                MAXTEST_ASSERT(compressed.size() == policy.expected.second);
+            }
+            MAXTEST_ASSERT(adaptive_round_trip(compressor.get(), decompressor.get(), noise)[0] == 0xB0);
+            MAXTEST_ASSERT(adaptive_round_trip(compressor.get(), decompressor.get(), std::vector<uint8_t>())[0] == 0xB0);
+        }
+
+        params = maxzip::adaptive_compressor_params();
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_adaptive_compressor(params));
+        for (size_t i = 0; i < 200; i++)
+        {
+            const std::vector<uint8_t> compressed = adaptive_round_trip(compressor.get(), decompressor.get(), text);
+            MAXTEST_ASSERT(compressed[0] >= 0xB1 && compressed[0] <= 0xB3);
+        }
+
+        const uint8_t invalid[] = {0xC3, 0x00};
+        std::vector<uint8_t> output(16);
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(invalid, sizeof(invalid), output.data(), output.size()); }));
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(invalid, 0, output.data(), output.size()); }));
+    };
+
+    MAXTEST_TEST_CASE(owned::buffer)
+    {
+        // highly compressible input forces several growth steps when the size is unknown
+        std::vector<uint8_t> input(1 << 20);
+        for (size_t i = 0; i < input.size(); i++)
+        {
+            input[i] = static_cast<uint8_t>((i / 4096) % 7);
+        }
+
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_brotli_compressor());
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_brotli_decompressor());
+        MAXTEST_ASSERT(!decompressor->decompressed_size(input.data(), input.size()));
+        test_owned_buffers(compressor.get(), decompressor.get(), input);
+        compressor.reset(maxzip::create_zlib_compressor());
+        decompressor.reset(maxzip::create_zlib_decompressor());
+        test_owned_buffers(compressor.get(), decompressor.get(), input);
+        compressor.reset(maxzip::create_zstd_compressor());
+        decompressor.reset(maxzip::create_zstd_decompressor());
+        test_owned_buffers(compressor.get(), decompressor.get(), input);
+
+        std::vector<uint8_t> compressed;
+        compressor->compress_to(input.data(), input.size(), compressed);
+        MAXTEST_ASSERT(decompressor->decompressed_size(compressed.data(), compressed.size()) == input.size());
+
+        // a zstd stream written without a pledged size has no content size
+        std::unique_ptr<maxzip::encoder> encoder(maxzip::create_zstd_encoder());
+        const std::vector<uint8_t> streamed = stream_encode(encoder, input);
+        MAXTEST_ASSERT(!decompressor->decompressed_size(streamed.data(), streamed.size()));
+        std::vector<uint8_t> decompressed;
+        MAXTEST_ASSERT(decompressor->decompress_to(streamed.data(), streamed.size(), decompressed) == input.size());
+        MAXTEST_ASSERT(decompressed == input);
+
+        maxzip::parallel_compressor_params parallel_params;
+        parallel_params.chunk_size = 1 << 16;
+        compressor.reset(maxzip::create_parallel_compressor([]() { return maxzip::create_zlib_compressor(); }, parallel_params));
+        decompressor.reset(maxzip::create_parallel_decompressor([]() { return maxzip::create_zlib_decompressor(); }));
+        test_owned_buffers(compressor.get(), decompressor.get(), input);
+        compressor.reset(maxzip::create_seekable_compressor([]() { return maxzip::create_brotli_compressor(); }));
+        decompressor.reset(maxzip::create_seekable_decompressor([]() { return maxzip::create_brotli_decompressor(); }));
+        test_owned_buffers(compressor.get(), decompressor.get(), input);
+        compressor.reset(maxzip::create_adaptive_compressor());
+        decompressor.reset(maxzip::create_adaptive_decompressor());
+        test_owned_buffers(compressor.get(), decompressor.get(), input);
+    };
+
+    MAXTEST_TEST_CASE(owned::oversized)
+    {
+        // a 16-byte zstd frame whose header claims 64 GiB followed by an empty last block
+        const std::vector<uint8_t> frame = {0x28, 0xB5, 0x2F, 0xFD, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00};
+        std::vector<uint8_t> output;
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_zstd_decompressor());
+        MAXTEST_ASSERT(!decompressor->decompressed_size(frame.data(), frame.size()));
+        MAXTEST_ASSERT(rejects_input([&]() { decompressor->decompress_to(frame.data(), frame.size(), output); }));
+        MAXTEST_ASSERT(decompressor->try_decompress(frame.data(), frame.size(), output.data(), 0).size == 0);
+
+        // a parallel frame claiming 64 chunks of 1 GiB, each holding the frame above
+        std::vector<uint8_t> parallel = {'M', 'X', 'Z', 'P', 1, 0, 0, 0, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00};
+        for (size_t i = 0; i < 64; i++)
+        {
+            const uint8_t entry[] = {static_cast<uint8_t>(frame.size()), 0, 0, 0};
+            parallel.insert(parallel.end(), entry, entry + sizeof(entry));
+        }
+        for (size_t i = 0; i < 64; i++)
+        {
+            parallel.insert(parallel.end(), frame.begin(), frame.end());
+        }
+        decompressor.reset(maxzip::create_parallel_decompressor([]() { return maxzip::create_zstd_decompressor(); }));
+        MAXTEST_ASSERT(!decompressor->decompressed_size(parallel.data(), parallel.size()));
+        MAXTEST_ASSERT(rejects_input([&]() { decompressor->decompress_to(parallel.data(), parallel.size(), output); }));
+
+        // a seek table claiming 4 GiB for the same frame
+        std::vector<uint8_t> seekable(frame);
+        const uint8_t table[] = {0x5E, 0x2A, 0x4D, 0x18, 0x11, 0x00, 0x00, 0x00,
+                                 0x10, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+                                 0x01, 0x00, 0x00, 0x00, 0x00, 0xB1, 0xEA, 0x92, 0x8F};
+        seekable.insert(seekable.end(), table, table + sizeof(table));
+        std::unique_ptr<maxzip::seekable_decompressor> seekable_decompressor(maxzip::create_seekable_decompressor([]() { return maxzip::create_zstd_decompressor(); }));
+        MAXTEST_ASSERT(!seekable_decompressor->decompressed_size(seekable.data(), seekable.size()));
+        MAXTEST_ASSERT(seekable_decompressor->size() == 0xFFFFFFFF);
+        MAXTEST_ASSERT(rejects_input([&]() { seekable_decompressor->decompress_to(seekable.data(), seekable.size(), output); }));
+        uint8_t buffer[16];
+        MAXTEST_ASSERT(rejects_input([&]() { seekable_decompressor->read(0, sizeof(buffer), buffer); }));
+    };
+
+    MAXTEST_TEST_CASE(zlib::large)
+    {
+        // more than 4 GiB of zeros; untouched calloc pages cost no physical memory
+        const size_t size = (size_t(1) << 32) + (size_t(1) << 20) + 7;
+        std::unique_ptr<uint8_t, decltype(&std::free)> input(static_cast<uint8_t *>(std::calloc(size, 1)), &std::free);
+        MAXTEST_ASSERT(input != nullptr);
+
+        maxzip::zlib_compressor_params params;
+        params.level = 1;
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_zlib_compressor(params));
+        size_t bound(0);
+        compressor->compress(input.get(), size, nullptr, bound);
+        MAXTEST_ASSERT(bound > size);
+        std::unique_ptr<uint8_t, decltype(&std::free)> output(static_cast<uint8_t *>(std::calloc(bound, 1)), &std::free);
+        MAXTEST_ASSERT(output != nullptr);
+        const size_t compressed_size = compressor->compress(input.get(), size, output.get(), bound);
+        MAXTEST_ASSERT(compressed_size > 0 && compressed_size < size / 100);
+        const std::vector<uint8_t> compressed(output.get(), output.get() + compressed_size);
+        output.reset();
+        input.reset();
+
+        std::unique_ptr<maxzip::decoder> decoder(maxzip::create_zlib_decoder());
+        std::vector<uint8_t> buffer(1 << 20);
+        size_t offset(0);
+        size_t total(0);
+        bool zeros(true);
+        bool finished(false);
+        decoder->init();
+        while (!finished)
+        {
+            size_t output_size = buffer.size();
+            if (offset < compressed.size())
+            {
+                offset += decoder->update(compressed.data() + offset, compressed.size() - offset, buffer.data(), output_size);
+            }
+            else
+            {
+                finished = decoder->finish(buffer.data(), output_size);
+            }
+            zeros = zeros && std::all_of(buffer.begin(), buffer.begin() + output_size, [](uint8_t value) { return value == 0; });
+            total += output_size;
+        }
+        MAXTEST_ASSERT(total == size);
+        MAXTEST_ASSERT(zeros);
+
+        // single-call decompression of the same data needs the full output in memory
+        if (std::getenv("MAXZIP_LARGE_TESTS") != nullptr)
+        {
+            std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_zlib_decompressor());
+            output.reset(static_cast<uint8_t *>(std::malloc(size)));
+            MAXTEST_ASSERT(output != nullptr);
+            MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed.size(), output.get(), size) == size);
+            MAXTEST_ASSERT(std::all_of(output.get(), output.get() + size, [](uint8_t value) { return value == 0; }));
+        }
+    };
+
+    MAXTEST_TEST_CASE(file::block)
+    {
+        std::vector<uint8_t> input;
+        for (size_t i = 0; i < 5000; i++)
+        {
+            const std::vector<uint8_t> message = make_message(i);
+            input.insert(input.end(), message.begin(), message.end());
+        }
+
+        // zstd records the decompressed size, brotli and zlib do not
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_zstd_compressor());
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_zstd_decompressor());
+        test_file_compression(*compressor, *decompressor, input);
+        test_file_compression(*compressor, *decompressor, std::vector<uint8_t>());
+        compressor.reset(maxzip::create_brotli_compressor());
+        decompressor.reset(maxzip::create_brotli_decompressor());
+        test_file_compression(*compressor, *decompressor, input);
+        compressor.reset(maxzip::create_zlib_compressor());
+        decompressor.reset(maxzip::create_zlib_decompressor());
+        test_file_compression(*compressor, *decompressor, input);
+
+        // a decoder streams the output through a fixed buffer
+        const std::string directory = std::filesystem::temp_directory_path().string();
+        const std::string input_path = directory + "/maxzip_unit_stream_input";
+        const std::string compressed_path = directory + "/maxzip_unit_stream_compressed";
+        const std::string output_path = directory + "/maxzip_unit_stream_output";
+        write_test_file(input_path, input);
+        std::vector<std::pair<maxzip::compressor_factory, std::function<maxzip::decoder *()>>> streams;
+        streams.emplace_back([]() { return maxzip::create_brotli_compressor(); }, []() { return maxzip::create_brotli_decoder(); });
+        streams.emplace_back([]() { return maxzip::create_zlib_compressor(); }, []() { return maxzip::create_zlib_decoder(); });
+        streams.emplace_back([]() { return maxzip::create_zstd_compressor(); }, []() { return maxzip::create_zstd_decoder(); });
+        for (const auto &[compressor_factory, decoder_factory] : streams)
+        {
+            std::unique_ptr<maxzip::compressor> stream_compressor(compressor_factory());
+            std::unique_ptr<maxzip::decoder> decoder(decoder_factory());
+            const size_t compressed_size = maxzip::compress_file(input_path, compressed_path, *stream_compressor);
+            MAXTEST_ASSERT(maxzip::decompress_file(compressed_path, output_path, *decoder) == input.size());
+            MAXTEST_ASSERT(read_test_file(output_path) == input);
+            std::filesystem::remove(output_path);
+            std::filesystem::resize_file(compressed_path, compressed_size / 2);
+            MAXTEST_ASSERT(!try_func([&]() { maxzip::decompress_file(compressed_path, output_path, *decoder); }));
+            MAXTEST_ASSERT(!std::filesystem::exists(output_path));
+            MAXTEST_ASSERT(!try_func([&]() { maxzip::decompress_file(compressed_path, compressed_path, *decoder); }));
+        }
+        std::filesystem::remove(input_path);
+        std::filesystem::remove(compressed_path);
+
+        const std::string missing = (std::filesystem::temp_directory_path() / "maxzip_unit_missing").string();
+        MAXTEST_ASSERT(!try_func([&]() { maxzip::compress_file(missing, missing + ".out", *compressor); }));
+    };
+
+    MAXTEST_TEST_CASE(pipeline::stream)
+    {
+        test_pipeline(
+            []() { return maxzip::create_brotli_compressor(); },
+            []() { return maxzip::create_brotli_decompressor(); });
+        test_pipeline(
+            []() { return maxzip::create_zlib_compressor(); },
+            []() { return maxzip::create_zlib_decompressor(); });
+        test_pipeline(
+            []() { return maxzip::create_zstd_compressor(); },
+            []() { return maxzip::create_zstd_decompressor(); });
+    };
+
+    MAXTEST_TEST_CASE(metrics::counters)
+    {
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::instrumented_compressor>(maxzip::create_instrumented_compressor(nullptr, "null")); }));
+
+        std::unique_ptr<maxzip::instrumented_compressor> compressor(maxzip::create_instrumented_compressor(maxzip::create_zstd_compressor(), "unit-zstd"));
+        std::unique_ptr<maxzip::instrumented_decompressor> decompressor(maxzip::create_instrumented_decompressor(maxzip::create_zstd_decompressor(), "unit-zstd"));
+        std::vector<uint8_t> input;
+        for (size_t i = 0; i < 100; i++)
+        {
+            const std::vector<uint8_t> message = make_message(i);
+            input.insert(input.end(), message.begin(), message.end());
+        }
+        std::vector<uint8_t> compressed;
+        std::vector<uint8_t> decompressed;
+        for (size_t i = 0; i < 10; i++)
+        {
+            compressor->compress_to(input.data(), input.size(), compressed);
+            decompressor->decompress_to(compressed.data(), compressed.size(), decompressed);
+        }
+        MAXTEST_ASSERT(decompressed == input);
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(input.data(), input.size(), decompressed.data(), decompressed.size()); }));
+
+        const maxzip::codec_metrics compression = compressor->metrics();
+        const maxzip::codec_metrics decompression = decompressor->metrics();
+        if (!maxzip::metrics_enabled())
+        {
+            MAXTEST_ASSERT(compression.calls == 0);
+            MAXTEST_ASSERT(maxzip::metrics_snapshot().empty());
+            return;
+        }
+        MAXTEST_ASSERT(compression.calls == 10);
+        MAXTEST_ASSERT(compression.failures == 0);
+        MAXTEST_ASSERT(compression.uncompressed_bytes == 10 * input.size());
+        MAXTEST_ASSERT(compression.compressed_bytes == 10 * compressed.size());
+        MAXTEST_ASSERT(compression.ratio() > 2.0);
+        MAXTEST_ASSERT(compression.latency_percentile(0.5) > 0);
+        MAXTEST_ASSERT(compression.latency_percentile(0.5) <= compression.latency_percentile(1.0));
+        MAXTEST_ASSERT(decompression.calls == 11);
+        MAXTEST_ASSERT(decompression.failures == 1);
+        MAXTEST_ASSERT(decompression.uncompressed_bytes == 10 * input.size());
+
+        // destroyed instances stay in the registry
+        compressor.reset(maxzip::create_instrumented_compressor(maxzip::create_zstd_compressor(), "unit-zstd"));
+        compressor->compress_to(input.data(), input.size(), compressed);
+        std::map<std::string, maxzip::codec_metrics> snapshot = maxzip::metrics_snapshot();
+        MAXTEST_ASSERT(snapshot["unit-zstd.compress"].calls == 11);
+        MAXTEST_ASSERT(snapshot["unit-zstd.decompress"].failures == 1);
+        const std::string json = maxzip::metrics_json();
+        MAXTEST_ASSERT(json.find("\"unit-zstd.compress\":{\"calls\":11,") != std::string::npos);
+    };
+
+    MAXTEST_TEST_CASE(basic::block)
+    {
+        test_basic<maxzip::codec::brotli, 5>([]() { return maxzip::create_brotli_decompressor(); });
+#ifndef MAXZIP_ZLIB_NG
+        test_basic<maxzip::codec::zlib, 6>([]() { return maxzip::create_zlib_decompressor(); });
+#endif
+        test_basic<maxzip::codec::zstd, 1>([]() { return maxzip::create_zstd_decompressor(); });
+        test_basic<maxzip::codec::zstd, -5>([]() { return maxzip::create_zstd_decompressor(); });
+    };
+
+    MAXTEST_TEST_CASE(status::codes)
+    {
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_brotli_compressor());
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_brotli_decompressor());
+        test_try_calls(compressor.get(), decompressor.get(), false, maxzip::status::corrupt_input);
+        compressor.reset(maxzip::create_zlib_compressor());
+        decompressor.reset(maxzip::create_zlib_decompressor());
+        test_try_calls(compressor.get(), decompressor.get(), false, maxzip::status::corrupt_input);
+        compressor.reset(maxzip::create_zstd_compressor());
+        decompressor.reset(maxzip::create_zstd_decompressor());
+        test_try_calls(compressor.get(), decompressor.get(), true, maxzip::status::corrupt_input);
+
+        // wrappers forward to the backend
+        compressor.reset(maxzip::create_instrumented_compressor(maxzip::create_zstd_compressor(), "unit-status"));
+        decompressor.reset(maxzip::create_instrumented_decompressor(maxzip::create_zstd_decompressor(), "unit-status"));
+        test_try_calls(compressor.get(), decompressor.get(), true, maxzip::status::corrupt_input);
+        if (maxzip::metrics_enabled())
+        {
+            MAXTEST_ASSERT(static_cast<maxzip::instrumented_decompressor *>(decompressor.get())->metrics().failures == 4);
+        }
+
+        // and the others fall back to the throwing calls
+        compressor.reset(maxzip::create_parallel_compressor([]() { return maxzip::create_zstd_compressor(); }));
+        decompressor.reset(maxzip::create_parallel_decompressor([]() { return maxzip::create_zstd_decompressor(); }));
+        test_try_calls(compressor.get(), decompressor.get(), true, maxzip::status::failed);
+    };
+
+    MAXTEST_TEST_CASE(lz4::block)
+    {
+        maxzip::lz4_compressor_params compress_params;
+        compress_params.acceleration = 0;
+        auto compressor_result = try_create_compressor(maxzip::create_lz4_compressor, compress_params);
+        MAXTEST_ASSERT(!compressor_result.first && (compressor_result.second == nullptr));
+        compress_params.acceleration = 4;
+        compress_params.level = 9;
+        compressor_result = try_create_compressor(maxzip::create_lz4_compressor, compress_params);
+        MAXTEST_ASSERT(!compressor_result.first && (compressor_result.second == nullptr));
+        compress_params.acceleration.reset();
+        compress_params.level = 13;
+        compressor_result = try_create_compressor(maxzip::create_lz4_compressor, compress_params);
+        MAXTEST_ASSERT(!compressor_result.first && (compressor_result.second == nullptr));
+
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_lz4_compressor());
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_lz4_decompressor());
+        test_block_compression(compressor, decompressor);
+        test_batch_compression(compressor.get(), decompressor.get());
+        test_try_calls(compressor.get(), decompressor.get(), false, maxzip::status::corrupt_input);
+        const std::vector<uint8_t> input = make_corpus(1 << 18);
+        test_owned_buffers(compressor.get(), decompressor.get(), input);
+
+        // LZ4HC writes the same block format
+        compress_params.level = 9;
+        std::shared_ptr<counting_allocator> allocator = std::make_shared<counting_allocator>();
+        compress_params.allocator = allocator;
+        compressor.reset(maxzip::create_lz4_compressor(compress_params));
+        test_block_compression(compressor, decompressor);
+        test_owned_buffers(compressor.get(), decompressor.get(), input);
+        compressor.reset();
+        MAXTEST_ASSERT(allocator->allocations > 0);
+        MAXTEST_ASSERT(allocator->live == 0);
+
+        const std::vector<uint8_t> content = make_dictionary();
+        std::shared_ptr<maxzip::dictionary> dictionary(maxzip::create_dictionary(content.data(), content.size()));
+        test_dictionary(maxzip::create_lz4_compressor, maxzip::create_lz4_decompressor, dictionary);
+
+        // the loaded HC dictionary is reused by every block and freed with the
+        // compressor
+        std::unique_ptr<maxzip::compressor> plain(maxzip::create_lz4_compressor(compress_params));
+        compress_params.dictionary = dictionary;
+        compressor.reset(maxzip::create_lz4_compressor(compress_params));
+        maxzip::lz4_decompressor_params decompress_params;
+        decompress_params.dictionary = dictionary;
+        decompressor.reset(maxzip::create_lz4_decompressor(decompress_params));
+        size_t plain_size(0);
+        size_t dictionary_size(0);
+        for (size_t i = 5000; i < 5010; i++)
+        {
+            const std::vector<uint8_t> message = make_message(i);
+            plain_size += compress_block(plain.get(), message).size();
+            dictionary_size += compressed_message_size(compressor, decompressor, message);
+        }
+        MAXTEST_ASSERT(dictionary_size < plain_size);
+        plain.reset();
+        compressor.reset();
+        MAXTEST_ASSERT(allocator->live == 0);
+    };
+
+    MAXTEST_TEST_CASE(universal::detect)
+    {
+        const std::vector<uint8_t> input = make_corpus(10000);
+        maxzip::zlib_compressor_params gzip_params;
+        gzip_params.window_bits = 15 + 16;
+        std::vector<std::pair<std::unique_ptr<maxzip::compressor>, maxzip::format_detection>> compressors;
+        compressors.emplace_back(maxzip::create_zstd_compressor(), maxzip::format_detection{maxzip::codec::zstd, 0});
+        compressors.emplace_back(maxzip::create_zlib_compressor(), maxzip::format_detection{maxzip::codec::zlib, 0});
+        compressors.emplace_back(maxzip::create_zlib_compressor(gzip_params), maxzip::format_detection{maxzip::codec::zlib, 0});
+        compressors.emplace_back(maxzip::create_enveloped_compressor(maxzip::codec::brotli, maxzip::create_brotli_compressor()), maxzip::format_detection{maxzip::codec::brotli, 1});
+        compressors.emplace_back(maxzip::create_enveloped_compressor(maxzip::codec::lz4, maxzip::create_lz4_compressor()), maxzip::format_detection{maxzip::codec::lz4, 1});
+        compressors.emplace_back(maxzip::create_adaptive_compressor(), maxzip::format_detection{maxzip::codec::stored, 1});
+
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_universal_decompressor());
+        for (const auto &[compressor, expected] : compressors)
+        {
+            const std::vector<uint8_t> compressed = compress_block(compressor.get(), input);
+            const std::optional<maxzip::format_detection> format = maxzip::detect_format(compressed.data(), compressed.size());
+            MAXTEST_ASSERT(format.has_value());
+            MAXTEST_ASSERT(format->header_size == expected.header_size);
+            // the adaptive compressor, listed as stored, picks its own codec
+            if (expected.codec != maxzip::codec::stored)
+            {
+                MAXTEST_ASSERT(format->codec == expected.codec);
+            }
+            std::vector<uint8_t> decompressed(input.size());
+            MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == input.size());
+            MAXTEST_ASSERT(decompressed == input);
+            const maxzip::codec_result result = decompressor->try_decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+            MAXTEST_ASSERT(result && result.size == input.size());
+            decompressed.clear();
+            MAXTEST_ASSERT(decompressor->decompress_to(compressed.data(), compressed.size(), decompressed) == input.size());
+            MAXTEST_ASSERT(decompressed == input);
+        }
+
+        const uint8_t text[] = "plain text";
+        MAXTEST_ASSERT(!maxzip::detect_format(text, sizeof(text)));
+        MAXTEST_ASSERT(!maxzip::detect_format(text, 0));
+        std::vector<uint8_t> output(16);
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(text, sizeof(text), output.data(), output.size()); }));
+        MAXTEST_ASSERT(decompressor->try_decompress(text, sizeof(text), output.data(), output.size()).status == maxzip::status::corrupt_input);
+        MAXTEST_ASSERT(!decompressor->decompressed_size(text, sizeof(text)));
+
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_enveloped_compressor(maxzip::codec::zstd, nullptr)); }));
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_enveloped_compressor(static_cast<maxzip::codec>(16), maxzip::create_zstd_compressor())); }));
+        // a stored envelope would make the compressed bytes decode as raw data
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_enveloped_compressor(maxzip::codec::stored, maxzip::create_zstd_compressor())); }));
+        std::unique_ptr<maxzip::compressor> enveloped(maxzip::create_enveloped_compressor(maxzip::codec::zstd, maxzip::create_zstd_compressor()));
+        std::unique_ptr<maxzip::compressor> plain(maxzip::create_zstd_compressor());
+        size_t enveloped_bound(0);
+        size_t plain_bound(0);
+        enveloped->compress(input.data(), input.size(), nullptr, enveloped_bound);
+        plain->compress(input.data(), input.size(), nullptr, plain_bound);
+        MAXTEST_ASSERT(enveloped_bound == plain_bound + 1);
+        std::vector<uint8_t> compressed(4);
+        maxzip::codec_result result = enveloped->try_compress(input.data(), input.size(), compressed.data(), compressed.size());
+        MAXTEST_ASSERT(result.status == maxzip::status::insufficient_output && result.size == enveloped_bound);
+        compressed.resize(result.size);
+        result = enveloped->try_compress(input.data(), input.size(), compressed.data(), compressed.size());
+        MAXTEST_ASSERT(result && compressed[0] == 0xB3);
+        compressed.resize(result.size);
+
+        // custom registries can drop codecs or add new ones
+        std::shared_ptr<maxzip::codec_registry> registry = std::make_shared<maxzip::codec_registry>();
+        MAXTEST_ASSERT(!try_func([&]() { registry->add(maxzip::codec::stored, []() { return maxzip::create_zstd_compressor(); }, []() { return maxzip::create_zstd_decompressor(); }); }));
+        MAXTEST_ASSERT(!try_func([&]() { registry->add(maxzip::codec::zstd, nullptr, nullptr); }));
+        maxzip::universal_decompressor_params params;
+        params.registry = registry;
+        decompressor.reset(maxzip::create_universal_decompressor(params));
+        std::vector<uint8_t> decompressed(input.size());
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()); }));
+        MAXTEST_ASSERT(decompressor->try_decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()).status == maxzip::status::failed);
+
+        const maxzip::codec custom = static_cast<maxzip::codec>(9);
+        registry->add(custom, []() { return maxzip::create_zstd_compressor(); }, []() { return maxzip::create_zstd_decompressor(); });
+        MAXTEST_ASSERT(registry->contains(custom));
+        enveloped.reset(maxzip::create_enveloped_compressor(custom, registry->create_compressor(custom)));
+        compressed = compress_block(enveloped.get(), input);
+        MAXTEST_ASSERT(compressed[0] == 0xB9);
+        MAXTEST_ASSERT(decompressor->decompressed_size(compressed.data(), compressed.size()) == input.size());
+        MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == input.size());
+        MAXTEST_ASSERT(decompressed == input);
+        registry->erase(custom);
+        MAXTEST_ASSERT(!registry->contains(custom));
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(registry->create_compressor(custom)); }));
+    };
+
+    MAXTEST_TEST_CASE(checksum::sha256)
+    {
+        const auto hex = [](const maxzip::sha256_digest &digest)
+        {
+            std::string text;
+            for (const uint8_t byte : digest)
+            {
+                text += "0123456789abcdef"[byte >> 4];
+                text += "0123456789abcdef"[byte & 0xF];
+            }
+            return text;
+        };
+        const uint8_t abc[] = "abc";
+        const uint8_t two_blocks[] = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+        MAXTEST_ASSERT(hex(maxzip::sha256(nullptr, 0)) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+        MAXTEST_ASSERT(hex(maxzip::sha256(abc, 3)) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        MAXTEST_ASSERT(hex(maxzip::sha256(two_blocks, 56)) == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+        // the dispatched block function must agree with the portable one from
+        // any state and on unaligned data
+        std::vector<uint8_t> input(64 * 40 + 3);
+        uint64_t state(99);
+        for (uint8_t &byte : input)
+        {
+            state = state * 6364136223846793005 + 1442695040888963407;
+            byte = static_cast<uint8_t>(state >> 56);
+        }
+        for (size_t offset = 0; offset < 4; offset++)
+        {
+            for (size_t blocks = 0; blocks <= 40; blocks += 3)
+            {
+                uint32_t portable[8];
+                for (uint32_t &word : portable)
+                {
+                    state = state * 6364136223846793005 + 1442695040888963407;
+                    word = static_cast<uint32_t>(state >> 32);
+                }
+                uint32_t dispatched[8];
+                std::copy(portable, portable + 8, dispatched);
+                maxzip::sha256_software(portable, input.data() + offset, blocks);
+                maxzip::sha256_blocks(dispatched, input.data() + offset, blocks);
+                MAXTEST_ASSERT(std::equal(portable, portable + 8, dispatched));
+            }
+        }
+    };
+
+    MAXTEST_TEST_CASE(checksum::frame)
+    {
+        const uint8_t check[] = "123456789";
+        MAXTEST_ASSERT(maxzip::crc32c(check, 9) == 0xE3069283);
+        MAXTEST_ASSERT(maxzip::crc32c(check, 4, maxzip::crc32c(check, 0)) == maxzip::crc32c(check, 4));
+        MAXTEST_ASSERT(maxzip::crc32c(check + 4, 5, maxzip::crc32c(check, 4)) == 0xE3069283);
+        MAXTEST_ASSERT(maxzip::crc32c(nullptr, 0) == 0);
+
+        // long inputs take the interleaved path, which must agree with hashing
+        // the same data in short pieces
+        const std::vector<uint8_t> input = make_corpus(100000);
+        uint32_t pieces(0);
+        for (size_t offset = 0; offset < input.size(); offset += 1000)
+        {
+            pieces = maxzip::crc32c(input.data() + offset, std::min<size_t>(1000, input.size() - offset), pieces);
+        }
+        MAXTEST_ASSERT(maxzip::crc32c(input.data(), input.size()) == pieces);
+
+        // the portable kernel must agree with the dispatched one, which is the
+        // hardware path where the processor has it, at any length and alignment
+        uint64_t state(7);
+        for (size_t i = 0; i < 2000; i++)
+        {
+            state = state * 6364136223846793005 + 1442695040888963407;
+            const size_t offset = static_cast<size_t>(state >> 60);
+            const size_t size = (i < 1000) ? i : static_cast<size_t>(state >> 32) % (input.size() - offset);
+            const uint32_t crc = static_cast<uint32_t>(state >> 16);
+            MAXTEST_ASSERT(~maxzip::crc32c_software(~crc, input.data() + offset, size) == maxzip::crc32c(input.data() + offset, size, crc));
+        }
+
+        std::vector<std::pair<maxzip::compressor_factory, maxzip::decompressor_factory>> codecs;
+        codecs.emplace_back([]() { return maxzip::create_brotli_compressor(); }, []() { return maxzip::create_brotli_decompressor(); });
+        codecs.emplace_back([]() { return maxzip::create_zlib_compressor(); }, []() { return maxzip::create_zlib_decompressor(); });
+        codecs.emplace_back([]() { return maxzip::create_zstd_compressor(); }, []() { return maxzip::create_zstd_decompressor(); });
+        codecs.emplace_back([]() { return maxzip::create_lz4_compressor(); }, []() { return maxzip::create_lz4_decompressor(); });
+        for (const auto &[compressor_factory, decompressor_factory] : codecs)
+        {
+            std::unique_ptr<maxzip::compressor> compressor(maxzip::create_checksummed_compressor(compressor_factory()));
+            std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_checksummed_decompressor(decompressor_factory()));
+            std::vector<uint8_t> compressed = compress_block(compressor.get(), input);
+            const uint32_t checksum = maxzip::crc32c(input.data(), input.size());
+            const uint8_t *trailer = compressed.data() + compressed.size() - maxzip::checksum_size;
+            MAXTEST_ASSERT(trailer[0] == (checksum & 0xFF) && trailer[3] == (checksum >> 24));
+            std::vector<uint8_t> decompressed(input.size());
+            MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == input.size());
+            MAXTEST_ASSERT(decompressed == input);
+            MAXTEST_ASSERT(decompressor->try_decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()).size == input.size());
+            decompressed.clear();
+            MAXTEST_ASSERT(decompressor->decompress_to(compressed.data(), compressed.size(), decompressed) == input.size());
+            MAXTEST_ASSERT(decompressed == input);
+
+            size_t bound(0);
+            compressor->compress(input.data(), input.size(), nullptr, bound);
+            std::vector<uint8_t> output(bound);
+            maxzip::codec_result result = compressor->try_compress(input.data(), input.size(), output.data(), output.size());
+            MAXTEST_ASSERT(result && result.size == compressed.size());
+            output.resize(result.size);
+            MAXTEST_ASSERT(output == compressed);
+            result = compressor->try_compress(input.data(), input.size(), output.data(), 2);
+            MAXTEST_ASSERT(result.status == maxzip::status::insufficient_output);
+
+            // a damaged checksum is reported even though the codec data is intact
+            compressed.back() ^= 0x01;
+            decompressed.resize(input.size());
+            MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()); }));
+            MAXTEST_ASSERT(decompressor->try_decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()).status == maxzip::status::corrupt_input);
+            MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress_to(compressed.data(), compressed.size(), decompressed); }));
+            MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(compressed.data(), 3, decompressed.data(), decompressed.size()); }));
+            MAXTEST_ASSERT(decompressor->try_decompress(compressed.data(), 3, decompressed.data(), decompressed.size()).status == maxzip::status::corrupt_input);
+        }
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_checksummed_compressor(nullptr)); }));
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::decompressor>(maxzip::create_checksummed_decompressor(nullptr)); }));
+    };
+
+    MAXTEST_TEST_CASE(parallel::multiframe)
+    {
+        const std::vector<uint8_t> input = make_corpus(200000);
+
+        // frames of different sizes with a skippable frame in between
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_zstd_compressor());
+        std::vector<uint8_t> compressed;
+        const size_t splits[] = {0, 1000, 70000, 70000, 150000, input.size()};
+        for (size_t i = 0; i + 1 < sizeof(splits) / sizeof(splits[0]); i++)
+        {
+            const std::vector<uint8_t> part(input.begin() + splits[i], input.begin() + splits[i + 1]);
+            const std::vector<uint8_t> frame = compress_block(compressor.get(), part);
+            compressed.insert(compressed.end(), frame.begin(), frame.end());
+            if (i == 1)
+            {
+                const uint8_t skippable[] = {0x50, 0x2A, 0x4D, 0x18, 0x03, 0x00, 0x00, 0x00, 'm', 'x', 'z'};
+                compressed.insert(compressed.end(), skippable, skippable + sizeof(skippable));
+            }
+        }
+
+        maxzip::parallel_decompressor_params params;
+        params.thread_count = 3;
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_multiframe_decompressor([]() { return maxzip::create_zstd_decompressor(); }, params));
+        MAXTEST_ASSERT(decompressor->decompressed_size(compressed.data(), compressed.size()) == input.size());
+        std::vector<uint8_t> decompressed(input.size());
+        MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == input.size());
+        MAXTEST_ASSERT(decompressed == input);
+        decompressed.clear();
+        MAXTEST_ASSERT(decompressor->decompress_to(compressed.data(), compressed.size(), decompressed) == input.size());
+        MAXTEST_ASSERT(decompressed == input);
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size() - 1); }));
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(compressed.data(), compressed.size() - 1, decompressed.data(), decompressed.size()); }));
+        MAXTEST_ASSERT(!decompressor->decompressed_size(compressed.data(), compressed.size() - 1));
+
+        // a frame without a content size makes the whole input decode serially
+        maxzip::zstd_compressor_params unsized_params;
+        unsized_params.enable_content_size = false;
+        std::unique_ptr<maxzip::compressor> unsized(maxzip::create_zstd_compressor(unsized_params));
+        const std::vector<uint8_t> tail = compress_block(unsized.get(), input);
+        compressed.insert(compressed.end(), tail.begin(), tail.end());
+        MAXTEST_ASSERT(!decompressor->decompressed_size(compressed.data(), compressed.size()));
+        decompressed.resize(2 * input.size());
+        MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == 2 * input.size());
+        MAXTEST_ASSERT(std::equal(input.begin(), input.end(), decompressed.begin()) && std::equal(input.begin(), input.end(), decompressed.begin() + input.size()));
+
+        // a frame that claims 64 GiB from an empty raw block is not trusted to
+        // size the output, so it is rejected without allocating the claim
+        const uint8_t oversized[] = {0x28, 0xB5, 0x2F, 0xFD, 0xE0, 0, 0, 0, 0, 0x10, 0, 0, 0, 0x01, 0, 0};
+        compressed.resize(compressed.size() - tail.size());
+        compressed.insert(compressed.end(), oversized, oversized + sizeof(oversized));
+        MAXTEST_ASSERT(!decompressor->decompressed_size(compressed.data(), compressed.size()));
+        MAXTEST_ASSERT(rejects_input([&]() { decompressor->decompress_to(compressed.data(), compressed.size(), decompressed); }));
+
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::decompressor>(maxzip::create_multiframe_decompressor([]() { return nullptr; })); }));
+    };
+
+    MAXTEST_TEST_CASE(vectored::roundtrip)
+    {
+        const std::vector<uint8_t> input = make_corpus(50000);
+        // a header, an empty buffer, body fragments and a trailer
+        const std::vector<maxzip::input_buffer> inputs = split_input(input, {16, 0, 20000, 7, 25000});
+
+        std::vector<std::pair<maxzip::compressor_factory, maxzip::decompressor_factory>> codecs;
+        codecs.emplace_back([]() { return maxzip::create_brotli_compressor(); }, []() { return maxzip::create_brotli_decompressor(); });
+        codecs.emplace_back([]() { return maxzip::create_zlib_compressor(); }, []() { return maxzip::create_zlib_decompressor(); });
+        codecs.emplace_back([]() { return maxzip::create_zstd_compressor(); }, []() { return maxzip::create_zstd_decompressor(); });
+        codecs.emplace_back([]() { return maxzip::create_lz4_compressor(); }, []() { return maxzip::create_lz4_decompressor(); });
+        for (const auto &[compressor_factory, decompressor_factory] : codecs)
+        {
+            std::unique_ptr<maxzip::compressor> compressor(compressor_factory());
+            std::unique_ptr<maxzip::decompressor> decompressor(decompressor_factory());
+            size_t bound(0);
+            compressor->compress(input.data(), input.size(), nullptr, bound);
+            std::vector<uint8_t> compressed(bound);
+            std::vector<maxzip::output_buffer> outputs = split_output(compressed, {100, 0, 1});
+            compressed.resize(compressor->compressv(inputs.data(), inputs.size(), outputs.data(), outputs.size()));
+
+            // the block is interchangeable with one from the contiguous calls
+            std::vector<uint8_t> decompressed(input.size());
+            MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == input.size());
+            MAXTEST_ASSERT(decompressed == input);
+            const std::vector<maxzip::input_buffer> compressed_inputs = split_input(compressed, {3, 0, 1000});
+            std::fill(decompressed.begin(), decompressed.end(), 0);
+            outputs = split_output(decompressed, {1, 30000, 0});
+            MAXTEST_ASSERT(decompressor->decompressv(compressed_inputs.data(), compressed_inputs.size(), outputs.data(), outputs.size()) == input.size());
+            MAXTEST_ASSERT(decompressed == input);
+            const maxzip::input_buffer whole = {compressed.data(), compressed.size()};
+            std::fill(decompressed.begin(), decompressed.end(), 0);
+            outputs = split_output(decompressed, {});
+            MAXTEST_ASSERT(decompressor->decompressv(&whole, 1, outputs.data(), outputs.size()) == input.size());
+            MAXTEST_ASSERT(decompressed == input);
+
+            std::vector<uint8_t> small(input.size() - 1);
+            outputs = split_output(small, {1000});
+            MAXTEST_ASSERT(!try_func([&]() { decompressor->decompressv(compressed_inputs.data(), compressed_inputs.size(), outputs.data(), outputs.size()); }));
+            small.resize(compressed.size() / 2);
+            outputs = split_output(small, {10});
+            MAXTEST_ASSERT(!try_func([&]() { compressor->compressv(inputs.data(), inputs.size(), outputs.data(), outputs.size()); }));
+            MAXTEST_ASSERT(!try_func([&]() { decompressor->decompressv(compressed_inputs.data(), compressed_inputs.size() - 1, outputs.data(), outputs.size()); }));
+        }
+    };
+
+    MAXTEST_TEST_CASE(zstd::workers)
+    {
+        const std::vector<uint8_t> input = make_corpus(3 << 20);
+
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::zstd_thread_pool>(maxzip::create_zstd_thread_pool(0)); }));
+        std::shared_ptr<maxzip::zstd_thread_pool> pool(maxzip::create_zstd_thread_pool(2));
+        MAXTEST_ASSERT(pool->size() == 2);
+
+        // many contexts queue their jobs on the same two threads
+        maxzip::zstd_compressor_params params;
+        params.nb_workers = 2;
+        params.job_size = 1 << 20;
+        params.overlap_log = 6;
+        params.thread_pool = pool;
+        std::vector<std::unique_ptr<maxzip::compressor>> compressors;
+        for (size_t i = 0; i < 4; i++)
+        {
+            compressors.emplace_back(maxzip::create_zstd_compressor(params));
+        }
+        pool.reset();
+
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_zstd_decompressor());
+        for (const auto &compressor : compressors)
+        {
+            const std::vector<uint8_t> compressed = compress_block(compressor.get(), input);
+            MAXTEST_ASSERT(decompressor->decompressed_size(compressed.data(), compressed.size()) == input.size());
+            std::vector<uint8_t> decompressed(input.size());
+            MAXTEST_ASSERT(decompressor->decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) == input.size());
+            MAXTEST_ASSERT(decompressed == input);
+        }
+
+        struct foreign_pool : maxzip::zstd_thread_pool
+        {
+            size_t size() const override
+            {
+                return 1;
+            }
+        };
+        params.thread_pool = std::make_shared<foreign_pool>();
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_zstd_compressor(params)); }));
+    };
+
+    MAXTEST_TEST_CASE(dedup::store)
+    {
+        // incompressible data, so that only deduplication shrinks it
+        std::vector<uint8_t> random(1 << 20);
+        uint64_t state(12345);
+        for (uint8_t &byte : random)
+        {
+            state = state * 6364136223846793005 + 1442695040888963407;
+            byte = static_cast<uint8_t>(state >> 56);
+        }
+
+        MAXTEST_ASSERT(!try_func([&]() { maxzip::chunker_params params; params.min_size = 1; maxzip::chunker chunker(params); }));
+        MAXTEST_ASSERT(!try_func([&]() { maxzip::chunker_params params; params.max_size = 1000; maxzip::chunker chunker(params); }));
+
+        // an insertion only moves the boundaries near it
+        const maxzip::chunker chunker;
+        std::vector<uint8_t> shifted(random);
+        shifted.insert(shifted.begin() + 100000, {'m', 'a', 'x', 'z', 'i', 'p'});
+        std::vector<size_t> ends;
+        for (size_t offset = 0; offset < random.size();)
+        {
+            const size_t size = chunker.next(random.data() + offset, random.size() - offset);
+            MAXTEST_ASSERT(size >= chunker.min_size() || offset + size == random.size());
+            MAXTEST_ASSERT(size <= chunker.max_size());
+            offset += size;
+            ends.push_back(offset);
+        }
+        size_t shared(0);
+        for (size_t offset = 0; offset < shifted.size();)
+        {
+            offset += chunker.next(shifted.data() + offset, shifted.size() - offset);
+            shared += (offset > 100006 && std::find(ends.begin(), ends.end(), offset - 6) != ends.end()) ? 1 : 0;
+        }
+        MAXTEST_ASSERT(ends.size() > 4 && shared + 3 >= ends.size());
+
+        std::shared_ptr<maxzip::dedup_store> store = std::make_shared<maxzip::dedup_store>();
+        std::unique_ptr<maxzip::compressor> compressor(maxzip::create_dedup_compressor(store, maxzip::create_zstd_compressor()));
+        std::unique_ptr<maxzip::decompressor> decompressor(maxzip::create_dedup_decompressor(store, maxzip::create_zstd_decompressor()));
+        std::vector<std::vector<uint8_t>> blocks;
+        blocks.push_back(random);
+        blocks.push_back(shifted);
+        blocks.emplace_back(random.begin(), random.end());
+        blocks.back().insert(blocks.back().end(), random.begin(), random.end());
+        blocks.emplace_back();
+        std::vector<std::vector<uint8_t>> manifests;
+        for (const std::vector<uint8_t> &block : blocks)
+        {
+            manifests.push_back(compress_block(compressor.get(), block));
+            if (manifests.size() == 1)
+            {
+                MAXTEST_ASSERT(store->stored_size() > random.size());
+            }
+        }
+        // the repeats added only the chunks around the insertion
+        MAXTEST_ASSERT(store->chunk_count() <= ends.size() + 3);
+        MAXTEST_ASSERT(store->stored_size() < random.size() + random.size() / 4);
+
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            MAXTEST_ASSERT(decompressor->decompressed_size(manifests[i].data(), manifests[i].size()) == blocks[i].size());
+            std::vector<uint8_t> decompressed;
+            MAXTEST_ASSERT(decompressor->decompress_to(manifests[i].data(), manifests[i].size(), decompressed) == blocks[i].size());
+            MAXTEST_ASSERT(decompressed == blocks[i]);
+        }
+
+        std::vector<uint8_t> decompressed(random.size());
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(manifests[0].data(), manifests[0].size(), decompressed.data(), decompressed.size() - 1); }));
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(manifests[0].data(), manifests[0].size() - 1, decompressed.data(), decompressed.size()); }));
+        std::vector<uint8_t> manifest(manifests[0]);
+        manifest[16] = 0xFF;
+        manifest[23] = 0xFF;
+        MAXTEST_ASSERT(!try_func([&]() { decompressor->decompress(manifest.data(), manifest.size(), decompressed.data(), decompressed.size()); }));
+        MAXTEST_ASSERT(!try_func([&]() { store->get(store->chunk_count()); }));
+        MAXTEST_ASSERT(!try_func([&]() { std::unique_ptr<maxzip::compressor>(maxzip::create_dedup_compressor(nullptr, maxzip::create_zstd_compressor())); }));
+
+        // a manifest whose sizes disagree with the store reports no size, so
+        // decompress_to allocates nothing for it
+        manifest = manifests[0];
+        manifest[8] = 0xFF;
+        manifest[14] = 0x7F;
+        MAXTEST_ASSERT(!decompressor->decompressed_size(manifest.data(), manifest.size()));
+        MAXTEST_ASSERT(rejects_input([&]() { decompressor->decompress_to(manifest.data(), manifest.size(), decompressed); }));
+        manifest = manifests[0];
+        manifest[24] ^= 1;
+        MAXTEST_ASSERT(!decompressor->decompressed_size(manifest.data(), manifest.size()));
+
+        // chunks are keyed by SHA-256, and a key computed elsewhere finds them
+        const maxzip::stored_chunk first = store->get(0);
+        MAXTEST_ASSERT(first.key == maxzip::sha256(random.data(), ends[0]));
+        MAXTEST_ASSERT(store->find(first.key) == 0);
+        const std::vector<uint8_t> first_compressed(first.compressed.data, first.compressed.data + first.compressed.size);
+        MAXTEST_ASSERT(store->insert(first.key, first.size, first_compressed) == 0);
+        MAXTEST_ASSERT(!try_func([&]() { store->insert(first.key, first.size + 1, first_compressed); }));
+        MAXTEST_ASSERT(!try_func([&]() { store->insert(maxzip::sha256(nullptr, 0), size_t(1) << 31, {1, 2, 3}); }));
+        maxzip::sha256_digest key{};
+        key[0] = 1;
+        const size_t count = store->chunk_count();
+        MAXTEST_ASSERT(store->insert(key, first.size, first_compressed) == count);
+        MAXTEST_ASSERT(store->find(key) == count && store->chunk_count() == count + 1);
+
+        // a saved store loads with the same IDs and serves the same manifests
+        std::vector<uint8_t> image;
+        store->save(image);
+        std::shared_ptr<maxzip::dedup_store> loaded = std::make_shared<maxzip::dedup_store>();
+        MAXTEST_ASSERT(rejects_input([&]() { loaded->load(image.data(), image.size() - 1); }));
+        MAXTEST_ASSERT(loaded->chunk_count() == 0);
+        loaded->load(image.data(), image.size());
+        MAXTEST_ASSERT(loaded->chunk_count() == store->chunk_count() && loaded->stored_size() == store->stored_size());
+        MAXTEST_ASSERT(loaded->find(key) == count);
+        MAXTEST_ASSERT(rejects_input([&]() { loaded->load(image.data(), image.size()); }));
+        std::unique_ptr<maxzip::decompressor> restored(maxzip::create_dedup_decompressor(loaded, maxzip::create_zstd_decompressor()));
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            std::vector<uint8_t> output;
+            MAXTEST_ASSERT(restored->decompress_to(manifests[i].data(), manifests[i].size(), output) == blocks[i].size());
+            MAXTEST_ASSERT(output == blocks[i]);
+        }
+    };
+}